@@ -0,0 +1,512 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app.h"
+#include "util/clock.h"
+#include "util/log.h"
+
+typedef struct {
+    uint32_t    warmup_frames;
+    uint32_t    measure_frames;
+    uint32_t    trials;
+    const char *output;
+} bench_config_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t elapsed_ns;
+    double   fps;
+    double   gpu_ms;
+    bool     rejected;
+} bench_trial_t;
+
+typedef struct {
+    uint64_t p50_ns;
+    uint64_t p95_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+    double   mean_ns;
+} bench_distribution_t;
+
+static bool bench_parse_u32(const char *option, const char *value, uint32_t min, uint32_t *out) {
+    if (value == NULL) {
+        log_error("(BENCH) %s requires a value.", option);
+        return false;
+    }
+
+    char *end = NULL;
+    errno     = 0;
+
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || parsed < min || parsed > UINT32_MAX) {
+        log_error("(BENCH) invalid value for %s (%s).", option, value);
+        return false;
+    }
+
+    *out = (uint32_t)parsed;
+    return true;
+}
+
+// Takes the bench options out of argv and leaves the rest for app_config_parse_args.
+static bool bench_parse_args(bench_config_t *bench, int *argc, char *argv[]) {
+    int app_argc = 1;
+    for (int i = 1; i < *argc; ++i) {
+        const char *arg   = argv[i];
+        const char *value = i + 1 < *argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--warmup") == 0) {
+            if (!bench_parse_u32(arg, value, 0, &bench->warmup_frames)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--measure") == 0) {
+            if (!bench_parse_u32(arg, value, 1, &bench->measure_frames)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--trials") == 0) {
+            if (!bench_parse_u32(arg, value, 1, &bench->trials)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--output") == 0) {
+            if (value == NULL) {
+                log_error("(BENCH) %s requires a value.", arg);
+                return false;
+            }
+            bench->output = value;
+            ++i;
+        } else {
+            argv[app_argc++] = argv[i];
+        }
+    }
+
+    *argc = app_argc;
+    return true;
+}
+
+static void bench_print_usage(const char *program) {
+    printf("Usage: %s [bench options] [app options]\n", program);
+    printf("  --warmup N                        unmeasured frames per trial (default: 120)\n");
+    printf("  --measure N                       measured frames per trial (default: 1000)\n");
+    printf("  --trials N                        number of trials (default: 5)\n");
+    printf("  --output PATH                     JSON report (default: bench.json)\n");
+    printf("\n");
+    app_config_print_usage(program);
+}
+
+static int bench_compare_u64(const void *a, const void *b) {
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int bench_compare_double(const void *a, const void *b) {
+    double lhs = *(const double *)a;
+    double rhs = *(const double *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint64_t bench_percentile(const uint64_t *sorted, uint64_t count, uint64_t percent) {
+    uint64_t rank = (count * percent + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
+
+static bench_distribution_t bench_distribution(uint64_t *samples_ns, uint64_t count) {
+    bench_distribution_t distribution = {0};
+    if (count == 0) {
+        return distribution;
+    }
+
+    qsort(samples_ns, count, sizeof(*samples_ns), bench_compare_u64);
+
+    double sum = 0.0;
+    for (uint64_t i = 0; i < count; ++i) {
+        sum += (double)samples_ns[i];
+    }
+
+    distribution.p50_ns  = bench_percentile(samples_ns, count, 50);
+    distribution.p95_ns  = bench_percentile(samples_ns, count, 95);
+    distribution.p99_ns  = bench_percentile(samples_ns, count, 99);
+    distribution.max_ns  = samples_ns[count - 1];
+    distribution.mean_ns = sum / (double)count;
+    return distribution;
+}
+
+static double bench_median(double *values, uint32_t count) {
+    qsort(values, count, sizeof(*values), bench_compare_double);
+    if (count % 2 == 1) {
+        return values[count / 2];
+    }
+    return 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+// A trial is an outlier when its throughput is more than 3 scaled median absolute deviations
+// away from the median trial, which tolerates one disturbed trial out of three.
+static void bench_reject_outliers(bench_trial_t *trials, uint32_t count) {
+    double *values = (double *)malloc(count * sizeof(*values));
+    if (values == NULL) {
+        log_error("(BENCH) malloc failed.");
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = trials[i].fps;
+    }
+    double median = bench_median(values, count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        values[i] = fabs(trials[i].fps - median);
+    }
+    double mad = 1.4826 * bench_median(values, count);
+
+    free(values);
+
+    if (mad <= 0.0) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        trials[i].rejected = fabs(trials[i].fps - median) > 3.0 * mad;
+    }
+}
+
+static bool bench_run_frames(app_t *app, uint32_t frames, uint64_t *samples_ns) {
+    uint32_t done     = 0;
+    uint64_t frame_ns = clock_now_ns();
+    while (done < frames) {
+        if (app_should_close(app)) {
+            log_error("(BENCH) window closed during the benchmark.");
+            return false;
+        }
+
+        draw_result_t draw_result = app_step(app);
+        if (draw_result == DRAW_ERROR) {
+            return false;
+        }
+
+        uint64_t now_ns = clock_now_ns();
+        if (draw_result == DRAW_SUCCESS) {
+            if (samples_ns != NULL) {
+                samples_ns[done] = now_ns - frame_ns;
+            }
+            ++done;
+        }
+        frame_ns = now_ns;
+    }
+
+    return true;
+}
+
+static bool bench_run_trial(
+    app_t                *app,
+    const bench_config_t *bench,
+    bench_trial_t        *trial,
+    uint64_t             *samples_ns
+) {
+    if (!bench_run_frames(app, bench->warmup_frames, NULL) || !app_wait_idle(app)) {
+        return false;
+    }
+
+    queries_stats_t queries_start = app->queries.stats;
+    uint64_t        start_ns      = clock_now_ns();
+
+    if (!bench_run_frames(app, bench->measure_frames, samples_ns) || !app_wait_idle(app)) {
+        return false;
+    }
+
+    trial->frames     = bench->measure_frames;
+    trial->elapsed_ns = clock_now_ns() - start_ns;
+    trial->fps        = (double)trial->frames / ((double)trial->elapsed_ns / 1e9);
+
+    uint64_t gpu_frames = app->queries.stats.frames - queries_start.frames;
+    if (gpu_frames > 0) {
+        trial->gpu_ms
+            = (double)(app->queries.stats.gpu_ns - queries_start.gpu_ns) / (double)gpu_frames / 1e6;
+    }
+
+    return true;
+}
+
+static void bench_write_string(FILE *out, const char *str) {
+    fputc('"', out);
+    for (const char *c = str; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned)*c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void bench_write_device(FILE *out, const device_t *device) {
+    VkPhysicalDeviceDriverProperties driver_properties = {0};
+    driver_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DRIVER_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {0};
+    properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    if (device->api_version >= VK_API_VERSION_1_2) {
+        properties.pNext = &driver_properties;
+    }
+    vkGetPhysicalDeviceProperties2(device->vk_physical_device, &properties);
+
+    const VkPhysicalDeviceProperties *p = &properties.properties;
+
+    fprintf(out, "  \"device\": {\n");
+    fprintf(out, "    \"name\": ");
+    bench_write_string(out, p->deviceName);
+    fprintf(out, ",\n");
+    fprintf(out, "    \"vendor_id\": %u,\n", p->vendorID);
+    fprintf(out, "    \"device_id\": %u,\n", p->deviceID);
+    fprintf(out, "    \"device_type\": %d,\n", (int)p->deviceType);
+    fprintf(
+        out,
+        "    \"api_version\": \"%u.%u.%u\",\n",
+        VK_API_VERSION_MAJOR(p->apiVersion),
+        VK_API_VERSION_MINOR(p->apiVersion),
+        VK_API_VERSION_PATCH(p->apiVersion)
+    );
+    fprintf(out, "    \"driver_version\": %u,\n", p->driverVersion);
+    fprintf(out, "    \"driver_id\": %d,\n", (int)driver_properties.driverID);
+    fprintf(out, "    \"driver_name\": ");
+    bench_write_string(out, driver_properties.driverName);
+    fprintf(out, ",\n");
+    fprintf(out, "    \"driver_info\": ");
+    bench_write_string(out, driver_properties.driverInfo);
+    fprintf(out, "\n  },\n");
+}
+
+static void bench_write_distribution(FILE *out, const bench_distribution_t *distribution) {
+    fprintf(
+        out,
+        "{\"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, "
+        "\"max_ms\": %.4f}",
+        distribution->mean_ns / 1e6,
+        clock_ns_to_ms(distribution->p50_ns),
+        clock_ns_to_ms(distribution->p95_ns),
+        clock_ns_to_ms(distribution->p99_ns),
+        clock_ns_to_ms(distribution->max_ns)
+    );
+}
+
+static bool bench_write_report(
+    const char           *path,
+    const app_t          *app,
+    const bench_config_t *bench,
+    const bench_trial_t  *trials,
+    uint64_t             *samples_ns
+) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        log_error("(BENCH) failed to open %s (%s).", path, strerror(errno));
+        return false;
+    }
+
+    uint32_t kept     = 0;
+    double   fps_sum  = 0.0;
+    double   fps_min  = 0.0;
+    double   fps_max  = 0.0;
+    uint64_t kept_len = 0;
+    for (uint32_t i = 0; i < bench->trials; ++i) {
+        if (trials[i].rejected) {
+            continue;
+        }
+
+        if (kept == 0 || trials[i].fps < fps_min) {
+            fps_min = trials[i].fps;
+        }
+        if (kept == 0 || trials[i].fps > fps_max) {
+            fps_max = trials[i].fps;
+        }
+        fps_sum += trials[i].fps;
+        ++kept;
+
+        // Compact the frame times of kept trials to the front for the pooled distribution.
+        memmove(
+            &samples_ns[kept_len],
+            &samples_ns[(uint64_t)i * bench->measure_frames],
+            bench->measure_frames * sizeof(*samples_ns)
+        );
+        kept_len += bench->measure_frames;
+    }
+
+    double fps_mean = kept > 0 ? fps_sum / (double)kept : 0.0;
+    double fps_var  = 0.0;
+    for (uint32_t i = 0; i < bench->trials; ++i) {
+        if (!trials[i].rejected) {
+            fps_var += (trials[i].fps - fps_mean) * (trials[i].fps - fps_mean);
+        }
+    }
+    double fps_stddev = kept > 1 ? sqrt(fps_var / (double)(kept - 1)) : 0.0;
+
+    bench_distribution_t distribution = bench_distribution(samples_ns, kept_len);
+
+    fprintf(out, "{\n");
+    bench_write_device(out, &app->device);
+    fprintf(out, "  \"config\": {\n");
+    fprintf(out, "    \"headless\": %s,\n", app->config.headless ? "true" : "false");
+    fprintf(
+        out,
+        "    \"extent\": \"%ux%u\",\n",
+        app->config.headless ? app->offscreen.extent.width : app->swapchain.extent.width,
+        app->config.headless ? app->offscreen.extent.height : app->swapchain.extent.height
+    );
+    fprintf(out, "    \"sync\": \"%s\",\n", sync_mode_str(app->sync.mode));
+    fprintf(
+        out,
+        "    \"present_mode\": \"%s\",\n",
+        app->config.headless ? "none" : swapchain_present_mode_str(app->swapchain.vk_present_mode)
+    );
+    fprintf(out, "    \"frames_in_flight\": %u,\n", app->frames_in_flight);
+    fprintf(out, "    \"pacing\": \"%s\",\n", frame_pacer_mode_str(app->frame_pacer.mode));
+    fprintf(
+        out,
+        "    \"swapchain_images\": %u,\n",
+        app->config.headless ? 0 : app->swapchain.vk_image_count
+    );
+    fprintf(out, "    \"draws\": %u,\n", app->config.draw_count);
+    fprintf(out, "    \"record_threads\": %u,\n", app->config.record_threads);
+    fprintf(out, "    \"instances\": %u,\n", app->config.instance_count);
+    fprintf(out, "    \"particles\": %u,\n", app->config.particle_count);
+    fprintf(out, "    \"objects\": %u,\n", app->config.object_count);
+    fprintf(out, "    \"bindless\": %s,\n", app->config.bindless ? "true" : "false");
+    fprintf(out, "    \"record_once\": %s,\n", app->config.record_once ? "true" : "false");
+    fprintf(
+        out,
+        "    \"dynamic_rendering\": %s,\n",
+        app->config.dynamic_rendering ? "true" : "false"
+    );
+    fprintf(out, "    \"warmup_frames\": %u,\n", bench->warmup_frames);
+    fprintf(out, "    \"measure_frames\": %u,\n", bench->measure_frames);
+    fprintf(out, "    \"trials\": %u\n", bench->trials);
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"startup\": {\n");
+    fprintf(
+        out, "    \"pipeline_cache\": \"%s\",\n", app->pipeline_cache.warm ? "warm" : "cold"
+    );
+    fprintf(out, "    \"startup_ms\": %.4f,\n", clock_ns_to_ms(app->startup_ns));
+    fprintf(out, "    \"pipeline_ms\": %.4f\n", clock_ns_to_ms(app->pipeline_ns));
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"trials\": [\n");
+    for (uint32_t i = 0; i < bench->trials; ++i) {
+        fprintf(
+            out,
+            "    {\"frames\": %llu, \"seconds\": %.6f, \"fps\": %.2f, \"gpu_ms\": %.4f, "
+            "\"rejected\": %s}%s\n",
+            (unsigned long long)trials[i].frames,
+            (double)trials[i].elapsed_ns / 1e9,
+            trials[i].fps,
+            trials[i].gpu_ms,
+            trials[i].rejected ? "true" : "false",
+            i + 1 < bench->trials ? "," : ""
+        );
+    }
+    fprintf(out, "  ],\n");
+    fprintf(out, "  \"throughput\": {\n");
+    fprintf(out, "    \"kept_trials\": %u,\n", kept);
+    fprintf(out, "    \"fps_mean\": %.2f,\n", fps_mean);
+    fprintf(out, "    \"fps_stddev\": %.2f,\n", fps_stddev);
+    fprintf(out, "    \"fps_min\": %.2f,\n", fps_min);
+    fprintf(out, "    \"fps_max\": %.2f,\n", fps_max);
+    fprintf(
+        out, "    \"particles_per_second\": %.6g\n", fps_mean * (double)app->config.particle_count
+    );
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"frame_time\": ");
+    bench_write_distribution(out, &distribution);
+    fprintf(out, "\n}\n");
+
+    bool ok = ferror(out) == 0;
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        log_error("(BENCH) failed to write %s.", path);
+        return false;
+    }
+
+    log_debug(
+        "(BENCH) %.1f fps (+- %.1f, %u/%u trials kept), p50 %.3f ms, p99 %.3f ms -> %s.",
+        fps_mean,
+        fps_stddev,
+        kept,
+        bench->trials,
+        clock_ns_to_ms(distribution.p50_ns),
+        clock_ns_to_ms(distribution.p99_ns),
+        path
+    );
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    bench_config_t bench = {0};
+    bench.warmup_frames  = 120;
+    bench.measure_frames = 1000;
+    bench.trials         = 5;
+    bench.output         = "bench.json";
+
+    app_config_t config;
+    app_config_default(&config);
+    if (!bench_parse_args(&bench, &argc, argv) || !app_config_parse_args(&config, argc, argv)) {
+        bench_print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (config.show_help) {
+        bench_print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    if (config.adaptive_frames_in_flight) {
+        log_warn("(BENCH) adaptive frames in flight makes trials depend on each other.");
+    }
+
+    uint64_t       samples_count = (uint64_t)bench.measure_frames * bench.trials;
+    uint64_t      *samples_ns    = (uint64_t *)malloc(samples_count * sizeof(*samples_ns));
+    bench_trial_t *trials        = (bench_trial_t *)calloc(bench.trials, sizeof(*trials));
+    if (samples_ns == NULL || trials == NULL) {
+        log_error("(BENCH) malloc failed.");
+        free(samples_ns);
+        free(trials);
+        return EXIT_FAILURE;
+    }
+
+    app_t app;
+    if (!app_create(&app, &config)) {
+        free(samples_ns);
+        free(trials);
+        return EXIT_FAILURE;
+    }
+
+    // Trials measure the real pipeline, not the clear-only placeholder frames.
+    bool ok = app_wait_pipeline(&app);
+    for (uint32_t i = 0; i < bench.trials && ok; ++i) {
+        ok = bench_run_trial(
+            &app, &bench, &trials[i], &samples_ns[(uint64_t)i * bench.measure_frames]
+        );
+        if (ok) {
+            log_debug("(BENCH) trial %u: %.1f fps.", i + 1, trials[i].fps);
+        }
+    }
+
+    if (ok) {
+        bench_reject_outliers(trials, bench.trials);
+        ok = bench_write_report(bench.output, &app, &bench, trials, samples_ns);
+    }
+
+    app_destroy(&app);
+    free(samples_ns);
+    free(trials);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -5,30 +5,111 @@
 
 #include <vulkan/vulkan.h>
 
+#include "app_config.h"
+#include "frame_pacer.h"
+#include "frame_policy.h"
+#include "image_count_policy.h"
 #include "platform_window.h"
+#include "util/frame_stats.h"
+#include "util/shader_watch.h"
+#include "vk/bindless.h"
 #include "vk/commands.h"
+#include "vk/compute.h"
 #include "vk/device.h"
+#include "vk/draw.h"
 #include "vk/instance.h"
+#include "vk/instances.h"
+#include "vk/materials.h"
+#include "vk/memory.h"
+#include "vk/objects.h"
+#include "vk/offscreen.h"
+#include "vk/particles.h"
 #include "vk/pipeline.h"
+#include "vk/pipeline_cache.h"
+#include "vk/pipeline_compiler.h"
+#include "vk/pipeline_set.h"
+#include "vk/queries.h"
 #include "vk/renderpass.h"
+#include "vk/retire.h"
 #include "vk/swapchain.h"
+#include "vk/transfer.h"
+#include "vk/upload_ring.h"
 #include "vk/sync.h"
 
 typedef struct {
+    app_config_t config;
+
     platform_window_t *window;
 
-    instance_t   instance;
-    VkSurfaceKHR surface;
-    device_t     device;
-    swapchain_t  swapchain;
-    renderpass_t renderpass;
-    pipeline_t   pipeline;
-    commands_t   commands;
-    sync_t       sync;
+    instance_t          instance;
+    VkSurfaceKHR        surface;
+    device_t            device;
+    memory_t            memory;
+    swapchain_t         swapchain;
+    offscreen_t         offscreen;
+    renderpass_t        renderpass;
+    pipeline_cache_t    pipeline_cache;
+    pipeline_compiler_t pipeline_compiler;
+    pipeline_set_t      pipeline_set;
+    commands_t          commands;
+    queries_t           queries;
+    sync_t              sync;
+    retire_t            retire;
+    instances_t         instances;
+    particles_t         particles;
+    compute_t           compute;
+    objects_t           objects;
+    bindless_t          bindless;
+    materials_t         materials;
+    upload_ring_t       upload_ring;
+    transfer_t          transfer;
+
+    // Pipeline for the current color format, NULL while it compiles and frames only clear.
+    const pipeline_t *pipeline;
+
+    uint32_t       current_frame;
+    uint32_t       frames_in_flight;
+    frame_policy_t frame_policy;
+    frame_pacer_t  frame_pacer;
+
+    image_count_policy_t image_count_policy;
+    frame_stats_t  frame_stats;
+    uint64_t       last_frame_ns;
+
+    uint64_t startup_ns;
+    uint64_t pipeline_ns;
 
-    uint32_t current_frame;
+    // Shader files changed on disk; pipelines are rebuilt and swapped in between frames.
+    shader_watch_t shader_watch;
+    bool           shader_rebuilding;
+    uint64_t       shader_changed_ns;
+    uint64_t       shader_reloads;
+
+    // Swapchain recreation until the next frame drawn with the pipeline.
+    uint64_t resize_start_ns;
+    uint64_t resize_count;
+    uint64_t resize_format_changes;
+    uint64_t resize_total_ns;
+    uint64_t resize_max_ns;
+
+    // --format-switches done so far, and frames drawn since the last one completed.
+    uint32_t format_switches;
+    uint32_t format_switch_frames;
+
+    // Window size last seen while present scaling absorbs size changes.
+    VkExtent2D resize_extent;
+    uint64_t   resize_changed_ns;
+    uint64_t   resize_absorbed;
 } app_t;
 
-bool app_create(app_t *app);
+bool app_create(app_t *app, const app_config_t *config);
 void app_run(app_t *app);
 void app_destroy(app_t *app);
+
+draw_result_t app_step(app_t *app);
+bool          app_should_close(const app_t *app);
+bool          app_wait_idle(const app_t *app);
+bool          app_wait_pipeline(app_t *app);
+
+bool app_set_frames_in_flight(app_t *app, uint32_t frames_in_flight);
+bool app_set_present_mode(app_t *app, VkPresentModeKHR present_mode);
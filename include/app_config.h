@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vk/sync.h"
+
+#define APP_MAX_FRAMES_IN_FLIGHT 8
+
+typedef struct {
+    bool show_help;
+
+    sync_mode_t sync_mode;
+
+    uint32_t frames_in_flight;
+    bool     adaptive_frames_in_flight;
+    uint32_t frames_in_flight_min;
+    uint32_t frames_in_flight_max;
+
+    bool       headless;
+    VkExtent2D headless_extent;
+    uint32_t   headless_frames;
+
+    bool frame_stats;
+    bool record_once;
+    bool dynamic_rendering;
+
+    VkPresentModeKHR present_mode;
+    bool             present_scaling;
+    uint32_t         resize_settle_ms;
+
+    // Swapchain recreations cycling through the surface formats before the app exits, 0 for
+    // none. Stands in for moving the window between monitors when measuring resize latency.
+    uint32_t format_switches;
+    // Prebuild a pipeline for every surface format. Off, a format change idles the device and
+    // compiles the pipeline for the new format, as before the pipeline set.
+    bool format_prebuild;
+
+    // 0 keeps the surface minimum plus one.
+    uint32_t swapchain_images;
+    bool     swapchain_images_auto;
+    uint32_t acquire_stall_us;
+
+    uint32_t target_fps;
+    bool     display_locked;
+
+    uint32_t draw_count;
+    uint32_t record_threads;
+
+    // Triangles per draw read from a storage buffer, 0 draws the plain triangle.
+    uint32_t instance_count;
+
+    // Particles simulated by a compute pass and drawn as points, 0 disables the simulation.
+    uint32_t particle_count;
+
+    // Objects culled on the GPU and drawn indirectly, 0 disables the GPU-driven path.
+    uint32_t object_count;
+
+    // Per-draw materials from the bindless descriptor table, selected by push constants.
+    bool bindless;
+
+    // Upload ring bytes per frame slot, in KiB.
+    uint32_t upload_kib;
+
+    const char *pipeline_cache_path;
+    bool        async_pipelines;
+
+    // Load shaders from SHADER_BIN_DIR and rebuild the pipelines when the files change.
+    bool shader_reload;
+} app_config_t;
+
+void app_config_default(app_config_t *config);
+
+bool app_config_parse_args(app_config_t *config, int argc, char *argv[]);
+
+void app_config_print_usage(const char *program);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "vk/device.h"
+#include "vk/swapchain.h"
+
+typedef enum {
+    FRAME_PACER_OFF = 0,
+    // Starts frames at a fixed rate.
+    FRAME_PACER_TARGET_FPS,
+    // Starts each frame as late as the measured work allows before the next vblank.
+    FRAME_PACER_DISPLAY,
+} frame_pacer_mode_t;
+
+typedef struct {
+    frame_pacer_mode_t mode;
+    bool               present_wait;
+
+    uint64_t period_ns;
+    uint64_t deadline_ns;
+
+    // Present ids increase across swapchains; waits only target the swapchain presented last.
+    uint64_t       present_id;
+    VkSwapchainKHR vk_present_swapchain;
+    uint64_t       last_present_done_ns;
+
+    uint64_t begin_ns;
+    uint64_t work_ns;
+
+    // Interval between frame starts (Welford).
+    uint64_t frames;
+    double   interval_mean_ns;
+    double   interval_m2;
+    uint64_t interval_max_deviation_ns;
+    uint64_t present_wait_timeouts;
+} frame_pacer_t;
+
+void frame_pacer_init(
+    frame_pacer_t     *pacer,
+    frame_pacer_mode_t mode,
+    uint32_t           target_fps,
+    bool               present_wait
+);
+
+uint64_t frame_pacer_begin(
+    frame_pacer_t     *pacer,
+    const device_t    *device,
+    const swapchain_t *swapchain
+);
+
+void frame_pacer_end(frame_pacer_t *pacer, bool presented);
+
+void frame_pacer_log_stats(const frame_pacer_t *pacer);
+
+const char *frame_pacer_mode_str(frame_pacer_mode_t mode);
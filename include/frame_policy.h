@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "vk/draw.h"
+
+typedef struct {
+    uint32_t min_frames;
+    uint32_t max_frames;
+
+    uint64_t windows;
+    uint32_t window_frames;
+    uint64_t window_frame_ns;
+    uint64_t window_wait_ns;
+    uint64_t window_acquire_ns;
+
+    uint64_t depth_avg_frame_ns[APP_MAX_FRAMES_IN_FLIGHT + 1];
+    uint64_t depth_window[APP_MAX_FRAMES_IN_FLIGHT + 1];
+} frame_policy_t;
+
+void frame_policy_init(frame_policy_t *policy, uint32_t min_frames, uint32_t max_frames);
+
+uint32_t frame_policy_update(
+    frame_policy_t      *policy,
+    uint32_t             frames_in_flight,
+    uint64_t             frame_ns,
+    const draw_timing_t *timing
+);
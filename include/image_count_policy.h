@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vk/draw.h"
+
+#define IMAGE_COUNT_POLICY_MAX_IMAGES 8
+
+typedef struct {
+    uint32_t min_images;
+    uint32_t max_images;
+    uint64_t stall_ns;
+    bool     settled;
+
+    uint32_t window_images;
+    uint32_t window_frames;
+    uint32_t window_stalls;
+    uint64_t window_acquire_ns;
+    uint64_t window_acquire_max_ns;
+
+    bool   measured[IMAGE_COUNT_POLICY_MAX_IMAGES + 1];
+    double stall_ratio[IMAGE_COUNT_POLICY_MAX_IMAGES + 1];
+} image_count_policy_t;
+
+void image_count_policy_init(
+    image_count_policy_t *policy,
+    uint32_t              min_images,
+    uint32_t              max_images,
+    uint64_t              stall_ns
+);
+
+uint32_t image_count_policy_update(
+    image_count_policy_t *policy,
+    uint32_t              image_count,
+    const draw_timing_t  *timing
+);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+uint64_t clock_now_ns(void);
+
+double clock_ns_to_ms(uint64_t ns);
+
+void clock_sleep_until_ns(uint64_t deadline_ns, uint64_t spin_ns);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_STATS_CAPACITY 4096
+
+typedef enum {
+    FRAME_PHASE_WAIT = 0,
+    FRAME_PHASE_ACQUIRE,
+    FRAME_PHASE_RECORD,
+    FRAME_PHASE_SUBMIT,
+    FRAME_PHASE_PRESENT,
+    FRAME_PHASE_FRAME,
+    FRAME_PHASE_COUNT
+} frame_phase_t;
+
+typedef struct {
+    bool enabled;
+
+    uint32_t head;
+    uint32_t count;
+    uint32_t samples_ns[FRAME_PHASE_COUNT][FRAME_STATS_CAPACITY];
+    uint32_t scratch_ns[FRAME_STATS_CAPACITY];
+} frame_stats_t;
+
+typedef struct {
+    uint64_t p50_ns;
+    uint64_t p95_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} frame_stats_summary_t;
+
+void frame_stats_init(frame_stats_t *stats, bool enabled);
+
+void frame_stats_record(frame_stats_t *stats, const uint64_t phases_ns[FRAME_PHASE_COUNT]);
+
+bool frame_stats_summarize(
+    frame_stats_t         *stats,
+    frame_phase_t          phase,
+    frame_stats_summary_t *summary
+);
+
+void frame_stats_report(frame_stats_t *stats);
+
+const char *frame_phase_str(frame_phase_t phase);
@@ -1,6 +1,46 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
+// Every shader the getters below return, as bits in the masks of shader_map_dir and
+// shader_remap, so callers can tell which pipelines a change affects.
+typedef enum {
+    SHADER_VERTEX = 0,
+    SHADER_FRAGMENT,
+    SHADER_INSTANCED_VERTEX,
+    SHADER_PARTICLES_VERTEX,
+    SHADER_PARTICLES_COMPUTE,
+    SHADER_OBJECTS_VERTEX,
+    SHADER_OBJECTS_CULL,
+    SHADER_BINDLESS_VERTEX,
+    SHADER_COUNT
+} shader_id_t;
+
+#define SHADER_BIT(id) (1U << (id))
+
+// The getters return the SPIR-V embedded at build time, or the file mapped from disk once
+// shader_map_dir or shader_remap loaded it. Mapping replaces the data the getters return, so
+// it must not run while another thread builds from it.
+void *shader_get_spv_data(shader_id_t id, uint32_t *size);
 void *shader_get_vertex_spv_data(uint32_t *size);
 void *shader_get_fragment_spv_data(uint32_t *size);
+void *shader_get_instanced_vertex_spv_data(uint32_t *size);
+void *shader_get_particles_vertex_spv_data(uint32_t *size);
+void *shader_get_particles_compute_spv_data(uint32_t *size);
+void *shader_get_objects_vertex_spv_data(uint32_t *size);
+void *shader_get_objects_cull_spv_data(uint32_t *size);
+void *shader_get_bindless_vertex_spv_data(uint32_t *size);
+
+// The directory the embedded shaders were compiled into (SHADER_BIN_DIR).
+const char *shader_bin_dir(void);
+
+// Maps every known shader found in dir and returns the mask of the mapped ones. Missing or
+// invalid files keep the embedded copy.
+uint32_t shader_map_dir(const char *dir);
+
+// Remaps one file from dir, falling back to the embedded copy. Returns the shader's bit, 0 if no
+// shader has that name.
+uint32_t shader_remap(const char *dir, const char *file_name);
+
+void shader_unmap_all(void);
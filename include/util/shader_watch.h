@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SHADER_WATCH_MAX_PENDING 16
+#define SHADER_WATCH_NAME_MAX    64
+
+// Watches a shader directory with inotify for .spv files that were written or renamed into
+// place. Changed names collect in pending until the caller drains them; when more change than
+// fit, reload_all is set instead. Without inotify the watch stays disabled and never reports.
+typedef struct {
+    bool enabled;
+    int  fd;
+    int  wd;
+
+    char     pending[SHADER_WATCH_MAX_PENDING][SHADER_WATCH_NAME_MAX];
+    uint32_t pending_count;
+    bool     reload_all;
+
+    uint64_t events;
+} shader_watch_t;
+
+bool shader_watch_create(shader_watch_t *watch, const char *dir);
+
+void shader_watch_destroy(shader_watch_t *watch);
+
+// Reads the queued events without blocking.
+void shader_watch_poll(shader_watch_t *watch);
+
+void shader_watch_clear(shader_watch_t *watch);
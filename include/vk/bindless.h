@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+#define BINDLESS_MAX_BUFFERS 16384
+#define BINDLESS_MAX_IMAGES  16384
+
+#define BINDLESS_INVALID_HANDLE UINT32_MAX
+
+// Stages that see the table and the per-draw push constants.
+#define BINDLESS_STAGES (VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT)
+
+// Per-draw handles, the only state a draw changes. Shaders interpret the four words.
+typedef struct {
+    uint32_t handles[4];
+} bindless_push_t;
+
+typedef struct {
+    uint32_t  capacity;
+    uint32_t  high_water;
+    uint32_t *free_slots;
+    uint32_t  free_count;
+
+    // Released slots with the frame slots that have not waited since the release.
+    uint32_t *retired_slots;
+    uint32_t *retired_pending;
+    uint32_t  retired_count;
+} bindless_slots_t;
+
+// One global descriptor set with update-after-bind arrays of storage buffers (binding 0) and
+// sampled images (binding 1) plus a linear sampler (binding 2). Resources are registered once
+// and addressed by the returned handle, so a draw binds the set once per command buffer and
+// changes only push constants. Slots not used by pending work may be written while the set is
+// bound. A released slot is reused only after every frame slot waited on its fences once, so
+// frames submitted before the release never read a rewritten descriptor. Not thread-safe.
+typedef struct {
+    const device_t *device;
+
+    VkDescriptorSetLayout vk_set_layout;
+    VkDescriptorPool      vk_descriptor_pool;
+    VkDescriptorSet       vk_descriptor_set;
+    VkSampler             vk_sampler;
+
+    bindless_slots_t buffers;
+    bindless_slots_t images;
+
+    uint64_t writes;
+} bindless_t;
+
+bool bindless_create(bindless_t *bindless, const device_t *device);
+
+void bindless_destroy(bindless_t *bindless);
+
+uint32_t bindless_register_buffer(
+    bindless_t  *bindless,
+    VkBuffer     vk_buffer,
+    VkDeviceSize offset,
+    VkDeviceSize range
+);
+
+uint32_t
+bindless_register_image(bindless_t *bindless, VkImageView vk_image_view, VkImageLayout layout);
+
+// frame_count is the number of frame slots in use; 0 when no frame ever used the handle.
+void bindless_release_buffer(bindless_t *bindless, uint32_t handle, uint32_t frame_count);
+
+void bindless_release_image(bindless_t *bindless, uint32_t handle, uint32_t frame_count);
+
+void bindless_frame_waited(bindless_t *bindless, uint32_t frame_index);
+
+void bindless_flush(bindless_t *bindless);
+
+void bindless_log_stats(const bindless_t *bindless);
@@ -5,18 +5,67 @@
 
 #include <vulkan/vulkan.h>
 
+#include "compute.h"
 #include "device.h"
+#include "instances.h"
+#include "materials.h"
+#include "objects.h"
+#include "particles.h"
 #include "pipeline.h"
+#include "queries.h"
+#include "recorder.h"
 #include "renderpass.h"
 #include "swapchain.h"
+#include "upload_ring.h"
 
 typedef struct {
     VkCommandPool    vk_pool;
     VkCommandBuffer *vk_buffers;
     uint32_t         vk_buffers_count;
+
+    uint32_t draw_count;
+
+    // Stress geometry drawn by every draw call, or NULL for the single triangle.
+    const instances_t *instances;
+
+    // Particles advanced by a compute pass before the render pass and drawn by every draw call.
+    const particles_t *particles;
+
+    // Steps the particles on the dedicated compute queue, NULL to step them on this queue.
+    compute_t *compute;
+
+    // GPU-culled objects, drawn by one indirect draw per draw call.
+    const objects_t *objects;
+
+    // Per-draw materials from the bindless table, selected by push constants.
+    const materials_t *materials;
+
+    // Per-frame data, one region per frame slot; the last region backs the static buffers.
+    // NULL when no scene reads per-frame data.
+    upload_ring_t *upload_ring;
+
+    // Optional worker threads recording the draws into secondary buffers.
+    recorder_t *recorder;
+
+    // Record-once mode: one buffer per target image, recorded up front and resubmitted.
+    VkCommandBuffer *vk_static_buffers;
+    uint32_t         vk_static_buffers_count;
+    bool             static_valid;
 } commands_t;
 
-bool commands_create(commands_t *commands, const device_t *device, uint32_t frame_count);
+bool commands_create(
+    commands_t        *commands,
+    const device_t    *device,
+    uint32_t           frame_count,
+    uint32_t           draw_count,
+    uint32_t           record_threads,
+    const instances_t *instances,
+    const particles_t *particles,
+    compute_t         *compute,
+    const objects_t   *objects,
+    const materials_t *materials,
+    upload_ring_t     *upload_ring
+);
 
 void commands_destroy(commands_t *commands, const device_t *device);
 
@@ -25,7 +74,19 @@ bool commands_record_frame(
     const device_t     *device,
     const renderpass_t *renderpass,
     const pipeline_t   *pipeline,
-    const swapchain_t  *swapchain,
+    queries_t          *queries,
+    VkExtent2D          extent,
     uint32_t            image_index,
     uint32_t            frame_index
 );
+
+bool commands_record_static(
+    commands_t         *commands,
+    const device_t     *device,
+    const renderpass_t *renderpass,
+    const pipeline_t   *pipeline,
+    VkExtent2D          extent,
+    uint32_t            image_count
+);
+
+void commands_invalidate_static(commands_t *commands);
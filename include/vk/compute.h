@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+#define COMPUTE_MAX_TARGETS 2
+
+// One buffer the compute queue writes and the graphics queue reads afterwards.
+typedef struct {
+    // Signaled by the compute submission that wrote the target, waited on by the graphics
+    // submission that reads it.
+    VkSemaphore vk_semaphore_computed;
+    // Signaled by that graphics submission, waited on by the next compute submission that
+    // writes the target.
+    VkSemaphore vk_semaphore_released;
+    bool        release_pending;
+} compute_target_t;
+
+// Per-frame compute work on the dedicated compute queue, writing one of several targets in
+// turn: each submission reads the target the previous one wrote and writes the next. The
+// targets are shared between the two families (VK_SHARING_MODE_CONCURRENT), so a submission
+// runs while the graphics queue still reads its input, and the engine only orders it behind
+// the graphics reads of the target it overwrites. Callers record their dispatches between
+// compute_begin and compute_submit and add compute_graphics_semaphores to the frame's graphics
+// submission.
+typedef struct {
+    const device_t *device;
+
+    // Stages that wait for the graphics reads and for the compute writes.
+    VkPipelineStageFlags compute_stage;
+    VkPipelineStageFlags graphics_stage;
+
+    VkCommandPool    vk_pool;
+    VkCommandBuffer *vk_command_buffers;
+    uint32_t         frame_count;
+
+    compute_target_t targets[COMPUTE_MAX_TARGETS];
+    uint32_t         target_count;
+
+    // Target holding the latest results, 0 before the first submission.
+    uint32_t target;
+
+    uint64_t submits;
+} compute_t;
+
+bool compute_create(
+    compute_t           *compute,
+    const device_t      *device,
+    uint32_t             frame_count,
+    uint32_t             target_count,
+    VkPipelineStageFlags compute_stage,
+    VkPipelineStageFlags graphics_stage
+);
+
+// The caller guarantees the device is idle.
+void compute_destroy(compute_t *compute);
+
+// Begins the frame slot's command buffer, ordered after the previous submission's writes. The
+// slot must have been waited on. The dispatches read compute->target and write the next one.
+bool compute_begin(compute_t *compute, uint32_t frame_index, VkCommandBuffer *command_buffer);
+
+// Submits behind the graphics reads of the written target, which becomes compute->target.
+bool compute_submit(compute_t *compute, uint32_t frame_index);
+
+// Semaphores of the graphics submission that reads compute->target: it waits on computed at
+// graphics_stage and signals released.
+void compute_graphics_semaphores(
+    compute_t   *compute,
+    VkSemaphore *vk_semaphore_computed,
+    VkSemaphore *vk_semaphore_released
+);
+
+void compute_log_stats(const compute_t *compute);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+typedef struct {
+    VkPipelineLayout vk_pipeline_layout;
+    VkPipeline       vk_pipeline;
+} compute_pipeline_t;
+
+// Push constants, if any, are visible to the compute stage from offset 0.
+bool compute_pipeline_create(
+    compute_pipeline_t          *pipeline,
+    const device_t              *device,
+    VkPipelineCache              vk_pipeline_cache,
+    const void                  *spv_data,
+    size_t                       spv_size,
+    const VkDescriptorSetLayout *vk_set_layouts,
+    uint32_t                     vk_set_layouts_count,
+    uint32_t                     push_constants_size
+);
+
+void compute_pipeline_destroy(compute_pipeline_t *pipeline, const device_t *device);
@@ -8,6 +8,30 @@
 typedef struct {
     VkPhysicalDevice vk_physical_device;
     VkDevice         vk_device;
+    uint32_t         api_version;
+    uint32_t         vendor_id;
+    uint32_t         device_id;
+    uint8_t          pipeline_cache_uuid[VK_UUID_SIZE];
+
+    bool has_timeline_semaphore;
+    bool has_pipeline_statistics;
+    bool has_inherited_queries;
+    bool has_dynamic_rendering;
+
+    // multiDrawIndirect with drawIndirectFirstInstance, and the Vulkan 1.2 drawIndirectCount.
+    bool has_multi_draw_indirect;
+    bool has_draw_indirect_count;
+
+    // Descriptor indexing with partially bound, update-after-bind storage buffer and sampled
+    // image arrays that shaders index dynamically, as used by bindless_t.
+    bool has_descriptor_indexing;
+
+    // VK_KHR_present_id and VK_KHR_present_wait, loaded through vkGetDeviceProcAddr.
+    bool                    has_present_wait;
+    PFN_vkWaitForPresentKHR vk_wait_for_present;
+
+    uint32_t timestamp_valid_bits;
+    float    timestamp_period;
 
     uint32_t graphics_queue_familiy_index;
     uint32_t present_queue_family_index;
@@ -15,8 +39,26 @@ typedef struct {
     bool     has_present_queue;
     VkQueue  graphics_queue;
     VkQueue  present_queue;
+
+    // Dedicated transfer-only and compute-only families where the device has them, otherwise
+    // the graphics family and queue. Cross-family handoffs go through transfer_t and compute_t.
+    uint32_t transfer_queue_family_index;
+    uint32_t compute_queue_family_index;
+    bool     has_transfer_queue;
+    bool     has_compute_queue;
+    VkQueue  transfer_queue;
+    VkQueue  compute_queue;
+
+    VkPhysicalDeviceMemoryProperties memory_properties;
 } device_t;
 
 bool device_create(device_t *device, VkInstance vk_instance, VkSurfaceKHR vk_surface);
 
 void device_destroy(device_t *device);
+
+bool device_find_memory_type(
+    const device_t       *device,
+    uint32_t              type_bits,
+    VkMemoryPropertyFlags properties,
+    uint32_t             *memory_type_index
+);
@@ -6,6 +6,7 @@
 
 #include "commands.h"
 #include "device.h"
+#include "offscreen.h"
 #include "pipeline.h"
 #include "renderpass.h"
 #include "swapchain.h"
@@ -14,15 +15,40 @@
 typedef enum {
     DRAW_SUCCESS = 0,
     DRAW_NEED_RECREATE,
+    // Presented, but the swapchain no longer matches the surface.
+    DRAW_SUBOPTIMAL,
     DRAW_ERROR
 } draw_result_t;
 
+typedef struct {
+    uint64_t wait_ns;
+    uint64_t acquire_ns;
+    uint64_t record_ns;
+    uint64_t submit_ns;
+    uint64_t present_ns;
+} draw_timing_t;
+
 draw_result_t draw_frame(
     const device_t     *device,
     const swapchain_t  *swapchain,
     const renderpass_t *renderpass,
     const pipeline_t   *pipeline,
     const commands_t   *commands,
-    const sync_t       *sync,
-    uint32_t           *current_frame
+    queries_t          *queries,
+    sync_t             *sync,
+    uint32_t           *current_frame,
+    uint64_t            present_id,
+    draw_timing_t      *timing
+);
+
+draw_result_t draw_offscreen_frame(
+    const device_t     *device,
+    const offscreen_t  *offscreen,
+    const renderpass_t *renderpass,
+    const pipeline_t   *pipeline,
+    const commands_t   *commands,
+    queries_t          *queries,
+    sync_t             *sync,
+    uint32_t           *current_frame,
+    draw_timing_t      *timing
 );
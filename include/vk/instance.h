@@ -10,5 +10,5 @@ typedef struct {
     VkDebugUtilsMessengerEXT vk_debug_utils_messenger;
 } instance_t;
 
-bool instance_create(instance_t *instance);
+bool instance_create(instance_t *instance, bool headless);
 void instance_destroy(instance_t *instance);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "memory.h"
+#include "transfer.h"
+
+// Matches struct Instance in shaders/instanced.vert (std430).
+typedef struct {
+    float transform[4]; // offset x, offset y, scale, rotation in radians
+    float color[4];
+} instance_data_t;
+
+// Stress geometry: per-instance transforms and colors in a device-local storage buffer, read by
+// the instanced vertex shader through one descriptor set.
+typedef struct {
+    uint32_t count;
+
+    memory_t           *memory;
+    VkBuffer            vk_buffer;
+    memory_allocation_t allocation;
+
+    VkDescriptorSetLayout vk_set_layout;
+    VkDescriptorPool      vk_descriptor_pool;
+    VkDescriptorSet       vk_descriptor_set;
+} instances_t;
+
+bool instances_create(
+    instances_t    *instances,
+    const device_t *device,
+    memory_t       *memory,
+    transfer_t     *transfer,
+    uint32_t        count
+);
+
+void instances_destroy(instances_t *instances, const device_t *device);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "bindless.h"
+#include "device.h"
+#include "memory.h"
+#include "transfer.h"
+
+// Materials are spread over several buffers so draws address more than one table slot.
+#define MATERIALS_BUFFER_COUNT 8
+
+// Matches struct Material in shaders/bindless.vert (std430).
+typedef struct {
+    float transform[4]; // offset x, offset y, scale, rotation in radians
+    float color[4];
+} material_t;
+
+// One material per draw in device-local storage buffers registered in the bindless table. Draw i
+// reads element i / MATERIALS_BUFFER_COUNT of buffer i % MATERIALS_BUFFER_COUNT.
+typedef struct {
+    uint32_t count;
+
+    memory_t   *memory;
+    bindless_t *bindless;
+
+    VkBuffer            vk_buffers[MATERIALS_BUFFER_COUNT];
+    memory_allocation_t allocations[MATERIALS_BUFFER_COUNT];
+    uint32_t            handles[MATERIALS_BUFFER_COUNT];
+} materials_t;
+
+bool materials_create(
+    materials_t    *materials,
+    const device_t *device,
+    memory_t       *memory,
+    transfer_t     *transfer,
+    bindless_t     *bindless,
+    uint32_t        count
+);
+
+void materials_destroy(materials_t *materials, const device_t *device, uint32_t frame_count);
+
+void materials_push(const materials_t *materials, uint32_t draw_index, bindless_push_t *push);
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+#define MEMORY_MAX_ORDERS 32
+
+#define MEMORY_DEFAULT_BLOCK_SIZE ((VkDeviceSize)64 * 1024 * 1024)
+
+typedef enum {
+    // Power-of-two buddy blocks for long-lived resources, freed in any order.
+    MEMORY_STRATEGY_BUDDY = 0,
+    // Bump allocation for transient resources, a block is reused once all of it was freed.
+    MEMORY_STRATEGY_LINEAR
+} memory_strategy_t;
+
+typedef struct {
+    VkMemoryRequirements  requirements;
+    VkMemoryPropertyFlags required_flags;
+    VkMemoryPropertyFlags preferred_flags;
+    memory_strategy_t     strategy;
+
+    // Optimal-tiling images, kept bufferImageGranularity apart from linear resources.
+    bool optimal_tiling;
+} memory_request_t;
+
+typedef struct {
+    VkDeviceSize *offsets;
+    uint32_t      count;
+    uint32_t      capacity;
+} memory_free_list_t;
+
+typedef struct memory_block {
+    VkDeviceMemory    vk_memory;
+    VkDeviceSize      size;
+    uint32_t          memory_type_index;
+    memory_strategy_t strategy;
+    bool              dedicated;
+
+    // Persistently mapped when the memory type is host visible.
+    void *mapped;
+
+    uint32_t     live_allocations;
+    VkDeviceSize used;
+
+    // Buddy: free blocks per order, order 0 being the allocator's minimum size.
+    memory_free_list_t free_lists[MEMORY_MAX_ORDERS];
+    uint32_t           max_order;
+
+    // Linear: next free offset and the tiling of the allocation below it.
+    VkDeviceSize top;
+    bool         top_optimal;
+
+    struct memory_block *next;
+} memory_block_t;
+
+typedef struct {
+    VkDeviceMemory vk_memory;
+    VkDeviceSize   offset;
+    VkDeviceSize   size;
+    void          *mapped;
+
+    memory_block_t *block;
+    uint32_t        order;
+} memory_allocation_t;
+
+typedef struct {
+    uint32_t     block_count;
+    uint32_t     dedicated_count;
+    uint64_t     allocation_count;
+    VkDeviceSize reserved_bytes;
+    VkDeviceSize used_bytes;
+
+    // 1 - largest free range / free bytes over the buddy blocks, 0 when free space is one range.
+    float fragmentation;
+
+    uint64_t vk_allocations;
+    uint64_t allocations;
+    uint64_t frees;
+} memory_stats_t;
+
+// Sub-allocates resources from large VkDeviceMemory blocks per memory type. Allocations of more
+// than half a block get a dedicated VkDeviceMemory. Thread-safe.
+typedef struct {
+    const device_t *device;
+
+    VkDeviceSize block_size;
+    VkDeviceSize min_size;
+    VkDeviceSize buffer_image_granularity;
+    VkDeviceSize non_coherent_atom_size;
+    uint32_t     max_vk_allocations;
+
+    pthread_mutex_t mutex;
+    bool            has_mutex;
+
+    memory_block_t *blocks;
+    uint32_t        blocks_count;
+
+    uint64_t vk_allocations;
+    uint64_t allocations;
+    uint64_t frees;
+} memory_t;
+
+bool memory_create(memory_t *memory, const device_t *device, VkDeviceSize block_size);
+
+void memory_destroy(memory_t *memory);
+
+bool memory_alloc(
+    memory_t               *memory,
+    const memory_request_t *request,
+    memory_allocation_t    *allocation
+);
+
+void memory_free(memory_t *memory, memory_allocation_t *allocation);
+
+bool memory_alloc_buffer(
+    memory_t             *memory,
+    VkBuffer              vk_buffer,
+    VkMemoryPropertyFlags required_flags,
+    VkMemoryPropertyFlags preferred_flags,
+    memory_strategy_t     strategy,
+    memory_allocation_t  *allocation
+);
+
+bool memory_alloc_image(
+    memory_t             *memory,
+    VkImage               vk_image,
+    VkImageTiling         tiling,
+    VkMemoryPropertyFlags required_flags,
+    memory_strategy_t     strategy,
+    memory_allocation_t  *allocation
+);
+
+bool memory_is_coherent(const memory_t *memory, const memory_allocation_t *allocation);
+
+void memory_get_stats(memory_t *memory, memory_stats_t *stats);
+
+void memory_log_stats(memory_t *memory);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "compute_pipeline.h"
+#include "device.h"
+#include "memory.h"
+#include "transfer.h"
+#include "upload_ring.h"
+
+#define OBJECTS_GROUP_SIZE 256
+
+// Objects are scattered over [-extent, extent] in both axes; the view covers a part of it.
+#define OBJECTS_WORLD_EXTENT 4.0F
+
+// Matches struct Object in shaders/objects.vert and shaders/objects_cull.comp (std430).
+typedef struct {
+    float bounds[4]; // center x, center y, radius, rotation in radians
+    float color[4];
+} object_data_t;
+
+// GPU-driven scene: a compute pass culls every object's bounding circle against the view planes
+// of the frame data and writes one VkDrawIndexedIndirectCommand per visible object. The graphics
+// pass consumes them with a single indirect draw, so CPU recording does not depend on the count.
+typedef struct {
+    uint32_t count;
+
+    // Visible draws are appended and counted for vkCmdDrawIndexedIndirectCount. Without
+    // drawIndirectCount every object keeps its slot and culled ones get zero instances.
+    bool compact;
+
+    memory_t           *memory;
+    VkBuffer            vk_object_buffer;
+    memory_allocation_t object_allocation;
+    VkBuffer            vk_draw_buffer;
+    memory_allocation_t draw_allocation;
+    VkBuffer            vk_count_buffer;
+    memory_allocation_t count_allocation;
+    VkBuffer            vk_index_buffer;
+    memory_allocation_t index_allocation;
+
+    // Objects (binding 0), draw commands (binding 1) and the draw count (binding 2).
+    VkDescriptorSetLayout vk_set_layout;
+    VkDescriptorPool      vk_descriptor_pool;
+    VkDescriptorSet       vk_descriptor_set;
+
+    // Set 0 is the objects set, set 1 the upload ring's.
+    compute_pipeline_t pipeline;
+
+    // Built from reloaded shader code, replaces pipeline in objects_swap_pipeline.
+    compute_pipeline_t rebuilt_pipeline;
+} objects_t;
+
+bool objects_create(
+    objects_t            *objects,
+    const device_t       *device,
+    memory_t             *memory,
+    transfer_t           *transfer,
+    VkPipelineCache       vk_pipeline_cache,
+    VkDescriptorSetLayout vk_frame_set_layout,
+    uint32_t              count
+);
+
+void objects_destroy(objects_t *objects, const device_t *device);
+
+// Builds a replacement culling pipeline from the current shaders/objects_cull.comp code. On
+// failure the current pipeline stays.
+bool objects_rebuild_pipeline(
+    objects_t            *objects,
+    const device_t       *device,
+    VkPipelineCache       vk_pipeline_cache,
+    VkDescriptorSetLayout vk_frame_set_layout
+);
+
+// Replaces the pipeline with the rebuilt one, if any. No pending frame may still use it.
+bool objects_swap_pipeline(objects_t *objects, const device_t *device);
+
+// Records the cull pass outside a render pass. The frame data at frame_offset holds the planes.
+void objects_cmd_cull(
+    const objects_t     *objects,
+    VkCommandBuffer      command_buffer,
+    const upload_ring_t *upload_ring,
+    uint32_t             frame_offset
+);
+
+// Writes the panning view (center xy, scale xy) and its left, right, bottom and top cull planes
+// (normal xy, unused, distance) at the given time into the frame data.
+void objects_write_frame_view(float view[4], float planes[4][4], double seconds);
+
+// Records the indirect draw; the caller has bound the pipeline and both descriptor sets.
+void objects_cmd_draw(const objects_t *objects, VkCommandBuffer command_buffer);
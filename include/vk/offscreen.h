@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "memory.h"
+
+typedef struct {
+    VkFormat   vk_image_format;
+    VkExtent2D extent;
+
+    memory_t *memory;
+
+    uint32_t             vk_image_count;
+    VkImage             *vk_images;
+    memory_allocation_t *allocations;
+    VkImageView         *vk_image_views;
+} offscreen_t;
+
+bool offscreen_create(
+    offscreen_t    *offscreen,
+    const device_t *device,
+    memory_t       *memory,
+    VkExtent2D      extent,
+    uint32_t        image_count
+);
+
+void offscreen_destroy(offscreen_t *offscreen, const device_t *device);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "compute.h"
+#include "compute_pipeline.h"
+#include "device.h"
+#include "memory.h"
+#include "transfer.h"
+
+#define PARTICLES_GROUP_SIZE 256
+
+// Fixed step per frame, so the simulated rate is the particle count times the frame rate.
+#define PARTICLES_STEP_SECONDS (1.0F / 60.0F)
+
+// Matches struct Particle in shaders/particles.comp and shaders/particles.vert (std430).
+typedef struct {
+    float position[2];
+    float velocity[2];
+} particle_t;
+
+#define PARTICLES_MAX_BUFFERS COMPUTE_MAX_TARGETS
+
+// GPU particle simulation: a compute pass advances the particles in device-local storage
+// buffers every frame and the particles pipeline draws them as points. On the graphics queue
+// one buffer is stepped in place. On the dedicated compute queue each step reads the buffer the
+// current frame draws and writes the other one, so the two queues overlap.
+typedef struct {
+    uint32_t count;
+
+    memory_t           *memory;
+    VkBuffer            vk_buffers[PARTICLES_MAX_BUFFERS];
+    memory_allocation_t allocations[PARTICLES_MAX_BUFFERS];
+    uint32_t            buffer_count;
+
+    // Set i reads buffer i at binding 0, which the particles vertex shader draws, and writes the
+    // next buffer at binding 1.
+    VkDescriptorSetLayout vk_set_layout;
+    VkDescriptorPool      vk_descriptor_pool;
+    VkDescriptorSet       vk_descriptor_sets[PARTICLES_MAX_BUFFERS];
+
+    compute_pipeline_t pipeline;
+
+    // Built from reloaded shader code, replaces pipeline in particles_swap_pipeline.
+    compute_pipeline_t rebuilt_pipeline;
+} particles_t;
+
+bool particles_create(
+    particles_t    *particles,
+    const device_t *device,
+    memory_t       *memory,
+    transfer_t     *transfer,
+    VkPipelineCache vk_pipeline_cache,
+    uint32_t        count
+);
+
+void particles_destroy(particles_t *particles, const device_t *device);
+
+// Builds a replacement pipeline from the current shaders/particles.comp code. On failure the
+// current pipeline stays.
+bool particles_rebuild_pipeline(
+    particles_t    *particles,
+    const device_t *device,
+    VkPipelineCache vk_pipeline_cache
+);
+
+// Replaces the pipeline with the rebuilt one, if any. No pending frame may still use it.
+bool particles_swap_pipeline(particles_t *particles, const device_t *device);
+
+// Sets up compute to step the particle buffers in turn on the dedicated compute queue, for
+// particles_submit_update. Needs the buffers particles_create makes when the device has a
+// dedicated compute family.
+bool particles_create_compute(
+    const particles_t *particles,
+    compute_t         *compute,
+    const device_t    *device,
+    uint32_t           frame_count
+);
+
+// Records one simulation step outside a render pass, ordered after the previous frame's vertex
+// reads and before this frame's.
+void particles_cmd_update(const particles_t *particles, VkCommandBuffer command_buffer);
+
+// Submits one simulation step to the dedicated compute queue for a frame slot that was waited
+// on. The frame then draws descriptor set compute->target, and its graphics submission adds
+// compute_graphics_semaphores.
+bool particles_submit_update(
+    const particles_t *particles,
+    compute_t         *compute,
+    uint32_t           frame_index
+);
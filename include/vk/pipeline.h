@@ -13,6 +13,32 @@ typedef struct {
     VkPipeline       vk_pipeline;
 } pipeline_t;
 
-bool pipeline_create(pipeline_t *pipeline, const device_t *device, const renderpass_t *renderpass);
+#define PIPELINE_MAX_SET_LAYOUTS 4
+
+typedef enum {
+    // The plain triangle, no descriptor sets.
+    PIPELINE_VARIANT_TRIANGLE = 0,
+    // Per-instance transforms from set 0 and per-frame data from set 1.
+    PIPELINE_VARIANT_INSTANCED,
+    // One point per particle, read from the storage buffer in set 0.
+    PIPELINE_VARIANT_PARTICLES,
+    // Indirect draws of the culled objects in set 0, the view from per-frame data in set 1.
+    PIPELINE_VARIANT_OBJECTS,
+    // Per-draw materials from the global bindless table in set 0, addressed by push constants.
+    PIPELINE_VARIANT_BINDLESS
+} pipeline_variant_t;
+
+// The shaders a variant is built from, as SHADER_BIT mask.
+uint32_t pipeline_variant_shaders(pipeline_variant_t variant);
+
+bool pipeline_create(
+    pipeline_t                  *pipeline,
+    const device_t              *device,
+    const renderpass_t          *renderpass,
+    VkPipelineCache              vk_pipeline_cache,
+    pipeline_variant_t           variant,
+    const VkDescriptorSetLayout *vk_set_layouts,
+    uint32_t                     vk_set_layouts_count
+);
 
 void pipeline_destroy(pipeline_t *pipeline, const device_t *device);
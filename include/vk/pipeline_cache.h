@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+typedef struct {
+    VkPipelineCache vk_pipeline_cache;
+    const char     *path;
+
+    // True when the cache was seeded from a valid file for this device.
+    bool   warm;
+    size_t loaded_size;
+} pipeline_cache_t;
+
+bool pipeline_cache_create(
+    pipeline_cache_t *pipeline_cache,
+    const device_t   *device,
+    const char       *path
+);
+
+bool pipeline_cache_save(const pipeline_cache_t *pipeline_cache, const device_t *device);
+
+void pipeline_cache_destroy(pipeline_cache_t *pipeline_cache, const device_t *device);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "pipeline.h"
+#include "renderpass.h"
+
+typedef enum {
+    PIPELINE_JOB_PENDING = 0,
+    PIPELINE_JOB_READY,
+    PIPELINE_JOB_FAILED
+} pipeline_job_status_t;
+
+// Handle for one submitted pipeline build, owned by the caller until taken or cancelled.
+typedef struct pipeline_job {
+    const renderpass_t   *renderpass;
+    pipeline_t            pipeline;
+    pipeline_job_status_t status;
+    bool                  running;
+
+    uint64_t submit_ns;
+    uint64_t ready_ns;
+
+    struct pipeline_job *next;
+} pipeline_job_t;
+
+typedef struct {
+    const device_t       *device;
+    VkPipelineCache       vk_pipeline_cache;
+    pipeline_variant_t    variant;
+    VkDescriptorSetLayout vk_set_layouts[PIPELINE_MAX_SET_LAYOUTS];
+    uint32_t              vk_set_layouts_count;
+
+    pthread_t thread;
+    bool      started;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    bool            has_sync_objects;
+
+    pipeline_job_t *head;
+    pipeline_job_t *tail;
+    bool            running;
+    bool            quit;
+} pipeline_compiler_t;
+
+bool pipeline_compiler_create(
+    pipeline_compiler_t         *compiler,
+    const device_t              *device,
+    VkPipelineCache              vk_pipeline_cache,
+    pipeline_variant_t           variant,
+    const VkDescriptorSetLayout *vk_set_layouts,
+    uint32_t                     vk_set_layouts_count
+);
+
+void pipeline_compiler_destroy(pipeline_compiler_t *compiler);
+
+pipeline_job_t *
+pipeline_compiler_submit(pipeline_compiler_t *compiler, const renderpass_t *renderpass);
+
+pipeline_job_status_t pipeline_compiler_poll(pipeline_compiler_t *compiler, pipeline_job_t *job);
+
+pipeline_job_status_t pipeline_compiler_wait(pipeline_compiler_t *compiler, pipeline_job_t *job);
+
+bool pipeline_compiler_take(
+    pipeline_compiler_t *compiler,
+    pipeline_job_t      *job,
+    pipeline_t          *pipeline
+);
+
+void pipeline_compiler_cancel(pipeline_compiler_t *compiler, pipeline_job_t *job);
+
+bool pipeline_compiler_idle(pipeline_compiler_t *compiler);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "pipeline.h"
+#include "pipeline_compiler.h"
+#include "renderpass.h"
+
+#define PIPELINE_SET_MAX_FORMATS 16
+
+typedef struct {
+    VkFormat vk_format;
+
+    // Format-only render pass the pipeline is built against, compatible with the live one.
+    renderpass_t    renderpass;
+    pipeline_job_t *job;
+    pipeline_t      pipeline;
+    bool            ready;
+    uint64_t        compile_ns;
+
+    // Replacement built from reloaded shaders while the pipeline above stays in use.
+    pipeline_job_t *rebuild_job;
+} pipeline_set_entry_t;
+
+// One pipeline per color format, so a surface format change is a lookup instead of a compile.
+typedef struct {
+    const device_t      *device;
+    pipeline_compiler_t *compiler;
+    VkImageLayout        vk_final_layout;
+    bool                 dynamic_rendering;
+
+    pipeline_set_entry_t entries[PIPELINE_SET_MAX_FORMATS];
+    uint32_t             entries_count;
+} pipeline_set_t;
+
+void pipeline_set_init(
+    pipeline_set_t      *pipeline_set,
+    const device_t      *device,
+    pipeline_compiler_t *compiler,
+    VkImageLayout        vk_final_layout,
+    bool                 dynamic_rendering
+);
+
+void pipeline_set_destroy(pipeline_set_t *pipeline_set);
+
+bool pipeline_set_request(pipeline_set_t *pipeline_set, VkFormat vk_format);
+
+bool pipeline_set_poll(
+    pipeline_set_t    *pipeline_set,
+    VkFormat           vk_format,
+    const pipeline_t **pipeline
+);
+
+bool pipeline_set_wait(pipeline_set_t *pipeline_set, VkFormat vk_format);
+
+uint64_t pipeline_set_compile_ns(const pipeline_set_t *pipeline_set, VkFormat vk_format);
+
+// True if the set's pipelines are built from any of the shaders in the SHADER_BIT mask. All of
+// them share the compiler's variant, so a change affects either all or none.
+bool pipeline_set_uses(const pipeline_set_t *pipeline_set, uint32_t shaders);
+
+bool pipeline_set_rebuild(pipeline_set_t *pipeline_set);
+
+bool pipeline_set_rebuilt(pipeline_set_t *pipeline_set);
+
+uint32_t pipeline_set_swap(pipeline_set_t *pipeline_set);
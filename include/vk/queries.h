@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+typedef struct {
+    uint64_t gpu_ns;
+
+    bool     has_statistics;
+    uint64_t vertex_invocations;
+    uint64_t fragment_invocations;
+} queries_result_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t gpu_ns;
+    uint64_t max_gpu_ns;
+    uint64_t statistics_frames;
+    uint64_t vertex_invocations;
+    uint64_t fragment_invocations;
+} queries_stats_t;
+
+typedef struct {
+    // Two timestamps and one pipeline statistics query per frame in flight.
+    VkQueryPool vk_timestamp_pool;
+    VkQueryPool vk_statistics_pool;
+    uint64_t    timestamp_mask;
+    float       timestamp_period;
+
+    // Statistics the pool counts, and the ones secondary buffers executed inside the query
+    // inherit: the same with the inheritedQueries feature, 0 without it.
+    VkQueryPipelineStatisticFlags statistics;
+    VkQueryPipelineStatisticFlags inherited_statistics;
+
+    uint32_t frame_count;
+    bool    *pending;
+    bool    *statistics_pending;
+
+    bool             has_latest;
+    queries_result_t latest;
+    queries_stats_t  stats;
+} queries_t;
+
+bool queries_create(queries_t *queries, const device_t *device, uint32_t frame_count);
+
+void queries_destroy(queries_t *queries, const device_t *device);
+
+// With secondaries, the statistics query is only begun if they can inherit it.
+void queries_cmd_begin(
+    queries_t      *queries,
+    VkCommandBuffer command_buffer,
+    uint32_t        frame_index,
+    bool            secondaries
+);
+
+void queries_cmd_end(queries_t *queries, VkCommandBuffer command_buffer, uint32_t frame_index);
+
+bool queries_collect(queries_t *queries, const device_t *device, uint32_t frame_index);
+
+void queries_log_stats(const queries_t *queries);
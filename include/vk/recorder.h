@@ -0,0 +1,80 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+#define RECORDER_MAX_THREADS 64
+
+// Records items [first, first + count) into a secondary buffer inside the render pass, or
+// inside dynamic rendering when no render pass is given.
+typedef void (*recorder_record_fn)(
+    VkCommandBuffer command_buffer,
+    const void     *user,
+    uint32_t        first,
+    uint32_t        count
+);
+
+typedef struct {
+    VkRenderPass       vk_render_pass;
+    VkFramebuffer      vk_framebuffer;
+    VkFormat           vk_color_format;
+    uint32_t           frame_index;
+    uint32_t           item_count;
+    recorder_record_fn record;
+    const void        *user;
+
+    // Statistics of the query active in the primary, 0 if none is.
+    VkQueryPipelineStatisticFlags pipeline_statistics;
+} recorder_job_t;
+
+typedef struct recorder recorder_t;
+
+typedef struct {
+    recorder_t *recorder;
+    uint32_t    index;
+    pthread_t   thread;
+    bool        started;
+    bool        ok;
+
+    // One pool per frame in flight, reset as a whole once the frame has retired.
+    VkCommandPool   *vk_pools;
+    VkCommandBuffer *vk_buffers;
+} recorder_worker_t;
+
+struct recorder {
+    const device_t *device;
+
+    uint32_t           thread_count;
+    uint32_t           frame_count;
+    recorder_worker_t *workers;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  start_cond;
+    pthread_cond_t  done_cond;
+    bool            has_sync_objects;
+
+    recorder_job_t job;
+    uint64_t       generation;
+    uint32_t       pending;
+    bool           quit;
+};
+
+bool recorder_create(
+    recorder_t     *recorder,
+    const device_t *device,
+    uint32_t        thread_count,
+    uint32_t        frame_count
+);
+
+void recorder_destroy(recorder_t *recorder);
+
+bool recorder_record(
+    recorder_t           *recorder,
+    const recorder_job_t *job,
+    VkCommandBuffer       vk_secondary_buffers[RECORDER_MAX_THREADS]
+);
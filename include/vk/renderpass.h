@@ -6,29 +6,59 @@
 #include <vulkan/vulkan.h>
 
 #include "device.h"
+#include "offscreen.h"
+#include "retire.h"
 #include "swapchain.h"
 
 typedef struct {
-    VkRenderPass vk_render_pass;
-
+    // Both stay empty with dynamic rendering, which begins rendering on the target views.
+    VkRenderPass   vk_render_pass;
     VkFramebuffer *vk_framebuffers;
     uint32_t       vk_framebuffers_count;
 
-    VkFormat vk_color_format;
+    bool dynamic_rendering;
+
+    // Borrowed from the swapchain or offscreen targets.
+    const VkImage     *vk_images;
+    const VkImageView *vk_image_views;
+    uint32_t           vk_image_count;
+
+    VkFormat      vk_color_format;
+    VkImageLayout vk_final_layout;
 } renderpass_t;
 
+// Render pass only, without targets; compatible with any renderpass_t of the same format.
+bool renderpass_create_format(
+    renderpass_t   *renderpass,
+    const device_t *device,
+    VkFormat        vk_color_format,
+    VkImageLayout   vk_final_layout,
+    bool            dynamic_rendering
+);
+
 bool renderpass_create(
     renderpass_t      *renderpass,
     const device_t    *device,
-    const swapchain_t *swapchain
+    const swapchain_t *swapchain,
+    bool               dynamic_rendering
+);
+
+bool renderpass_create_offscreen(
+    renderpass_t      *renderpass,
+    const device_t    *device,
+    const offscreen_t *offscreen,
+    bool               dynamic_rendering
 );
 
 void renderpass_destroy(renderpass_t *renderpass, const device_t *device);
 
+void renderpass_retire(renderpass_t *renderpass, retire_entry_t *retired);
+
 bool renderpass_recreate_framebuffers(
     renderpass_t      *renderpass,
     const device_t    *device,
-    const swapchain_t *swapchain
+    const swapchain_t *swapchain,
+    retire_entry_t    *retired
 );
 
 bool renderpass_has_format_mismatch(const renderpass_t *renderpass, const swapchain_t *swapchain);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+
+#define RETIRE_MAX_ENTRIES 8
+
+// Objects replaced by a swapchain recreation that pending frames may still reference.
+typedef struct {
+    VkSwapchainKHR vk_swapchain;
+    VkImage       *vk_images;
+    VkImageView   *vk_image_views;
+    uint32_t       vk_image_views_count;
+
+    VkRenderPass   vk_render_pass;
+    VkFramebuffer *vk_framebuffers;
+    uint32_t       vk_framebuffers_count;
+
+    // Frame slots whose fences have not been waited on since the entry was retired.
+    uint32_t pending_frames;
+} retire_entry_t;
+
+// Deferred destruction queue. An entry is released once every frame slot has waited on its
+// submit and present fences after the retirement, which covers all presents to the old
+// swapchain.
+typedef struct {
+    retire_entry_t entries[RETIRE_MAX_ENTRIES];
+    uint32_t       entries_count;
+
+    uint64_t retired;
+    uint64_t released;
+    uint64_t forced;
+} retire_t;
+
+void retire_push(
+    retire_t       *retire,
+    const device_t *device,
+    retire_entry_t *entry,
+    uint32_t        frame_count
+);
+
+void retire_frame_waited(retire_t *retire, const device_t *device, uint32_t frame_index);
+
+void retire_flush(retire_t *retire, const device_t *device);
+
+void retire_log_stats(const retire_t *retire);
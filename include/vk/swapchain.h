@@ -7,12 +7,37 @@
 
 #include "device.h"
 #include "platform_window.h"
+#include "retire.h"
+
+#define SWAPCHAIN_MAX_PRESENT_MODES 8
 
 typedef struct {
     VkSwapchainKHR vk_swapchain;
     VkFormat       vk_image_format;
     VkExtent2D     extent;
 
+    // Format preferred on recreation if the surface offers it, VK_FORMAT_UNDEFINED for the
+    // default choice.
+    VkFormat vk_format_requested;
+
+    // Present scaling (surface_maintenance1): when set, the presentation engine scales the images
+    // to the window, so a size change does not require recreation. 0 when not in use.
+    bool                     present_scaling_requested;
+    VkPresentScalingFlagsEXT present_scaling;
+
+    // Mode of the next present, preferred again on recreation. The swapchain can switch between
+    // vk_present_modes per present without being recreated.
+    VkPresentModeKHR vk_present_mode;
+    VkPresentModeKHR vk_present_modes[SWAPCHAIN_MAX_PRESENT_MODES];
+    uint32_t         vk_present_modes_count;
+
+    // minImageCount asked for, 0 for the surface minimum plus one. min_image_count is what
+    // creation used after clamping to the surface range.
+    uint32_t image_count_requested;
+    uint32_t min_image_count;
+    uint32_t surface_min_image_count;
+    uint32_t surface_max_image_count;
+
     uint32_t     vk_image_count;
     VkImage     *vk_images;
     VkImageView *vk_image_views;
@@ -22,14 +47,29 @@ bool swapchain_create(
     swapchain_t             *swapchain,
     const device_t          *device,
     VkSurfaceKHR             vk_surface,
-    const platform_window_t *window
+    const platform_window_t *window,
+    VkPresentModeKHR         present_mode,
+    bool                     present_scaling,
+    uint32_t                 image_count
 );
 
 bool swapchain_recreate(
     swapchain_t             *swapchain,
     const device_t          *device,
     VkSurfaceKHR             vk_surface,
-    const platform_window_t *window
+    const platform_window_t *window,
+    retire_entry_t          *retired
 );
 
 void swapchain_destroy(swapchain_t *swapchain, const device_t *device);
+
+uint32_t swapchain_surface_formats(
+    const device_t *device,
+    VkSurfaceKHR    vk_surface,
+    VkFormat       *vk_formats,
+    uint32_t        capacity
+);
+
+bool swapchain_set_present_mode(swapchain_t *swapchain, VkPresentModeKHR present_mode);
+
+const char *swapchain_present_mode_str(VkPresentModeKHR present_mode);
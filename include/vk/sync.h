@@ -7,14 +7,60 @@
 
 #include "device.h"
 
+typedef enum {
+    SYNC_MODE_FENCE = 0,
+    SYNC_MODE_TIMELINE,
+} sync_mode_t;
+
+// Calls on the frame pacing primitive, and separately on the present fences, which both modes
+// use when presenting with swapchain_maintenance1.
+typedef struct {
+    uint64_t frames;
+    uint64_t host_waits;
+    uint64_t host_resets;
+
+    uint64_t present_polls;
+    uint64_t present_waits;
+    uint64_t present_resets;
+} sync_stats_t;
+
 typedef struct {
+    sync_mode_t mode;
+
     VkSemaphore *vk_semaphore_image_available;
     VkSemaphore *vk_semaphore_render_finished;
-    VkFence     *vk_fence_in_flight;
-    VkFence     *vk_fence_present_done;
+    uint32_t     render_finished_count;
+
+    // SYNC_MODE_FENCE
+    VkFence *vk_fence_in_flight;
+
+    // Present fences (swapchain_maintenance1), in both modes when presenting.
+    VkFence *vk_fence_present_done;
+
+    // SYNC_MODE_TIMELINE: submission n signals n, so frame n waits for n - frame_count.
+    VkSemaphore vk_timeline;
+    uint64_t    timeline_value;
+
     uint32_t     frame_count;
+    sync_stats_t stats;
 } sync_t;
 
-bool sync_create(sync_t *sync, const device_t *device, uint32_t frame_count);
+bool sync_create(
+    sync_t         *sync,
+    const device_t *device,
+    sync_mode_t     mode,
+    uint32_t        frame_count,
+    uint32_t        image_count
+);
 
 void sync_destroy(sync_t *sync, const device_t *device);
+
+bool sync_wait_frame(sync_t *sync, const device_t *device, uint32_t frame_index);
+
+bool sync_wait_all(const sync_t *sync, const device_t *device);
+
+bool sync_reset_frame(sync_t *sync, const device_t *device, uint32_t frame_index);
+
+void sync_log_stats(const sync_t *sync);
+
+const char *sync_mode_str(sync_mode_t mode);
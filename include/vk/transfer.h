@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "memory.h"
+
+#define TRANSFER_MAX_JOBS 16
+
+// One upload in flight: the staging copy and, with a dedicated transfer family, the semaphore
+// and acquire command buffer that hand the buffer to the graphics queue.
+typedef struct {
+    VkBuffer            staging_buffer;
+    memory_allocation_t staging_allocation;
+
+    VkCommandBuffer vk_transfer_buffer;
+    VkCommandBuffer vk_acquire_buffer;
+    VkSemaphore     vk_semaphore;
+    VkFence         vk_fence;
+} transfer_job_t;
+
+// Uploads into device-local buffers on the dedicated transfer queue when there is one. The
+// engine handles the queue family ownership release and acquire and the semaphore between the
+// two queues; callers only name the stages and accesses that will read the data on the
+// graphics queue. Submissions to the graphics queue made afterwards see the data.
+typedef struct {
+    const device_t *device;
+    memory_t       *memory;
+    bool            dedicated;
+
+    VkCommandPool vk_transfer_pool;
+    VkCommandPool vk_graphics_pool;
+
+    transfer_job_t jobs[TRANSFER_MAX_JOBS];
+    uint32_t       jobs_count;
+
+    uint64_t uploads;
+    uint64_t bytes;
+} transfer_t;
+
+bool transfer_create(transfer_t *transfer, const device_t *device, memory_t *memory);
+
+void transfer_destroy(transfer_t *transfer);
+
+bool transfer_upload_buffer(
+    transfer_t          *transfer,
+    VkBuffer             dst_buffer,
+    VkDeviceSize         dst_offset,
+    const void          *data,
+    VkDeviceSize         size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+);
+
+// For a buffer created with VK_SHARING_MODE_CONCURRENT over the transfer and graphics families
+// (and any others): the same upload without a queue family ownership transfer.
+bool transfer_upload_concurrent_buffer(
+    transfer_t          *transfer,
+    VkBuffer             dst_buffer,
+    VkDeviceSize         dst_offset,
+    const void          *data,
+    VkDeviceSize         size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+);
+
+// Releases the staging memory of finished uploads.
+bool transfer_collect(transfer_t *transfer);
+
+bool transfer_wait_all(transfer_t *transfer);
+
+void transfer_log_stats(const transfer_t *transfer);
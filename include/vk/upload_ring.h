@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "device.h"
+#include "memory.h"
+
+#define UPLOAD_RING_MAX_REGIONS 16
+
+typedef struct {
+    void        *data;
+    uint32_t     offset; // dynamic offset into the ring's descriptor bindings
+    VkDeviceSize size;
+} upload_slice_t;
+
+// Host-visible, persistently mapped buffer split into one region per frame in flight. A region
+// is reset once its frame's fence has signalled; allocations within it are a lock-free bump of
+// the region's head. Shaders read the data through a descriptor set with a dynamic uniform
+// (binding 0) and a dynamic storage buffer (binding 1), visible to graphics and compute stages,
+// so per-frame updates need neither vkMapMemory nor descriptor writes.
+typedef struct {
+    memory_t           *memory;
+    VkBuffer            vk_buffer;
+    memory_allocation_t allocation;
+    bool                coherent;
+
+    uint32_t     region_count;
+    VkDeviceSize region_size;
+    VkDeviceSize alignment;
+    VkDeviceSize non_coherent_atom_size;
+    VkDeviceSize binding_range;
+
+    _Atomic(uint64_t) heads[UPLOAD_RING_MAX_REGIONS];
+
+    VkDescriptorSetLayout vk_set_layout;
+    VkDescriptorPool      vk_descriptor_pool;
+    VkDescriptorSet       vk_descriptor_set;
+
+    VkDeviceSize      peak_bytes;
+    uint64_t          flushes;
+    _Atomic(uint64_t) overflows;
+} upload_ring_t;
+
+bool upload_ring_create(
+    upload_ring_t  *ring,
+    const device_t *device,
+    memory_t       *memory,
+    uint32_t        region_count,
+    VkDeviceSize    region_size,
+    VkDeviceSize    binding_range
+);
+
+void upload_ring_destroy(upload_ring_t *ring, const device_t *device);
+
+// The caller guarantees the GPU is done with the region, e.g. after waiting on its frame.
+void upload_ring_begin(upload_ring_t *ring, uint32_t region);
+
+bool upload_ring_alloc(
+    upload_ring_t  *ring,
+    uint32_t        region,
+    VkDeviceSize    size,
+    upload_slice_t *slice
+);
+
+// One flush covering everything allocated in the region, before the submit reading it. Writes
+// from other threads must be ordered before this call.
+bool upload_ring_flush(upload_ring_t *ring, const device_t *device, uint32_t region);
+
+void upload_ring_log_stats(upload_ring_t *ring);
@@ -0,0 +1,37 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) out vec3 fragColor;
+
+struct Material {
+    vec4 transform; // offset xy, scale, rotation
+    vec4 color;
+};
+
+// The global table; every registered storage buffer is one element.
+layout(std430, set = 0, binding = 0) readonly buffer Materials {
+    Material materials[];
+} buffers[];
+
+// Buffer handle and element index of this draw's material.
+layout(push_constant) uniform Draw {
+    uvec4 handles;
+} draw;
+
+vec2 positions[3] = vec2[](
+    vec2(0.0, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+void main() {
+    // Push constants are dynamically uniform, so the index needs no nonuniformEXT.
+    Material material = buffers[draw.handles.x].materials[draw.handles.y];
+
+    float s = sin(material.transform.w);
+    float c = cos(material.transform.w);
+    vec2 p = mat2(c, s, -s, c) * positions[gl_VertexIndex] * material.transform.z;
+
+    gl_Position = vec4(p + material.transform.xy, 0.0, 1.0);
+    fragColor = material.color.rgb;
+}
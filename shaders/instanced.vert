@@ -0,0 +1,37 @@
+#version 450
+
+layout(location = 0) out vec3 fragColor;
+
+struct Instance {
+    vec4 transform; // offset xy, scale, rotation
+    vec4 color;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+// Streamed every frame through the upload ring.
+layout(set = 1, binding = 0) uniform Frame {
+    vec4 rotation; // cos, sin, seconds, unused
+} frame;
+
+vec2 positions[3] = vec2[](
+    vec2(0.0, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+
+    float s = sin(instance.transform.w);
+    float c = cos(instance.transform.w);
+    vec2 p = mat2(c, s, -s, c) * positions[gl_VertexIndex] * instance.transform.z;
+
+    vec2 q = mat2(frame.rotation.x, frame.rotation.y, -frame.rotation.y, frame.rotation.x)
+           * (p + instance.transform.xy);
+
+    gl_Position = vec4(q, 0.0, 1.0);
+    fragColor = instance.color.rgb;
+}
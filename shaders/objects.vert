@@ -0,0 +1,37 @@
+#version 450
+
+layout(location = 0) out vec3 fragColor;
+
+struct Object {
+    vec4 bounds; // center xy, radius, rotation
+    vec4 color;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+// Streamed every frame through the upload ring.
+layout(set = 1, binding = 0) uniform Frame {
+    vec4 rotation; // cos, sin, seconds, unused
+    vec4 view;     // center xy, scale xy
+    vec4 planes[4];
+} frame;
+
+vec2 positions[3] = vec2[](
+    vec2(0.0, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+void main() {
+    // The cull pass stores the object index as the command's firstInstance.
+    Object object = objects[gl_InstanceIndex];
+
+    float s = sin(object.bounds.w);
+    float c = cos(object.bounds.w);
+    vec2 p = mat2(c, s, -s, c) * positions[gl_VertexIndex] * object.bounds.z + object.bounds.xy;
+
+    gl_Position = vec4((p - frame.view.xy) * frame.view.zw, 0.0, 1.0);
+    fragColor = object.color.rgb;
+}
@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) out vec3 fragColor;
+
+layout(std430, set = 0, binding = 0) readonly buffer Particles {
+    vec4 particles[]; // position xy, velocity xy
+};
+
+void main() {
+    vec4 particle = particles[gl_VertexIndex];
+
+    gl_Position = vec4(particle.xy, 0.0, 1.0);
+    gl_PointSize = 1.0;
+    fragColor = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.6, 0.2), clamp(length(particle.zw), 0.0, 1.0));
+}
@@ -1,152 +1,1163 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "app.h"
 
 #include <assert.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "util/clock.h"
 #include "util/log.h"
+#include "util/shader.h"
 #include "vk/debug.h"
-#include "vk/draw.h"
 
-const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+// Frames presented with the pipeline between two --format-switches.
+#define APP_FORMAT_SWITCH_FRAMES 30
 
-bool app_create(app_t *app) {
-    assert(app != NULL);
-    memset(app, 0, sizeof(*app));
+static volatile sig_atomic_t app_stats_requested        = 0;
+static volatile sig_atomic_t app_present_mode_requested = 0;
+
+static void app_request_stats(int signal_number) {
+    app_stats_requested = 1;
+}
+
+static void app_request_present_mode(int signal_number) {
+    app_present_mode_requested = 1;
+}
 
+static bool app_create_presentation(app_t *app) {
     if (!platform_init()) {
         log_error("APP Failed to initialize platform.");
-        app_destroy(app);
         return false;
     }
 
     if (!platform_window_create(&app->window, 800, 600, "Vulkan Hello Triangle")) {
         log_error("APP Failed to create platform window.");
-        app_destroy(app);
         return false;
     }
 
-    if (!instance_create(&app->instance)) {
+    if (!instance_create(&app->instance, false)) {
         log_error("APP Failed to create vulkan instance.");
-        app_destroy(app);
         return false;
     }
 
     if (!platform_window_surface_create(app->window, app->instance.vk_instance, &app->surface)) {
         log_error("APP Failed to create surface.");
-        app_destroy(app);
         return false;
     }
 
     if (!device_create(&app->device, app->instance.vk_instance, app->surface)) {
         log_error("APP Failed to create device.");
-        app_destroy(app);
         return false;
     }
 
-    if (!swapchain_create(&app->swapchain, &app->device, app->surface, app->window)) {
+    if (!memory_create(&app->memory, &app->device, MEMORY_DEFAULT_BLOCK_SIZE)) {
+        log_error("APP Failed to create memory allocator.");
+        return false;
+    }
+
+    if (!swapchain_create(
+            &app->swapchain,
+            &app->device,
+            app->surface,
+            app->window,
+            app->config.present_mode,
+            app->config.present_scaling,
+            app->config.swapchain_images_auto ? 0 : app->config.swapchain_images
+        )) {
         log_error("APP Failed to create swapchain.");
-        app_destroy(app);
         return false;
     }
+    app->resize_extent = app->swapchain.extent;
 
-    if (!renderpass_create(&app->renderpass, &app->device, &app->swapchain)) {
+    log_debug(
+        "(APP) present mode %s (requested %s), %u switchable without recreation.",
+        swapchain_present_mode_str(app->swapchain.vk_present_mode),
+        swapchain_present_mode_str(app->config.present_mode),
+        app->swapchain.vk_present_modes_count
+    );
+    if (app->config.swapchain_images_auto) {
+        image_count_policy_init(
+            &app->image_count_policy,
+            app->swapchain.surface_min_image_count,
+            app->swapchain.surface_max_image_count,
+            (uint64_t)app->config.acquire_stall_us * 1000ULL
+        );
+    }
+    if (app->swapchain.present_scaling != 0) {
+        log_debug(
+            "(APP) present scaling 0x%x, recreating after %u ms of stable size.",
+            (unsigned)app->swapchain.present_scaling,
+            app->config.resize_settle_ms
+        );
+    }
+
+    if (!renderpass_create(
+            &app->renderpass, &app->device, &app->swapchain, app->config.dynamic_rendering
+        )) {
         log_error("APP Failed to create renderpass.");
-        app_destroy(app);
         return false;
     }
 
-    if (!pipeline_create(&app->pipeline, &app->device, &app->renderpass)) {
+    return true;
+}
+
+static bool app_create_offscreen(app_t *app) {
+    if (!instance_create(&app->instance, true)) {
+        log_error("APP Failed to create vulkan instance.");
+        return false;
+    }
+
+    if (!device_create(&app->device, app->instance.vk_instance, VK_NULL_HANDLE)) {
+        log_error("APP Failed to create device.");
+        return false;
+    }
+
+    if (!memory_create(&app->memory, &app->device, MEMORY_DEFAULT_BLOCK_SIZE)) {
+        log_error("APP Failed to create memory allocator.");
+        return false;
+    }
+
+    if (!offscreen_create(
+            &app->offscreen,
+            &app->device,
+            &app->memory,
+            app->config.headless_extent,
+            app->config.frames_in_flight_max
+        )) {
+        log_error("APP Failed to create offscreen targets.");
+        return false;
+    }
+
+    if (!renderpass_create_offscreen(
+            &app->renderpass, &app->device, &app->offscreen, app->config.dynamic_rendering
+        )) {
+        log_error("APP Failed to create renderpass.");
+        return false;
+    }
+
+    return true;
+}
+
+static uint32_t app_presented_image_count(const app_t *app) {
+    return app->config.headless ? 0 : app->swapchain.vk_image_count;
+}
+
+static const instances_t *app_instances(const app_t *app) {
+    return app->instances.count > 0 ? &app->instances : NULL;
+}
+
+static const particles_t *app_particles(const app_t *app) {
+    return app->particles.count > 0 ? &app->particles : NULL;
+}
+
+static compute_t *app_compute(app_t *app) {
+    return app->compute.device != NULL ? &app->compute : NULL;
+}
+
+static const objects_t *app_objects(const app_t *app) {
+    return app->objects.count > 0 ? &app->objects : NULL;
+}
+
+static const materials_t *app_materials(const app_t *app) {
+    return app->materials.count > 0 ? &app->materials : NULL;
+}
+
+static upload_ring_t *app_upload_ring(app_t *app) {
+    return app->upload_ring.region_count > 0 ? &app->upload_ring : NULL;
+}
+
+// Recorded once the pipeline is ready; until then frames are recorded per frame. Particles
+// stepped on the compute queue alternate their buffers per frame and are always recorded per
+// frame.
+static bool app_record_static(app_t *app) {
+    if (!app->config.record_once || app->pipeline == NULL || app_compute(app) != NULL) {
+        return true;
+    }
+
+    VkExtent2D extent      = app->swapchain.extent;
+    uint32_t   image_count = app->swapchain.vk_image_count;
+    if (app->config.headless) {
+        extent      = app->offscreen.extent;
+        image_count = app->offscreen.vk_image_count;
+    }
+
+    // Rerecording resets buffers that earlier frames may still be executing.
+    if (app->commands.vk_static_buffers != NULL && !sync_wait_all(&app->sync, &app->device)) {
+        return false;
+    }
+
+    if (!commands_record_static(
+            &app->commands, &app->device, &app->renderpass, app->pipeline, extent, image_count
+        )) {
+        log_error("APP Failed to record static commands.");
+        return false;
+    }
+
+    return true;
+}
+
+// Queues the current format first, then every other format the surface offers, so moving
+// to a monitor with another format finds its pipeline prebuilt.
+static bool app_request_pipelines(app_t *app) {
+    VkImageLayout vk_final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    if (app->config.headless) {
+        vk_final_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    pipeline_set_init(
+        &app->pipeline_set,
+        &app->device,
+        &app->pipeline_compiler,
+        vk_final_layout,
+        app->config.dynamic_rendering
+    );
+
+    if (!pipeline_set_request(&app->pipeline_set, app->renderpass.vk_color_format)) {
+        log_error("APP Failed to submit pipeline.");
+        return false;
+    }
+
+    if (app->config.headless || !app->config.format_prebuild) {
+        return true;
+    }
+
+    VkFormat vk_formats[PIPELINE_SET_MAX_FORMATS];
+    uint32_t vk_formats_count = swapchain_surface_formats(
+        &app->device, app->surface, vk_formats, PIPELINE_SET_MAX_FORMATS
+    );
+    for (uint32_t i = 0; i < vk_formats_count; ++i) {
+        if (!pipeline_set_request(&app->pipeline_set, vk_formats[i])) {
+            log_warn("(APP) pipeline for format %d is built on demand.", (int)vk_formats[i]);
+        }
+    }
+
+    return true;
+}
+
+static bool app_poll_pipeline(app_t *app) {
+    if (app->pipeline != NULL) {
+        return true;
+    }
+
+    VkFormat vk_format = app->renderpass.vk_color_format;
+    if (!pipeline_set_poll(&app->pipeline_set, vk_format, &app->pipeline)) {
+        log_error("APP Failed to create pipeline.");
+        return false;
+    }
+
+    if (app->pipeline == NULL) {
+        return true;
+    }
+
+    if (app->pipeline_ns == 0) {
+        app->pipeline_ns = pipeline_set_compile_ns(&app->pipeline_set, vk_format);
+        log_debug(
+            "(APP) pipeline ready after %.3f ms (%s cache).",
+            clock_ns_to_ms(app->pipeline_ns),
+            app->pipeline_cache.warm ? "warm" : "cold"
+        );
+    }
+
+    return app_record_static(app);
+}
+
+// Builds replacements for the compute pipelines made from a changed shader, on this thread since
+// they are few and small. A failed build keeps the old pipeline. Returns how many were built.
+static uint32_t app_rebuild_compute_pipelines(app_t *app, uint32_t shaders) {
+    uint32_t rebuilt = 0;
+
+    if (app->particles.count > 0 && (shaders & SHADER_BIT(SHADER_PARTICLES_COMPUTE)) != 0) {
+        if (particles_rebuild_pipeline(
+                &app->particles, &app->device, app->pipeline_cache.vk_pipeline_cache
+            )) {
+            ++rebuilt;
+        } else {
+            log_warn("(APP) particles pipeline rebuild failed, keeping the old one.");
+        }
+    }
+
+    if (app->objects.count > 0 && (shaders & SHADER_BIT(SHADER_OBJECTS_CULL)) != 0) {
+        if (objects_rebuild_pipeline(
+                &app->objects,
+                &app->device,
+                app->pipeline_cache.vk_pipeline_cache,
+                app->upload_ring.vk_set_layout
+            )) {
+            ++rebuilt;
+        } else {
+            log_warn("(APP) objects pipeline rebuild failed, keeping the old one.");
+        }
+    }
+
+    return rebuilt;
+}
+
+// Changed files are remapped only while the compiler is idle, since builds read the mapped
+// code. Only the pipelines built from a changed file are rebuilt, and the replacements take
+// over in one step once all of them are done.
+static bool app_poll_shaders(app_t *app) {
+    if (!app->config.shader_reload) {
+        return true;
+    }
+
+    shader_watch_poll(&app->shader_watch);
+
+    if (app->shader_rebuilding) {
+        if (!pipeline_set_rebuilt(&app->pipeline_set)) {
+            return true;
+        }
+
+        // Pending frames may still execute the pipelines about to be destroyed.
+        if (!sync_wait_all(&app->sync, &app->device)) {
+            return false;
+        }
+
+        uint32_t swapped = pipeline_set_swap(&app->pipeline_set);
+        swapped += particles_swap_pipeline(&app->particles, &app->device) ? 1 : 0;
+        swapped += objects_swap_pipeline(&app->objects, &app->device) ? 1 : 0;
+
+        app->shader_rebuilding = false;
+        ++app->shader_reloads;
+        log_debug(
+            "(APP) %u pipelines swapped %.3f ms after the shader change.",
+            swapped,
+            clock_ns_to_ms(clock_now_ns() - app->shader_changed_ns)
+        );
+
+        commands_invalidate_static(&app->commands);
+        return app_record_static(app);
+    }
+
+    shader_watch_t *watch = &app->shader_watch;
+    if ((watch->pending_count == 0 && !watch->reload_all)
+        || !pipeline_compiler_idle(&app->pipeline_compiler)) {
+        return true;
+    }
+
+    uint32_t changed = 0;
+    if (watch->reload_all) {
+        changed = shader_map_dir(shader_bin_dir());
+    } else {
+        for (uint32_t i = 0; i < watch->pending_count; ++i) {
+            changed |= shader_remap(shader_bin_dir(), watch->pending[i]);
+        }
+    }
+    shader_watch_clear(watch);
+
+    if (changed == 0) {
+        return true;
+    }
+
+    const uint64_t changed_ns = clock_now_ns();
+
+    bool rebuilding = app_rebuild_compute_pipelines(app, changed) > 0;
+    if (pipeline_set_uses(&app->pipeline_set, changed)) {
+        if (!pipeline_set_rebuild(&app->pipeline_set)) {
+            log_error("APP Failed to rebuild pipelines.");
+            return false;
+        }
+        rebuilding = true;
+    }
+
+    if (!rebuilding) {
+        log_debug("(APP) no pipeline to replace after the shader change.");
+        return true;
+    }
+    app->shader_rebuilding = true;
+    app->shader_changed_ns = changed_ns;
+
+    return true;
+}
+
+bool app_wait_pipeline(app_t *app) {
+    if (app->pipeline == NULL
+        && !pipeline_set_wait(&app->pipeline_set, app->renderpass.vk_color_format)) {
         log_error("APP Failed to create pipeline.");
+        return false;
+    }
+
+    return app_poll_pipeline(app);
+}
+
+static void app_log_resize_stats(const app_t *app) {
+    if (app->resize_absorbed > 0) {
+        log_debug(
+            "(APP) %llu size changes presented scaled.", (unsigned long long)app->resize_absorbed
+        );
+    }
+
+    if (app->resize_count == 0) {
+        return;
+    }
+
+    log_debug(
+        "(APP) %llu resizes (%llu format changes), first frame after %.3f ms avg, %.3f ms max.",
+        (unsigned long long)app->resize_count,
+        (unsigned long long)app->resize_format_changes,
+        clock_ns_to_ms(app->resize_total_ns / app->resize_count),
+        clock_ns_to_ms(app->resize_max_ns)
+    );
+}
+
+bool app_create(app_t *app, const app_config_t *config) {
+    assert(app != NULL);
+    memset(app, 0, sizeof(*app));
+
+    const uint64_t start_ns = clock_now_ns();
+
+    app->config           = *config;
+    app->frames_in_flight = config->frames_in_flight;
+
+    bool created = config->headless ? app_create_offscreen(app) : app_create_presentation(app);
+    if (!created) {
         app_destroy(app);
         return false;
     }
 
-    if (!commands_create(&app->commands, &app->device, MAX_FRAMES_IN_FLIGHT)) {
-        log_error("APP Failed to create commands.");
+    // Mapped before any pipeline is built, so compute shaders come from disk as well.
+    if (app->config.shader_reload) {
+        shader_map_dir(shader_bin_dir());
+        if (!shader_watch_create(&app->shader_watch, shader_bin_dir())) {
+            log_warn("(APP) shader files are not watched for changes.");
+        }
+    }
+
+    if (!pipeline_cache_create(
+            &app->pipeline_cache, &app->device, app->config.pipeline_cache_path
+        )) {
+        log_error("APP Failed to create pipeline cache.");
+        app_destroy(app);
+        return false;
+    }
+
+    if (!transfer_create(&app->transfer, &app->device, &app->memory)) {
+        log_error("APP Failed to create transfer queue.");
+        app_destroy(app);
+        return false;
+    }
+
+    // One region per possible frame slot plus one for the record-once buffers. Only the
+    // instanced and objects scenes stream per-frame data.
+    if ((app->config.instance_count > 0 || app->config.object_count > 0)
+        && !upload_ring_create(
+            &app->upload_ring,
+            &app->device,
+            &app->memory,
+            APP_MAX_FRAMES_IN_FLIGHT + 1,
+            (VkDeviceSize)app->config.upload_kib * 1024,
+            (VkDeviceSize)app->config.upload_kib * 1024
+        )) {
+        log_error("APP Failed to create upload ring.");
+        app_destroy(app);
+        return false;
+    }
+
+    if (app->config.instance_count > 0) {
+        if (!instances_create(
+                &app->instances,
+                &app->device,
+                &app->memory,
+                &app->transfer,
+                app->config.instance_count
+            )) {
+            log_error("APP Failed to create instances.");
+            app_destroy(app);
+            return false;
+        }
+        log_debug("(APP) drawing %u instances per draw.", app->instances.count);
+    }
+
+    if (app->config.particle_count > 0) {
+        if (!particles_create(
+                &app->particles,
+                &app->device,
+                &app->memory,
+                &app->transfer,
+                app->pipeline_cache.vk_pipeline_cache,
+                app->config.particle_count
+            )) {
+            log_error("APP Failed to create particles.");
+            app_destroy(app);
+            return false;
+        }
+        log_debug("(APP) simulating %u particles.", app->particles.count);
+
+        // Sized for the deepest frame count, so it outlives frames-in-flight changes.
+        if (app->device.has_compute_queue) {
+            if (!particles_create_compute(
+                    &app->particles, &app->compute, &app->device, APP_MAX_FRAMES_IN_FLIGHT
+                )) {
+                log_error("APP Failed to create compute queue.");
+                app_destroy(app);
+                return false;
+            }
+            log_debug("(APP) particles are stepped on the dedicated compute queue.");
+        }
+    }
+
+    if (app->config.object_count > 0) {
+        if (!objects_create(
+                &app->objects,
+                &app->device,
+                &app->memory,
+                &app->transfer,
+                app->pipeline_cache.vk_pipeline_cache,
+                app->upload_ring.vk_set_layout,
+                app->config.object_count
+            )) {
+            log_error("APP Failed to create objects.");
+            app_destroy(app);
+            return false;
+        }
+    }
+
+    if (app->config.bindless) {
+        if (!bindless_create(&app->bindless, &app->device)) {
+            log_error("APP Failed to create bindless table.");
+            app_destroy(app);
+            return false;
+        }
+        if (!materials_create(
+                &app->materials,
+                &app->device,
+                &app->memory,
+                &app->transfer,
+                &app->bindless,
+                app->config.draw_count
+            )) {
+            log_error("APP Failed to create materials.");
+            app_destroy(app);
+            return false;
+        }
+    }
+
+    pipeline_variant_t    variant              = PIPELINE_VARIANT_TRIANGLE;
+    VkDescriptorSetLayout vk_set_layouts[2]    = {0};
+    uint32_t              vk_set_layouts_count = 0;
+    if (app->instances.count > 0) {
+        variant              = PIPELINE_VARIANT_INSTANCED;
+        vk_set_layouts[0]    = app->instances.vk_set_layout;
+        vk_set_layouts[1]    = app->upload_ring.vk_set_layout;
+        vk_set_layouts_count = 2;
+    } else if (app->particles.count > 0) {
+        variant              = PIPELINE_VARIANT_PARTICLES;
+        vk_set_layouts[0]    = app->particles.vk_set_layout;
+        vk_set_layouts_count = 1;
+    } else if (app->objects.count > 0) {
+        variant              = PIPELINE_VARIANT_OBJECTS;
+        vk_set_layouts[0]    = app->objects.vk_set_layout;
+        vk_set_layouts[1]    = app->upload_ring.vk_set_layout;
+        vk_set_layouts_count = 2;
+    } else if (app->materials.count > 0) {
+        variant              = PIPELINE_VARIANT_BINDLESS;
+        vk_set_layouts[0]    = app->bindless.vk_set_layout;
+        vk_set_layouts_count = 1;
+    }
+    if (!pipeline_compiler_create(
+            &app->pipeline_compiler,
+            &app->device,
+            app->pipeline_cache.vk_pipeline_cache,
+            variant,
+            vk_set_layouts,
+            vk_set_layouts_count
+        )) {
+        log_error("APP Failed to create pipeline compiler.");
+        app_destroy(app);
+        return false;
+    }
+
+    if (!app_request_pipelines(app)) {
         app_destroy(app);
         return false;
     }
 
-    if (!sync_create(&app->sync, &app->device, MAX_FRAMES_IN_FLIGHT)) {
+    if (!commands_create(
+            &app->commands,
+            &app->device,
+            app->frames_in_flight,
+            app->config.draw_count,
+            app->config.record_threads,
+            app_instances(app),
+            app_particles(app),
+            app_compute(app),
+            app_objects(app),
+            app_materials(app),
+            app_upload_ring(app)
+        )) {
         log_error("APP Failed to create commands.");
         app_destroy(app);
         return false;
     }
 
+    if (!app->config.async_pipelines && !app_wait_pipeline(app)) {
+        app_destroy(app);
+        return false;
+    }
+    if (app->config.record_once && app_compute(app) != NULL) {
+        log_warn("(APP) particles on the compute queue are recorded per frame, not once.");
+    } else if (app->config.record_once) {
+        log_debug("(APP) record-once mode, gpu queries are not recorded.");
+    }
+
+    if (!queries_create(&app->queries, &app->device, app->frames_in_flight)) {
+        log_error("APP Failed to create queries.");
+        app_destroy(app);
+        return false;
+    }
+
+    if (!sync_create(
+            &app->sync,
+            &app->device,
+            app->config.sync_mode,
+            app->frames_in_flight,
+            app_presented_image_count(app)
+        )) {
+        log_error("APP Failed to create sync.");
+        app_destroy(app);
+        return false;
+    }
+
     app->current_frame = 0;
 
+    frame_policy_init(
+        &app->frame_policy, app->config.frames_in_flight_min, app->config.frames_in_flight_max
+    );
+    frame_stats_init(&app->frame_stats, app->config.frame_stats);
+
+    frame_pacer_mode_t pacer_mode = FRAME_PACER_OFF;
+    if (app->config.display_locked) {
+        pacer_mode = FRAME_PACER_DISPLAY;
+    } else if (app->config.target_fps > 0) {
+        pacer_mode = FRAME_PACER_TARGET_FPS;
+    }
+    frame_pacer_init(
+        &app->frame_pacer, pacer_mode, app->config.target_fps, app->device.has_present_wait
+    );
+    if (app->config.frame_stats) {
+        signal(SIGUSR1, app_request_stats);
+    }
+    if (!app->config.headless) {
+        signal(SIGUSR2, app_request_present_mode);
+    }
+
+    app->startup_ns = clock_now_ns() - start_ns;
+    log_debug(
+        "(APP) startup in %.3f ms (pipeline %s).",
+        clock_ns_to_ms(app->startup_ns),
+        app->pipeline == NULL ? "compiling" : "ready"
+    );
+
     return true;
 }
 
-void app_run(app_t *app) {
-    while (!platform_window_should_close(app->window)) {
+bool app_set_frames_in_flight(app_t *app, uint32_t frames_in_flight) {
+    if (frames_in_flight == 0 || frames_in_flight > APP_MAX_FRAMES_IN_FLIGHT) {
+        log_error("APP Invalid frames in flight (%u).", frames_in_flight);
+        return false;
+    }
+
+    if (frames_in_flight == app->frames_in_flight) {
+        return true;
+    }
+
+    if (!app_wait_idle(app)) {
+        return false;
+    }
+
+    // Retired objects are tracked per frame slot, which are about to change.
+    retire_flush(&app->retire, &app->device);
+    bindless_flush(&app->bindless);
+
+    sync_stats_t    stats         = app->sync.stats;
+    queries_stats_t queries_stats = app->queries.stats;
+
+    sync_destroy(&app->sync, &app->device);
+    queries_destroy(&app->queries, &app->device);
+    commands_destroy(&app->commands, &app->device);
+
+    if (!commands_create(
+            &app->commands,
+            &app->device,
+            frames_in_flight,
+            app->config.draw_count,
+            app->config.record_threads,
+            app_instances(app),
+            app_particles(app),
+            app_compute(app),
+            app_objects(app),
+            app_materials(app),
+            app_upload_ring(app)
+        )) {
+        log_error("APP Failed to create commands.");
+        return false;
+    }
+
+    if (!app_record_static(app)) {
+        return false;
+    }
+
+    if (!queries_create(&app->queries, &app->device, frames_in_flight)) {
+        log_error("APP Failed to create queries.");
+        return false;
+    }
+
+    if (!sync_create(
+            &app->sync,
+            &app->device,
+            app->config.sync_mode,
+            frames_in_flight,
+            app_presented_image_count(app)
+        )) {
+        log_error("APP Failed to create sync.");
+        return false;
+    }
+
+    app->sync.stats       = stats;
+    app->queries.stats    = queries_stats;
+    app->frames_in_flight = frames_in_flight;
+    app->current_frame    = 0;
+
+    return true;
+}
+
+static bool
+app_end_frame(app_t *app, draw_result_t draw_result, const draw_timing_t *draw_timing) {
+    const bool presented = draw_result == DRAW_SUCCESS || draw_result == DRAW_SUBOPTIMAL;
+
+    uint64_t now_ns = clock_now_ns();
+    if (presented && app->last_frame_ns != 0) {
+        const uint64_t phases_ns[FRAME_PHASE_COUNT] = {
+            [FRAME_PHASE_WAIT]    = draw_timing->wait_ns,
+            [FRAME_PHASE_ACQUIRE] = draw_timing->acquire_ns,
+            [FRAME_PHASE_RECORD]  = draw_timing->record_ns,
+            [FRAME_PHASE_SUBMIT]  = draw_timing->submit_ns,
+            [FRAME_PHASE_PRESENT] = draw_timing->present_ns,
+            [FRAME_PHASE_FRAME]   = now_ns - app->last_frame_ns,
+        };
+        frame_stats_record(&app->frame_stats, phases_ns);
+    }
+
+    if (app_stats_requested) {
+        app_stats_requested = 0;
+        frame_stats_report(&app->frame_stats);
+    }
+
+    if (presented && app->last_frame_ns != 0 && app->config.adaptive_frames_in_flight) {
+        uint32_t frames_in_flight = frame_policy_update(
+            &app->frame_policy, app->frames_in_flight, now_ns - app->last_frame_ns, draw_timing
+        );
+        if (!app_set_frames_in_flight(app, frames_in_flight)) {
+            return false;
+        }
+        now_ns = clock_now_ns();
+    }
+    app->last_frame_ns = now_ns;
+
+    return true;
+}
+
+// --format-switches: once the last switch drew with its pipeline for a few frames, the next
+// recreation asks for the surface format after the current one. With prebuilt pipelines the
+// target is waited for first, so the measurement does not include its startup compile.
+static bool app_format_switch_due(app_t *app, draw_result_t draw_result) {
+    if (app->format_switches >= app->config.format_switches || app->resize_start_ns != 0
+        || app->pipeline == NULL || draw_result != DRAW_SUCCESS) {
+        return false;
+    }
+    if (++app->format_switch_frames < APP_FORMAT_SWITCH_FRAMES) {
+        return false;
+    }
+
+    VkFormat vk_formats[PIPELINE_SET_MAX_FORMATS];
+    uint32_t vk_formats_count = swapchain_surface_formats(
+        &app->device, app->surface, vk_formats, PIPELINE_SET_MAX_FORMATS
+    );
+    if (vk_formats_count < 2 && app->format_switches == 0) {
+        log_warn("(APP) the surface offers a single format, switches keep it.");
+    }
+
+    VkFormat vk_format = app->swapchain.vk_image_format;
+    for (uint32_t i = 0; i < vk_formats_count; ++i) {
+        if (vk_formats[i] == app->swapchain.vk_image_format) {
+            vk_format = vk_formats[(i + 1) % vk_formats_count];
+            break;
+        }
+    }
+
+    if (app->config.format_prebuild && !pipeline_set_wait(&app->pipeline_set, vk_format)) {
+        log_warn("(APP) pipeline for format %d is built on demand.", (int)vk_format);
+    }
+
+    app->swapchain.vk_format_requested = vk_format;
+    app->format_switch_frames          = 0;
+    ++app->format_switches;
+
+    return true;
+}
+
+static bool app_recreate_swapchain(app_t *app) {
+    if (app->resize_start_ns == 0) {
+        app->resize_start_ns = clock_now_ns();
+    }
+
+    commands_invalidate_static(&app->commands);
+
+    // Nothing is destroyed here; the replaced objects are released once every frame slot has
+    // waited on its fences, so rendering continues without draining the device.
+    retire_entry_t retired = {0};
+
+    bool created = swapchain_recreate(
+        &app->swapchain, &app->device, app->surface, app->window, &retired
+    );
+
+    // Pipelines are built against their own format-only render passes, so only the cheap render
+    // pass is replaced here and the pipeline for the new format is looked up.
+    bool ok = true;
+    if (created && renderpass_has_format_mismatch(&app->renderpass, &app->swapchain)) {
+        renderpass_retire(&app->renderpass, &retired);
+        app->pipeline = NULL;
+        ++app->resize_format_changes;
+
+        ok = renderpass_create(
+            &app->renderpass, &app->device, &app->swapchain, app->config.dynamic_rendering
+        );
+
+        // Without prebuilt pipelines the old one is dropped once the device is idle and the
+        // new format compiles, the cost the pipeline set avoids.
+        if (ok && !app->config.format_prebuild) {
+            ok = app_wait_idle(app);
+            pipeline_set_destroy(&app->pipeline_set);
+            ok = ok && app_request_pipelines(app);
+        }
+    } else if (created) {
+        ok = renderpass_recreate_framebuffers(
+            &app->renderpass, &app->device, &app->swapchain, &retired
+        );
+    }
+
+    retire_push(&app->retire, &app->device, &retired, app->sync.frame_count);
+
+    if (!created) {
+        return true;
+    }
+    app->resize_extent = app->swapchain.extent;
+
+    return ok && app_record_static(app);
+}
+
+// Switches per present when the swapchain allows it, otherwise the mode is preferred from the
+// next recreation on.
+bool app_set_present_mode(app_t *app, VkPresentModeKHR present_mode) {
+    if (app->config.headless) {
+        return false;
+    }
+
+    if (swapchain_set_present_mode(&app->swapchain, present_mode)) {
+        log_debug("(APP) present mode %s.", swapchain_present_mode_str(present_mode));
+        return true;
+    }
+
+    app->swapchain.vk_present_mode = present_mode;
+    log_debug(
+        "(APP) present mode %s needs a swapchain recreation.",
+        swapchain_present_mode_str(present_mode)
+    );
+    return app_recreate_swapchain(app);
+}
+
+static void app_cycle_present_mode(app_t *app) {
+    const swapchain_t *swapchain = &app->swapchain;
+
+    if (swapchain->vk_present_modes_count < 2) {
+        log_debug(
+            "(APP) present mode %s has no compatible modes to switch to.",
+            swapchain_present_mode_str(swapchain->vk_present_mode)
+        );
+        return;
+    }
+
+    uint32_t index = 0;
+    while (index < swapchain->vk_present_modes_count
+           && swapchain->vk_present_modes[index] != swapchain->vk_present_mode) {
+        ++index;
+    }
+
+    index = (index + 1) % swapchain->vk_present_modes_count;
+    app_set_present_mode(app, swapchain->vk_present_modes[index]);
+}
+
+// With present scaling the swapchain keeps its extent while the window is dragged and is only
+// recreated once the size held still for the settle interval. Without it, a suboptimal present
+// recreates right away.
+static bool app_resize_settled(app_t *app, draw_result_t draw_result) {
+    if (app->swapchain.present_scaling == 0) {
+        return draw_result == DRAW_SUBOPTIMAL;
+    }
+
+    uint32_t width  = 0;
+    uint32_t height = 0;
+    platform_window_framebuffer_size(app->window, &width, &height);
+
+    const uint64_t now_ns = clock_now_ns();
+    if (width != app->resize_extent.width || height != app->resize_extent.height) {
+        app->resize_extent     = (VkExtent2D){width, height};
+        app->resize_changed_ns = now_ns;
+        ++app->resize_absorbed;
+        return false;
+    }
+
+    if (width == app->swapchain.extent.width && height == app->swapchain.extent.height
+        && draw_result != DRAW_SUBOPTIMAL) {
+        return false;
+    }
+
+    return now_ns - app->resize_changed_ns >= (uint64_t)app->config.resize_settle_ms * 1000000ULL;
+}
+
+// Returns true when the policy picked another image count, which needs a new swapchain.
+static bool app_update_image_count(app_t *app, const draw_timing_t *draw_timing) {
+    uint32_t image_count = image_count_policy_update(
+        &app->image_count_policy, app->swapchain.min_image_count, draw_timing
+    );
+    if (image_count == app->swapchain.min_image_count) {
+        return false;
+    }
+
+    app->swapchain.image_count_requested = image_count;
+    return true;
+}
+
+draw_result_t app_step(app_t *app) {
+    draw_timing_t draw_timing;
+    draw_result_t draw_result;
+
+    const uint32_t frame_index = app->current_frame;
+
+    // Before input is polled and the frame recorded, so both happen as late as pacing allows.
+    const uint64_t present_id
+        = frame_pacer_begin(&app->frame_pacer, &app->device, &app->swapchain);
+
+    if (!app_poll_shaders(app) || !app_poll_pipeline(app) || !transfer_collect(&app->transfer)) {
+        return DRAW_ERROR;
+    }
+
+    if (app->config.headless) {
+        draw_result = draw_offscreen_frame(
+            &app->device,
+            &app->offscreen,
+            &app->renderpass,
+            app->pipeline,
+            &app->commands,
+            &app->queries,
+            &app->sync,
+            &app->current_frame,
+            &draw_timing
+        );
+    } else {
         platform_window_poll(app->window);
 
-        draw_result_t draw_result = draw_frame(
+        draw_result = draw_frame(
             &app->device,
             &app->swapchain,
             &app->renderpass,
-            &app->pipeline,
+            app->pipeline,
             &app->commands,
+            &app->queries,
             &app->sync,
-            &app->current_frame
+            &app->current_frame,
+            present_id,
+            &draw_timing
         );
+    }
 
-        if (draw_result == DRAW_NEED_RECREATE) {
-            if (!swapchain_recreate(&app->swapchain, &app->device, app->surface, app->window)) {
-                continue;
-            }
+    if (draw_result == DRAW_ERROR) {
+        return DRAW_ERROR;
+    }
 
-            if (renderpass_has_format_mismatch(&app->renderpass, &app->swapchain)) {
-                renderpass_destroy(&app->renderpass, &app->device);
-                pipeline_destroy(&app->pipeline, &app->device);
-
-                if (renderpass_create(&app->renderpass, &app->device, &app->swapchain)) {
-                    break;
-                }
-
-                if (!pipeline_create(&app->pipeline, &app->device, &app->renderpass)) {
-                    break;
-                }
-            } else {
-                if (!renderpass_recreate_framebuffers(
-                        &app->renderpass, &app->device, &app->swapchain
-                    )) {
-                    break;
-                }
-            }
-        } else if (draw_result == DRAW_ERROR) {
-            break;
+    frame_pacer_end(
+        &app->frame_pacer, draw_result == DRAW_SUCCESS || draw_result == DRAW_SUBOPTIMAL
+    );
+
+    retire_frame_waited(&app->retire, &app->device, frame_index);
+    bindless_frame_waited(&app->bindless, frame_index);
+
+    if (draw_result == DRAW_SUCCESS && app->resize_start_ns != 0 && app->pipeline != NULL) {
+        uint64_t resize_ns   = clock_now_ns() - app->resize_start_ns;
+        app->resize_start_ns = 0;
+        app->resize_total_ns += resize_ns;
+        app->resize_max_ns = resize_ns > app->resize_max_ns ? resize_ns : app->resize_max_ns;
+        ++app->resize_count;
+    }
+
+    if (!app_end_frame(app, draw_result, &draw_timing)) {
+        return DRAW_ERROR;
+    }
+
+    bool recreate = draw_result == DRAW_NEED_RECREATE;
+    if (!recreate && !app->config.headless) {
+        recreate = app_resize_settled(app, draw_result);
+        if (!recreate && draw_result == DRAW_SUCCESS && app->config.swapchain_images_auto) {
+            recreate = app_update_image_count(app, &draw_timing);
         }
+        if (!recreate) {
+            recreate = app_format_switch_due(app, draw_result);
+        }
+    }
+    if (recreate && !app_recreate_swapchain(app)) {
+        return DRAW_ERROR;
+    }
+
+    if (app_present_mode_requested) {
+        app_present_mode_requested = 0;
+        app_cycle_present_mode(app);
+    }
+
+    return draw_result;
+}
+
+bool app_should_close(const app_t *app) {
+    if (app->config.headless) {
+        return false;
+    }
+
+    if (app->config.format_switches > 0 && app->format_switches == app->config.format_switches
+        && app->resize_start_ns == 0) {
+        return true;
     }
 
+    return platform_window_should_close(app->window);
+}
+
+bool app_wait_idle(const app_t *app) {
     VkResult res;
     res = vkDeviceWaitIdle(app->device.vk_device);
     if (res != VK_SUCCESS) {
         log_error("(APP) vkDeviceWaitIdle failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+static void app_run_offscreen(app_t *app) {
+    const uint64_t start_ns  = clock_now_ns();
+    uint64_t       report_ns = start_ns;
+    uint64_t       frames    = 0;
+    uint64_t       reported  = 0;
+
+    while (app->config.headless_frames == 0 || frames < app->config.headless_frames) {
+        if (app_step(app) != DRAW_SUCCESS) {
+            break;
+        }
+        ++frames;
+
+        if (app->last_frame_ns - report_ns >= 1000000000ULL) {
+            double seconds = (double)(app->last_frame_ns - report_ns) / 1e9;
+            log_debug(
+                "(APP) %.1f fps, gpu %.3f ms.",
+                (double)(frames - reported) / seconds,
+                (double)app->queries.latest.gpu_ns / 1e6
+            );
+            report_ns = app->last_frame_ns;
+            reported  = frames;
+        }
+    }
+
+    app_wait_idle(app);
+
+    frame_stats_report(&app->frame_stats);
+
+    double seconds = (double)(clock_now_ns() - start_ns) / 1e9;
+    if (frames > 0 && seconds > 0.0) {
+        log_debug(
+            "(APP) offscreen %ux%u: %llu frames in %.3f s (%.1f fps).",
+            app->offscreen.extent.width,
+            app->offscreen.extent.height,
+            (unsigned long long)frames,
+            seconds,
+            (double)frames / seconds
+        );
+        if (app->particles.count > 0) {
+            log_debug(
+                "(APP) %u particles: %.4g particles/s.",
+                app->particles.count,
+                (double)app->particles.count * (double)frames / seconds
+            );
+        }
     }
 }
 
+void app_run(app_t *app) {
+    if (app->config.headless) {
+        app_run_offscreen(app);
+        return;
+    }
+
+    while (!app_should_close(app)) {
+        if (app_step(app) == DRAW_ERROR) {
+            break;
+        }
+    }
+
+    app_wait_idle(app);
+
+    frame_stats_report(&app->frame_stats);
+}
+
 void app_destroy(app_t *app) {
     if (app == NULL) {
         return;
     }
 
     if (app->device.vk_device != VK_NULL_HANDLE) {
-        VkResult res;
-        res = vkDeviceWaitIdle(app->device.vk_device);
-        if (res != VK_SUCCESS) {
-            log_error("(APP) vkDeviceWaitIdle failed (%s).", vk_res_str(res));
-        }
+        app_wait_idle(app);
     }
 
+    pipeline_set_destroy(&app->pipeline_set);
+    pipeline_compiler_destroy(&app->pipeline_compiler);
+    app->pipeline = NULL;
+
+    // Nothing builds from the mapped shaders any more.
+    shader_watch_destroy(&app->shader_watch);
+    shader_unmap_all();
+    if (app->shader_reloads > 0) {
+        log_debug("(APP) %llu shader reloads.", (unsigned long long)app->shader_reloads);
+    }
+
+    app_log_resize_stats(app);
+    frame_pacer_log_stats(&app->frame_pacer);
+    retire_log_stats(&app->retire);
+    retire_flush(&app->retire, &app->device);
+    sync_log_stats(&app->sync);
+    queries_log_stats(&app->queries);
     sync_destroy(&app->sync, &app->device);
+    queries_destroy(&app->queries, &app->device);
     commands_destroy(&app->commands, &app->device);
+    instances_destroy(&app->instances, &app->device);
+    compute_log_stats(&app->compute);
+    compute_destroy(&app->compute);
+    particles_destroy(&app->particles, &app->device);
+    objects_destroy(&app->objects, &app->device);
+    materials_destroy(&app->materials, &app->device, app->frames_in_flight);
+    bindless_flush(&app->bindless);
+    bindless_log_stats(&app->bindless);
+    bindless_destroy(&app->bindless);
+    upload_ring_log_stats(&app->upload_ring);
+    upload_ring_destroy(&app->upload_ring, &app->device);
+    transfer_log_stats(&app->transfer);
+    transfer_destroy(&app->transfer);
     swapchain_destroy(&app->swapchain, &app->device);
-    pipeline_destroy(&app->pipeline, &app->device);
+    offscreen_destroy(&app->offscreen, &app->device);
+    if (app->device.vk_device != VK_NULL_HANDLE) {
+        pipeline_cache_save(&app->pipeline_cache, &app->device);
+    }
+    pipeline_cache_destroy(&app->pipeline_cache, &app->device);
     renderpass_destroy(&app->renderpass, &app->device);
+    memory_log_stats(&app->memory);
+    memory_destroy(&app->memory);
     device_destroy(&app->device);
 
     if (app->instance.vk_instance != VK_NULL_HANDLE && app->surface != VK_NULL_HANDLE) {
@@ -160,5 +1171,7 @@ void app_destroy(app_t *app) {
         platform_window_destroy(app->window);
         app->window = NULL;
     }
-    platform_deinit();
+    if (!app->config.headless) {
+        platform_deinit();
+    }
 }
@@ -0,0 +1,367 @@
+#include "app_config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/recorder.h"
+#include "vk/swapchain.h"
+
+static bool app_config_parse_u32(const char *option, const char *value, uint32_t *out) {
+    if (value == NULL) {
+        log_error("(CONFIG) %s requires a value.", option);
+        return false;
+    }
+
+    char *end = NULL;
+    errno     = 0;
+
+    unsigned long parsed = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || parsed > UINT32_MAX) {
+        log_error("(CONFIG) invalid value for %s (%s).", option, value);
+        return false;
+    }
+
+    *out = (uint32_t)parsed;
+    return true;
+}
+
+static bool app_config_parse_extent(const char *option, const char *value, VkExtent2D *out) {
+    if (value == NULL) {
+        log_error("(CONFIG) %s requires a value.", option);
+        return false;
+    }
+
+    char *end = NULL;
+    errno     = 0;
+
+    unsigned long width = strtoul(value, &end, 10);
+    if (errno != 0 || end == value || *end != 'x' || width == 0 || width > UINT32_MAX) {
+        log_error("(CONFIG) invalid value for %s (%s), expected WIDTHxHEIGHT.", option, value);
+        return false;
+    }
+
+    const char   *height_str = end + 1;
+    unsigned long height     = strtoul(height_str, &end, 10);
+    if (errno != 0 || end == height_str || *end != '\0' || height == 0 || height > UINT32_MAX) {
+        log_error("(CONFIG) invalid value for %s (%s), expected WIDTHxHEIGHT.", option, value);
+        return false;
+    }
+
+    out->width  = (uint32_t)width;
+    out->height = (uint32_t)height;
+    return true;
+}
+
+static bool app_config_parse_present_mode(const char *value, VkPresentModeKHR *out) {
+    const VkPresentModeKHR present_modes[] = {
+        VK_PRESENT_MODE_IMMEDIATE_KHR,
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_FIFO_KHR,
+        VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    };
+    for (size_t i = 0; value != NULL && i < sizeof(present_modes) / sizeof(present_modes[0]); ++i) {
+        if (strcmp(value, swapchain_present_mode_str(present_modes[i])) == 0) {
+            *out = present_modes[i];
+            return true;
+        }
+    }
+
+    log_error("(CONFIG) --present-mode expects immediate, mailbox, fifo or fifo-relaxed.");
+    return false;
+}
+
+static bool app_config_validate(const app_config_t *config) {
+    if (config->frames_in_flight < 1 || config->frames_in_flight > APP_MAX_FRAMES_IN_FLIGHT) {
+        log_error(
+            "(CONFIG) frames in flight (%u) must lie within 1..%u.",
+            config->frames_in_flight,
+            APP_MAX_FRAMES_IN_FLIGHT
+        );
+        return false;
+    }
+
+    // The range only bounds the adaptive policy.
+    if (config->adaptive_frames_in_flight) {
+        if (config->frames_in_flight_min < 1
+            || config->frames_in_flight_max > APP_MAX_FRAMES_IN_FLIGHT
+            || config->frames_in_flight_min > config->frames_in_flight_max) {
+            log_error(
+                "(CONFIG) frames in flight range must lie within 1..%u.", APP_MAX_FRAMES_IN_FLIGHT
+            );
+            return false;
+        }
+
+        if (config->frames_in_flight < config->frames_in_flight_min
+            || config->frames_in_flight > config->frames_in_flight_max) {
+            log_error(
+                "(CONFIG) frames in flight (%u) outside of range %u..%u.",
+                config->frames_in_flight,
+                config->frames_in_flight_min,
+                config->frames_in_flight_max
+            );
+            return false;
+        }
+    }
+
+    if (config->draw_count == 0) {
+        log_error("(CONFIG) draw count must be at least 1.");
+        return false;
+    }
+
+    const uint32_t scene_modes = (config->instance_count > 0 ? 1 : 0)
+                               + (config->particle_count > 0 ? 1 : 0)
+                               + (config->object_count > 0 ? 1 : 0)
+                               + (config->bindless ? 1 : 0);
+    if (scene_modes > 1) {
+        log_error("(CONFIG) --instances, --particles, --objects and --bindless are exclusive.");
+        return false;
+    }
+
+    if (config->upload_kib == 0 || config->upload_kib > 65536) {
+        log_error("(CONFIG) upload ring region must lie within 1..65536 KiB.");
+        return false;
+    }
+
+    if (config->format_switches > 0 && config->headless) {
+        log_error("(CONFIG) --format-switches needs a window.");
+        return false;
+    }
+
+    if (config->record_threads > RECORDER_MAX_THREADS) {
+        log_error("(CONFIG) record threads must lie within 0..%u.", RECORDER_MAX_THREADS);
+        return false;
+    }
+
+    return true;
+}
+
+void app_config_default(app_config_t *config) {
+    memset(config, 0, sizeof(*config));
+
+    config->sync_mode                 = SYNC_MODE_TIMELINE;
+    config->frames_in_flight          = 2;
+    config->adaptive_frames_in_flight = false;
+    config->frames_in_flight_min      = 1;
+    config->frames_in_flight_max      = 4;
+    config->headless                  = false;
+    config->headless_extent           = (VkExtent2D){800, 600};
+    config->headless_frames           = 0;
+    config->frame_stats               = false;
+    config->record_once               = false;
+    config->dynamic_rendering         = false;
+    config->present_mode              = VK_PRESENT_MODE_MAILBOX_KHR;
+    config->present_scaling           = false;
+    config->resize_settle_ms          = 100;
+    config->format_switches           = 0;
+    config->format_prebuild           = true;
+    config->swapchain_images          = 0;
+    config->swapchain_images_auto     = false;
+    config->acquire_stall_us          = 500;
+    config->target_fps                = 0;
+    config->display_locked            = false;
+    config->draw_count                = 1;
+    config->record_threads            = 0;
+    config->instance_count            = 0;
+    config->particle_count            = 0;
+    config->object_count              = 0;
+    config->bindless                  = false;
+    config->upload_kib                = 64;
+    config->pipeline_cache_path       = "pipeline_cache.bin";
+    config->async_pipelines           = true;
+    config->shader_reload             = false;
+}
+
+bool app_config_parse_args(app_config_t *config, int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg   = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            config->show_help = true;
+        } else if (strcmp(arg, "--sync") == 0) {
+            if (value != NULL && strcmp(value, "fence") == 0) {
+                config->sync_mode = SYNC_MODE_FENCE;
+            } else if (value != NULL && strcmp(value, "timeline") == 0) {
+                config->sync_mode = SYNC_MODE_TIMELINE;
+            } else {
+                log_error("(CONFIG) --sync expects fence or timeline.");
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--frames-in-flight") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->frames_in_flight)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--adaptive-frames-in-flight") == 0) {
+            config->adaptive_frames_in_flight = true;
+        } else if (strcmp(arg, "--min-frames-in-flight") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->frames_in_flight_min)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--max-frames-in-flight") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->frames_in_flight_max)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--headless") == 0) {
+            config->headless = true;
+        } else if (strcmp(arg, "--extent") == 0) {
+            if (!app_config_parse_extent(arg, value, &config->headless_extent)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--frames") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->headless_frames)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--frame-stats") == 0) {
+            config->frame_stats = true;
+        } else if (strcmp(arg, "--record-once") == 0) {
+            config->record_once = true;
+        } else if (strcmp(arg, "--dynamic-rendering") == 0) {
+            config->dynamic_rendering = true;
+        } else if (strcmp(arg, "--present-mode") == 0) {
+            if (!app_config_parse_present_mode(value, &config->present_mode)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--present-scaling") == 0) {
+            config->present_scaling = true;
+        } else if (strcmp(arg, "--resize-settle-ms") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->resize_settle_ms)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--format-switches") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->format_switches)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--no-format-prebuild") == 0) {
+            config->format_prebuild = false;
+        } else if (strcmp(arg, "--swapchain-images") == 0) {
+            if (value != NULL && strcmp(value, "auto") == 0) {
+                config->swapchain_images_auto = true;
+            } else if (!app_config_parse_u32(arg, value, &config->swapchain_images)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--acquire-stall-us") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->acquire_stall_us)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--target-fps") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->target_fps)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--display-locked") == 0) {
+            config->display_locked = true;
+        } else if (strcmp(arg, "--draws") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->draw_count)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--record-threads") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->record_threads)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--instances") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->instance_count)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--particles") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->particle_count)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--objects") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->object_count)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--bindless") == 0) {
+            config->bindless = true;
+        } else if (strcmp(arg, "--upload-kib") == 0) {
+            if (!app_config_parse_u32(arg, value, &config->upload_kib)) {
+                return false;
+            }
+            ++i;
+        } else if (strcmp(arg, "--pipeline-cache") == 0) {
+            if (value == NULL) {
+                log_error("(CONFIG) %s requires a value.", arg);
+                return false;
+            }
+            config->pipeline_cache_path = value;
+            ++i;
+        } else if (strcmp(arg, "--no-pipeline-cache") == 0) {
+            config->pipeline_cache_path = NULL;
+        } else if (strcmp(arg, "--sync-pipelines") == 0) {
+            config->async_pipelines = false;
+        } else if (strcmp(arg, "--shader-reload") == 0) {
+            config->shader_reload = true;
+        } else {
+            log_error("(CONFIG) unknown option (%s).", arg);
+            return false;
+        }
+    }
+
+    if (!app_config_validate(config)) {
+        return false;
+    }
+
+    // A fixed depth is a range of one, which sizes the frame slots and offscreen targets.
+    if (!config->adaptive_frames_in_flight) {
+        config->frames_in_flight_min = config->frames_in_flight;
+        config->frames_in_flight_max = config->frames_in_flight;
+    }
+
+    return true;
+}
+
+void app_config_print_usage(const char *program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --sync fence|timeline             frame pacing primitive (default: timeline)\n");
+    printf("  --frames-in-flight N              initial pipeline depth (default: 2)\n");
+    printf("  --adaptive-frames-in-flight       adapt the depth to measured blocking\n");
+    printf("  --min-frames-in-flight N          lower bound for the depth (default: 1)\n");
+    printf("  --max-frames-in-flight N          upper bound for the depth (default: 4)\n");
+    printf("  --headless                        render offscreen without a window\n");
+    printf("  --extent WxH                      offscreen target size (default: 800x600)\n");
+    printf("  --frames N                        stop offscreen rendering after N frames\n");
+    printf("  --frame-stats                     per-phase CPU frame timing (SIGUSR1 prints)\n");
+    printf("  --record-once                     prerecord one command buffer per image\n");
+    printf("  --dynamic-rendering               render without render pass and framebuffers\n");
+    printf("  --present-mode MODE               immediate|mailbox|fifo|fifo-relaxed, falls back\n");
+    printf("                                    to fifo (default: mailbox, SIGUSR2 cycles)\n");
+    printf("  --present-scaling                 scale during resize instead of recreating\n");
+    printf("  --resize-settle-ms N              stable size before recreating (default: 100)\n");
+    printf("  --format-switches N               cycle the surface formats N times, then exit\n");
+    printf("  --no-format-prebuild              compile the pipeline on each format change\n");
+    printf("  --swapchain-images N|auto         minImageCount, auto tunes it to acquire stalls\n");
+    printf("  --acquire-stall-us N              acquire time counted as a stall (default: 500)\n");
+    printf("  --target-fps N                    start frames at a fixed rate\n");
+    printf("  --display-locked                  start frames just in time for the next vblank\n");
+    printf("  --draws N                         triangle draws recorded per frame (default: 1)\n");
+    printf("  --record-threads N                record draws on N worker threads (default: 0)\n");
+    printf("  --instances N                     stress triangles per draw from a storage buffer\n");
+    printf("  --particles N                     simulate and draw N particles on the GPU\n");
+    printf("  --objects N                       cull N objects on the GPU, draw them indirectly\n");
+    printf("  --bindless                        per-draw materials from a bindless table\n");
+    printf("  --upload-kib N                    per-frame upload ring region (default: 64)\n");
+    printf("  --pipeline-cache PATH             cache file (default: pipeline_cache.bin)\n");
+    printf("  --no-pipeline-cache               do not load or save the pipeline cache\n");
+    printf("  --sync-pipelines                  block startup until pipelines are built\n");
+    printf("  --shader-reload                   load shaders from disk, rebuild them on change\n");
+    printf("  -h, --help                        show this help\n");
+}
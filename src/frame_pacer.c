@@ -0,0 +1,195 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "frame_pacer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+#include "vk/debug.h"
+
+#define FRAME_PACER_DEFAULT_PERIOD_NS 16666667ULL
+// Sleeping gets within this of the deadline, the rest is spun.
+#define FRAME_PACER_SPIN_NS 1000000ULL
+// Slack left before the vblank for the present to make it.
+#define FRAME_PACER_MARGIN_NS 1000000ULL
+
+static const double frame_pacer_smoothing = 0.1;
+
+static uint64_t frame_pacer_smooth(uint64_t average, uint64_t sample) {
+    if (average == 0) {
+        return sample;
+    }
+    return (uint64_t)((double)average + ((double)sample - (double)average) * frame_pacer_smoothing);
+}
+
+void frame_pacer_init(
+    frame_pacer_t     *pacer,
+    frame_pacer_mode_t mode,
+    uint32_t           target_fps,
+    bool               present_wait
+) {
+    memset(pacer, 0, sizeof(*pacer));
+
+    pacer->mode         = mode;
+    pacer->present_wait = mode == FRAME_PACER_DISPLAY && present_wait;
+    pacer->period_ns    = FRAME_PACER_DEFAULT_PERIOD_NS;
+    if (target_fps > 0) {
+        pacer->period_ns = 1000000000ULL / target_fps;
+    }
+
+    if (mode == FRAME_PACER_DISPLAY && !present_wait) {
+        log_warn(
+            "(FRAME PACER) present wait unavailable, pacing at %.3f ms instead.",
+            clock_ns_to_ms(pacer->period_ns)
+        );
+    }
+}
+
+// Waits until the previous frame is on screen, learns the refresh period from consecutive
+// presents, then sleeps so that the measured work ends just before the next vblank.
+static void frame_pacer_wait_display(
+    frame_pacer_t     *pacer,
+    const device_t    *device,
+    const swapchain_t *swapchain
+) {
+    if (pacer->present_id == 0 || pacer->vk_present_swapchain != swapchain->vk_swapchain) {
+        return;
+    }
+
+    VkResult res;
+    res = device->vk_wait_for_present(
+        device->vk_device, swapchain->vk_swapchain, pacer->present_id, 4 * pacer->period_ns
+    );
+    if (res == VK_TIMEOUT) {
+        ++pacer->present_wait_timeouts;
+        return;
+    } else if (res != VK_SUCCESS) {
+        // Out of date or lost surface; the swapchain is recreated before the next wait.
+        return;
+    }
+
+    const uint64_t done_ns = clock_now_ns();
+    if (pacer->last_present_done_ns != 0) {
+        uint64_t interval_ns = done_ns - pacer->last_present_done_ns;
+        if (interval_ns < 4 * pacer->period_ns) {
+            pacer->period_ns = frame_pacer_smooth(pacer->period_ns, interval_ns);
+        }
+    }
+    pacer->last_present_done_ns = done_ns;
+
+    if (pacer->work_ns + FRAME_PACER_MARGIN_NS < pacer->period_ns) {
+        clock_sleep_until_ns(
+            done_ns + pacer->period_ns - pacer->work_ns - FRAME_PACER_MARGIN_NS,
+            FRAME_PACER_SPIN_NS
+        );
+    }
+}
+
+static void frame_pacer_wait_deadline(frame_pacer_t *pacer) {
+    const uint64_t now_ns = clock_now_ns();
+
+    pacer->deadline_ns += pacer->period_ns;
+    // Too far behind to catch up without a burst of frames.
+    if (pacer->deadline_ns + pacer->period_ns < now_ns) {
+        pacer->deadline_ns = now_ns;
+    }
+
+    clock_sleep_until_ns(pacer->deadline_ns, FRAME_PACER_SPIN_NS);
+}
+
+static void frame_pacer_record_interval(frame_pacer_t *pacer, uint64_t begin_ns) {
+    if (pacer->begin_ns != 0) {
+        double interval_ns = (double)(begin_ns - pacer->begin_ns);
+
+        ++pacer->frames;
+        double delta = interval_ns - pacer->interval_mean_ns;
+        pacer->interval_mean_ns += delta / (double)pacer->frames;
+        pacer->interval_m2 += delta * (interval_ns - pacer->interval_mean_ns);
+
+        double deviation_ns = fabs(interval_ns - (double)pacer->period_ns);
+        if (pacer->mode != FRAME_PACER_OFF
+            && deviation_ns > (double)pacer->interval_max_deviation_ns) {
+            pacer->interval_max_deviation_ns = (uint64_t)deviation_ns;
+        }
+    }
+
+    pacer->begin_ns = begin_ns;
+}
+
+// Called before input is polled and the frame recorded. Returns the present id for the frame,
+// 0 if presents carry none.
+uint64_t frame_pacer_begin(
+    frame_pacer_t     *pacer,
+    const device_t    *device,
+    const swapchain_t *swapchain
+) {
+    uint64_t present_id = 0;
+
+    if (pacer->present_wait) {
+        frame_pacer_wait_display(pacer, device, swapchain);
+
+        present_id                  = ++pacer->present_id;
+        pacer->vk_present_swapchain = swapchain->vk_swapchain;
+    } else if (pacer->mode != FRAME_PACER_OFF) {
+        frame_pacer_wait_deadline(pacer);
+    }
+
+    frame_pacer_record_interval(pacer, clock_now_ns());
+
+    return present_id;
+}
+
+// A frame that was not presented leaves no present id to wait for.
+void frame_pacer_end(frame_pacer_t *pacer, bool presented) {
+    pacer->work_ns = frame_pacer_smooth(pacer->work_ns, clock_now_ns() - pacer->begin_ns);
+
+    if (!presented) {
+        pacer->vk_present_swapchain = VK_NULL_HANDLE;
+    }
+}
+
+void frame_pacer_log_stats(const frame_pacer_t *pacer) {
+    if (pacer->frames < 2) {
+        return;
+    }
+
+    double stddev_ns = sqrt(pacer->interval_m2 / (double)(pacer->frames - 1));
+
+    if (pacer->mode == FRAME_PACER_OFF) {
+        log_debug(
+            "(FRAME PACER) off: %llu frames, interval %.3f ms avg, jitter %.3f ms stddev.",
+            (unsigned long long)pacer->frames,
+            pacer->interval_mean_ns / 1e6,
+            stddev_ns / 1e6
+        );
+        return;
+    }
+
+    log_debug(
+        "(FRAME PACER) %s: %llu frames, interval %.3f ms avg, jitter %.3f ms stddev, %.3f ms max "
+        "deviation from %.3f ms, work %.3f ms, %llu present wait timeouts.",
+        frame_pacer_mode_str(pacer->mode),
+        (unsigned long long)pacer->frames,
+        pacer->interval_mean_ns / 1e6,
+        stddev_ns / 1e6,
+        clock_ns_to_ms(pacer->interval_max_deviation_ns),
+        clock_ns_to_ms(pacer->period_ns),
+        clock_ns_to_ms(pacer->work_ns),
+        (unsigned long long)pacer->present_wait_timeouts
+    );
+}
+
+const char *frame_pacer_mode_str(frame_pacer_mode_t mode) {
+    switch (mode) {
+    case FRAME_PACER_OFF:
+        return "off";
+    case FRAME_PACER_TARGET_FPS:
+        return "target-fps";
+    case FRAME_PACER_DISPLAY:
+        return "display";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,103 @@
+#include "frame_policy.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+
+#define FRAME_POLICY_WINDOW_FRAMES 120
+#define FRAME_POLICY_EXPIRY_WINDOWS 32
+
+static const double frame_policy_blocked_ratio = 0.30;
+static const double frame_policy_idle_ratio    = 0.05;
+static const double frame_policy_min_gain      = 0.05;
+
+static bool frame_policy_has_recent(const frame_policy_t *policy, uint32_t depth) {
+    return policy->depth_window[depth] != 0
+        && policy->windows - policy->depth_window[depth] < FRAME_POLICY_EXPIRY_WINDOWS;
+}
+
+// A recent measurement at the other depth vetoes the move unless it was meaningfully faster.
+static bool frame_policy_should_move(const frame_policy_t *policy, uint32_t from, uint32_t to) {
+    if (!frame_policy_has_recent(policy, to)) {
+        return true;
+    }
+
+    double from_ns = (double)policy->depth_avg_frame_ns[from];
+    double to_ns   = (double)policy->depth_avg_frame_ns[to];
+
+    if (to < from) {
+        return to_ns <= from_ns * (1.0 + frame_policy_min_gain);
+    }
+    return to_ns < from_ns * (1.0 - frame_policy_min_gain);
+}
+
+void frame_policy_init(frame_policy_t *policy, uint32_t min_frames, uint32_t max_frames) {
+    assert(min_frames >= 1 && max_frames <= APP_MAX_FRAMES_IN_FLIGHT && min_frames <= max_frames);
+
+    memset(policy, 0, sizeof(*policy));
+    policy->min_frames = min_frames;
+    policy->max_frames = max_frames;
+}
+
+uint32_t frame_policy_update(
+    frame_policy_t      *policy,
+    uint32_t             frames_in_flight,
+    uint64_t             frame_ns,
+    const draw_timing_t *timing
+) {
+    assert(frames_in_flight <= APP_MAX_FRAMES_IN_FLIGHT);
+
+    ++policy->window_frames;
+    policy->window_frame_ns   += frame_ns;
+    policy->window_wait_ns    += timing->wait_ns;
+    policy->window_acquire_ns += timing->acquire_ns;
+
+    if (policy->window_frames < FRAME_POLICY_WINDOW_FRAMES || policy->window_frame_ns == 0) {
+        return frames_in_flight;
+    }
+
+    ++policy->windows;
+
+    uint64_t avg_frame_ns  = policy->window_frame_ns / policy->window_frames;
+    double   wait_ratio    = (double)policy->window_wait_ns / (double)policy->window_frame_ns;
+    double   acquire_ratio = (double)policy->window_acquire_ns / (double)policy->window_frame_ns;
+
+    policy->depth_avg_frame_ns[frames_in_flight] = avg_frame_ns;
+    policy->depth_window[frames_in_flight]       = policy->windows;
+
+    policy->window_frames     = 0;
+    policy->window_frame_ns   = 0;
+    policy->window_wait_ns    = 0;
+    policy->window_acquire_ns = 0;
+
+    uint32_t next = frames_in_flight;
+    if (acquire_ratio > frame_policy_blocked_ratio || wait_ratio < frame_policy_idle_ratio) {
+        // Presentation bound or never waiting on the GPU: extra frames only add latency.
+        if (frames_in_flight > policy->min_frames
+            && frame_policy_should_move(policy, frames_in_flight, frames_in_flight - 1)) {
+            next = frames_in_flight - 1;
+        }
+    } else if (wait_ratio > frame_policy_blocked_ratio) {
+        // Blocked on the oldest frame: try a deeper pipeline to overlap CPU and GPU work.
+        if (frames_in_flight < policy->max_frames
+            && frame_policy_should_move(policy, frames_in_flight, frames_in_flight + 1)) {
+            next = frames_in_flight + 1;
+        }
+    }
+
+    if (next != frames_in_flight) {
+        log_debug(
+            "(FRAME POLICY) frames in flight %u -> %u (avg frame %.3f ms, fence wait %.1f%%, "
+            "acquire %.1f%%).",
+            frames_in_flight,
+            next,
+            clock_ns_to_ms(avg_frame_ns),
+            wait_ratio * 100.0,
+            acquire_ratio * 100.0
+        );
+    }
+
+    return next;
+}
@@ -0,0 +1,123 @@
+#include "image_count_policy.h"
+
+#include <string.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+
+#define IMAGE_COUNT_POLICY_WINDOW_FRAMES 240
+
+// Share of acquires allowed to exceed the stall threshold.
+static const double image_count_policy_stall_ratio = 0.05;
+// An extra image has to cut the stall share by this much, otherwise acquire blocks on
+// presentation itself (FIFO pacing) and more images only add latency.
+static const double image_count_policy_min_gain = 0.5;
+
+void image_count_policy_init(
+    image_count_policy_t *policy,
+    uint32_t              min_images,
+    uint32_t              max_images,
+    uint64_t              stall_ns
+) {
+    memset(policy, 0, sizeof(*policy));
+
+    if (max_images == 0 || max_images > IMAGE_COUNT_POLICY_MAX_IMAGES) {
+        max_images = IMAGE_COUNT_POLICY_MAX_IMAGES;
+    }
+    if (min_images < 1) {
+        min_images = 1;
+    }
+    // A surface may require more images than the cap; the policy then has a single count.
+    if (min_images > max_images) {
+        min_images = max_images;
+    }
+
+    policy->min_images = min_images;
+    policy->max_images = max_images;
+    policy->stall_ns   = stall_ns;
+}
+
+static void image_count_policy_settle(image_count_policy_t *policy, uint32_t image_count) {
+    policy->settled = true;
+
+    log_debug(
+        "(IMAGE COUNT POLICY) settled on %u images (stall threshold %.3f ms).",
+        image_count,
+        clock_ns_to_ms(policy->stall_ns)
+    );
+}
+
+// Searches down from the starting count while acquire stays unblocked and up while it stalls,
+// so it settles on the smallest count that keeps stalls rare. Returns the count to use next.
+uint32_t image_count_policy_update(
+    image_count_policy_t *policy,
+    uint32_t              image_count,
+    const draw_timing_t  *timing
+) {
+    if (policy->settled || image_count > IMAGE_COUNT_POLICY_MAX_IMAGES) {
+        return image_count;
+    }
+
+    // Frames recorded against another swapchain belong to a different measurement.
+    if (policy->window_images != image_count) {
+        policy->window_images         = image_count;
+        policy->window_frames         = 0;
+        policy->window_stalls         = 0;
+        policy->window_acquire_ns     = 0;
+        policy->window_acquire_max_ns = 0;
+    }
+
+    ++policy->window_frames;
+    policy->window_acquire_ns += timing->acquire_ns;
+    if (timing->acquire_ns > policy->window_acquire_max_ns) {
+        policy->window_acquire_max_ns = timing->acquire_ns;
+    }
+    if (timing->acquire_ns > policy->stall_ns) {
+        ++policy->window_stalls;
+    }
+
+    if (policy->window_frames < IMAGE_COUNT_POLICY_WINDOW_FRAMES) {
+        return image_count;
+    }
+
+    double stall_ratio = (double)policy->window_stalls / (double)policy->window_frames;
+
+    policy->measured[image_count]    = true;
+    policy->stall_ratio[image_count] = stall_ratio;
+    policy->window_images            = 0;
+
+    uint32_t next = image_count;
+    if (stall_ratio <= image_count_policy_stall_ratio) {
+        if (image_count > policy->min_images && !policy->measured[image_count - 1]) {
+            next = image_count - 1;
+        }
+    } else if (image_count > policy->min_images && policy->measured[image_count - 1]
+               && stall_ratio
+                      > policy->stall_ratio[image_count - 1] * image_count_policy_min_gain) {
+        next = image_count - 1;
+    } else if (image_count < policy->max_images) {
+        if (!policy->measured[image_count + 1]
+            || policy->stall_ratio[image_count + 1] <= image_count_policy_stall_ratio) {
+            next = image_count + 1;
+        }
+    }
+
+    log_debug(
+        "(IMAGE COUNT POLICY) %u images: %.1f%% of %u acquires stalled > %.3f ms (avg %.3f ms, "
+        "max %.3f ms) -> %u.",
+        image_count,
+        stall_ratio * 100.0,
+        policy->window_frames,
+        clock_ns_to_ms(policy->stall_ns),
+        clock_ns_to_ms(policy->window_acquire_ns / policy->window_frames),
+        clock_ns_to_ms(policy->window_acquire_max_ns),
+        next
+    );
+
+    // Going back to a measured count ends the search, as does finding no better neighbour.
+    if (next == image_count || policy->measured[next]) {
+        image_count_policy_settle(policy, next);
+    }
+
+    return next;
+}
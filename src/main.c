@@ -3,8 +3,19 @@
 #include "app.h"
 
 int main(int argc, char *argv[]) {
+    app_config_t config;
+    app_config_default(&config);
+    if (!app_config_parse_args(&config, argc, argv)) {
+        app_config_print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (config.show_help) {
+        app_config_print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
     app_t app;
-    if (!app_create(&app)) {
+    if (!app_create(&app, &config)) {
         return EXIT_FAILURE;
     }
     app_run(&app);
@@ -0,0 +1,33 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "util/clock.h"
+
+#include <time.h>
+
+uint64_t clock_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+double clock_ns_to_ms(uint64_t ns) {
+    return (double)ns / 1e6;
+}
+
+// Sleeps until spin_ns before the deadline, then spins, since the scheduler may oversleep by
+// well over a millisecond.
+void clock_sleep_until_ns(uint64_t deadline_ns, uint64_t spin_ns) {
+    if (deadline_ns > spin_ns) {
+        uint64_t        sleep_until_ns = deadline_ns - spin_ns;
+        struct timespec ts;
+        ts.tv_sec  = (time_t)(sleep_until_ns / 1000000000ULL);
+        ts.tv_nsec = (long)(sleep_until_ns % 1000000000ULL);
+
+        while (clock_now_ns() < sleep_until_ns
+               && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+        }
+    }
+
+    while (clock_now_ns() < deadline_ns) {
+    }
+}
@@ -0,0 +1,106 @@
+#include "util/frame_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+
+static int frame_stats_compare_u32(const void *a, const void *b) {
+    uint32_t lhs = *(const uint32_t *)a;
+    uint32_t rhs = *(const uint32_t *)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static uint64_t frame_stats_percentile(const uint32_t *sorted, uint32_t count, uint32_t percent) {
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
+
+void frame_stats_init(frame_stats_t *stats, bool enabled) {
+    stats->enabled = enabled;
+    stats->head    = 0;
+    stats->count   = 0;
+}
+
+void frame_stats_record(frame_stats_t *stats, const uint64_t phases_ns[FRAME_PHASE_COUNT]) {
+    if (!stats->enabled) {
+        return;
+    }
+
+    for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+        uint64_t ns = phases_ns[phase];
+        stats->samples_ns[phase][stats->head] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    }
+
+    stats->head = (stats->head + 1) % FRAME_STATS_CAPACITY;
+    if (stats->count < FRAME_STATS_CAPACITY) {
+        ++stats->count;
+    }
+}
+
+bool frame_stats_summarize(
+    frame_stats_t         *stats,
+    frame_phase_t          phase,
+    frame_stats_summary_t *summary
+) {
+    if (stats->count == 0) {
+        return false;
+    }
+
+    // The ring is not in time order once it wrapped, which does not matter for percentiles.
+    memcpy(stats->scratch_ns, stats->samples_ns[phase], stats->count * sizeof(uint32_t));
+    qsort(stats->scratch_ns, stats->count, sizeof(uint32_t), frame_stats_compare_u32);
+
+    summary->p50_ns = frame_stats_percentile(stats->scratch_ns, stats->count, 50);
+    summary->p95_ns = frame_stats_percentile(stats->scratch_ns, stats->count, 95);
+    summary->p99_ns = frame_stats_percentile(stats->scratch_ns, stats->count, 99);
+    summary->max_ns = stats->scratch_ns[stats->count - 1];
+
+    return true;
+}
+
+void frame_stats_report(frame_stats_t *stats) {
+    if (!stats->enabled || stats->count == 0) {
+        return;
+    }
+
+    log_debug("(FRAME STATS) last %u frames, ms:", stats->count);
+    for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+        frame_stats_summary_t summary;
+        if (!frame_stats_summarize(stats, (frame_phase_t)phase, &summary)) {
+            continue;
+        }
+
+        log_debug(
+            "(FRAME STATS) %-8s p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f",
+            frame_phase_str((frame_phase_t)phase),
+            clock_ns_to_ms(summary.p50_ns),
+            clock_ns_to_ms(summary.p95_ns),
+            clock_ns_to_ms(summary.p99_ns),
+            clock_ns_to_ms(summary.max_ns)
+        );
+    }
+}
+
+const char *frame_phase_str(frame_phase_t phase) {
+    switch (phase) {
+    case FRAME_PHASE_WAIT:
+        return "wait";
+    case FRAME_PHASE_ACQUIRE:
+        return "acquire";
+    case FRAME_PHASE_RECORD:
+        return "record";
+    case FRAME_PHASE_SUBMIT:
+        return "submit";
+    case FRAME_PHASE_PRESENT:
+        return "present";
+    case FRAME_PHASE_FRAME:
+        return "frame";
+    default:
+        return "unknown";
+    }
+}
@@ -1,6 +1,16 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "util/shader.h"
 
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/log.h"
 
 /* clang-format off */
 #ifndef SHADER_BIN_DIR
@@ -15,26 +25,206 @@
 const unsigned char shader_vertex_spv_data[] = {
 #embed EMBED_PATH(shader.vert.spv)
 };
-const uint32_t shader_vertex_spv_size = sizeof(shader_vertex_spv_data);
 
 const unsigned char shader_fragment_spv_data[] = {
 #embed EMBED_PATH(shader.frag.spv)
 };
-const uint32_t shader_fragment_spv_size = sizeof(shader_fragment_spv_data);
+
+const unsigned char shader_instanced_vertex_spv_data[] = {
+#embed EMBED_PATH(instanced.vert.spv)
+};
+
+const unsigned char shader_particles_vertex_spv_data[] = {
+#embed EMBED_PATH(particles.vert.spv)
+};
+
+const unsigned char shader_particles_compute_spv_data[] = {
+#embed EMBED_PATH(particles.comp.spv)
+};
+
+const unsigned char shader_objects_vertex_spv_data[] = {
+#embed EMBED_PATH(objects.vert.spv)
+};
+
+const unsigned char shader_objects_cull_spv_data[] = {
+#embed EMBED_PATH(objects_cull.comp.spv)
+};
+
+const unsigned char shader_bindless_vertex_spv_data[] = {
+#embed EMBED_PATH(bindless.vert.spv)
+};
 /* clang-format on */
 
-void *shader_get_vertex_spv_data(uint32_t *size) {
+#define SHADER_SPIRV_MAGIC 0x07230203U
+
+// A shader's embedded SPIR-V, replaced by a read-only mapping of its file when one is loaded.
+typedef struct {
+    const char          *file_name;
+    const unsigned char *embedded_data;
+    uint32_t             embedded_size;
+    void                *mapped_data;
+    size_t               mapped_size;
+} shader_entry_t;
+
+#define SHADER_ENTRY(file_name, data) {file_name, data, sizeof(data), NULL, 0}
+
+static shader_entry_t shader_entries[SHADER_COUNT] = {
+    [SHADER_VERTEX]   = SHADER_ENTRY("shader.vert.spv", shader_vertex_spv_data),
+    [SHADER_FRAGMENT] = SHADER_ENTRY("shader.frag.spv", shader_fragment_spv_data),
+    [SHADER_INSTANCED_VERTEX]
+    = SHADER_ENTRY("instanced.vert.spv", shader_instanced_vertex_spv_data),
+    [SHADER_PARTICLES_VERTEX]
+    = SHADER_ENTRY("particles.vert.spv", shader_particles_vertex_spv_data),
+    [SHADER_PARTICLES_COMPUTE]
+    = SHADER_ENTRY("particles.comp.spv", shader_particles_compute_spv_data),
+    [SHADER_OBJECTS_VERTEX]
+    = SHADER_ENTRY("objects.vert.spv", shader_objects_vertex_spv_data),
+    [SHADER_OBJECTS_CULL]
+    = SHADER_ENTRY("objects_cull.comp.spv", shader_objects_cull_spv_data),
+    [SHADER_BINDLESS_VERTEX]
+    = SHADER_ENTRY("bindless.vert.spv", shader_bindless_vertex_spv_data),
+};
+
+static void *shader_entry_data(const shader_entry_t *entry, uint32_t *size) {
+    if (entry->mapped_data != NULL) {
+        if (size != NULL) {
+            *size = (uint32_t)entry->mapped_size;
+        }
+        return entry->mapped_data;
+    }
+
     if (size != NULL) {
-        *size = shader_vertex_spv_size;
+        *size = entry->embedded_size;
     }
 
-    return (void *)shader_vertex_spv_data;
+    return (void *)entry->embedded_data;
 }
 
-void *shader_get_fragment_spv_data(uint32_t *size) {
-    if (size != NULL) {
-        *size = shader_fragment_spv_size;
+static void shader_entry_unmap(shader_entry_t *entry) {
+    if (entry->mapped_data != NULL) {
+        munmap(entry->mapped_data, entry->mapped_size);
+    }
+    entry->mapped_data = NULL;
+    entry->mapped_size = 0;
+}
+
+// Maps the entry's file from dir. Keeps the embedded copy if the file is missing or is not a
+// SPIR-V module.
+static bool shader_entry_map(shader_entry_t *entry, const char *dir) {
+    shader_entry_unmap(entry);
+
+    char path[4096];
+    int  len = snprintf(path, sizeof(path), "%s/%s", dir, entry->file_name);
+    if (len < 0 || (size_t)len >= sizeof(path)) {
+        log_warn("(SHADER) path for %s too long, using the embedded copy.", entry->file_name);
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        log_warn("(SHADER) cannot open %s, using the embedded copy.", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 20 || st.st_size % 4 != 0
+        || (uint64_t)st.st_size > UINT32_MAX) {
+        log_warn("(SHADER) %s is not a SPIR-V module, using the embedded copy.", path);
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        log_warn("(SHADER) mmap of %s failed, using the embedded copy.", path);
+        return false;
+    }
+
+    uint32_t magic;
+    memcpy(&magic, data, sizeof(magic));
+    if (magic != SHADER_SPIRV_MAGIC) {
+        log_warn("(SHADER) %s is not a SPIR-V module, using the embedded copy.", path);
+        munmap(data, (size_t)st.st_size);
+        return false;
     }
 
-    return (void *)shader_fragment_spv_data;
+    entry->mapped_data = data;
+    entry->mapped_size = (size_t)st.st_size;
+
+    return true;
+}
+
+const char *shader_bin_dir(void) {
+    return STR(SHADER_BIN_DIR);
+}
+
+uint32_t shader_map_dir(const char *dir) {
+    uint32_t mapped = 0;
+    uint32_t count  = 0;
+    for (uint32_t i = 0; i < SHADER_COUNT; ++i) {
+        if (shader_entry_map(&shader_entries[i], dir)) {
+            mapped |= SHADER_BIT(i);
+            ++count;
+        }
+    }
+
+    log_debug("(SHADER) %u/%u shaders mapped from %s.", count, SHADER_COUNT, dir);
+
+    return mapped;
+}
+
+uint32_t shader_remap(const char *dir, const char *file_name) {
+    for (uint32_t i = 0; i < SHADER_COUNT; ++i) {
+        if (strcmp(shader_entries[i].file_name, file_name) == 0) {
+            if (shader_entry_map(&shader_entries[i], dir)) {
+                log_debug("(SHADER) remapped %s/%s.", dir, file_name);
+            }
+            return SHADER_BIT(i);
+        }
+    }
+
+    return 0;
+}
+
+void shader_unmap_all(void) {
+    for (uint32_t i = 0; i < SHADER_COUNT; ++i) {
+        shader_entry_unmap(&shader_entries[i]);
+    }
+}
+
+void *shader_get_spv_data(shader_id_t id, uint32_t *size) {
+    return shader_entry_data(&shader_entries[id], size);
+}
+
+void *shader_get_vertex_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_VERTEX], size);
+}
+
+void *shader_get_fragment_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_FRAGMENT], size);
+}
+
+void *shader_get_instanced_vertex_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_INSTANCED_VERTEX], size);
+}
+
+void *shader_get_particles_vertex_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_PARTICLES_VERTEX], size);
+}
+
+void *shader_get_particles_compute_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_PARTICLES_COMPUTE], size);
+}
+
+void *shader_get_objects_vertex_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_OBJECTS_VERTEX], size);
+}
+
+void *shader_get_objects_cull_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_OBJECTS_CULL], size);
+}
+
+void *shader_get_bindless_vertex_spv_data(uint32_t *size) {
+    return shader_entry_data(&shader_entries[SHADER_BINDLESS_VERTEX], size);
 }
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "util/shader_watch.h"
+
+#include <errno.h>
+#include <stdalign.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "util/log.h"
+
+#ifdef __linux__
+static bool shader_watch_is_spv(const char *name) {
+    const size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".spv") == 0;
+}
+
+static void shader_watch_add(shader_watch_t *watch, const char *name) {
+    if (!shader_watch_is_spv(name)) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < watch->pending_count; ++i) {
+        if (strcmp(watch->pending[i], name) == 0) {
+            return;
+        }
+    }
+
+    if (watch->pending_count == SHADER_WATCH_MAX_PENDING
+        || strlen(name) >= SHADER_WATCH_NAME_MAX) {
+        watch->reload_all = true;
+        return;
+    }
+
+    strcpy(watch->pending[watch->pending_count], name);
+    ++watch->pending_count;
+}
+#endif
+
+bool shader_watch_create(shader_watch_t *watch, const char *dir) {
+    memset(watch, 0, sizeof(*watch));
+    watch->fd = -1;
+    watch->wd = -1;
+
+#ifdef __linux__
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        log_error("(SHADER_WATCH) inotify_init1 failed (%s).", strerror(errno));
+        return false;
+    }
+
+    // glslc writes in place (close after write), editors and make rules may rename into place.
+    watch->wd = inotify_add_watch(watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch->wd < 0) {
+        log_error("(SHADER_WATCH) inotify_add_watch on %s failed (%s).", dir, strerror(errno));
+        close(watch->fd);
+        watch->fd = -1;
+        return false;
+    }
+    watch->enabled = true;
+
+    log_debug("(SHADER_WATCH) watching %s.", dir);
+#else
+    log_warn("(SHADER_WATCH) no inotify on this platform, %s is read once.", dir);
+#endif
+
+    return true;
+}
+
+void shader_watch_destroy(shader_watch_t *watch) {
+    if (watch == NULL) {
+        return;
+    }
+
+    if (watch->enabled) {
+        close(watch->fd);
+    }
+
+    memset(watch, 0, sizeof(*watch));
+}
+
+void shader_watch_poll(shader_watch_t *watch) {
+#ifdef __linux__
+    if (!watch->enabled) {
+        return;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t len = read(watch->fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (len < 0 && errno != EAGAIN && errno != EINTR) {
+                log_warn("(SHADER_WATCH) read failed (%s).", strerror(errno));
+            }
+            return;
+        }
+
+        for (ssize_t offset = 0; offset < len;) {
+            const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+            offset += (ssize_t)(sizeof(*event) + event->len);
+            ++watch->events;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                watch->reload_all = true;
+            } else if (event->len > 0) {
+                shader_watch_add(watch, event->name);
+            }
+        }
+    }
+#endif
+}
+
+void shader_watch_clear(shader_watch_t *watch) {
+    watch->pending_count = 0;
+    watch->reload_all    = false;
+}
@@ -0,0 +1,401 @@
+#include "vk/bindless.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+#define BINDLESS_BINDINGS 3
+
+static uint32_t bindless_min(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+static bool bindless_slots_init(bindless_slots_t *slots, uint32_t capacity) {
+    slots->capacity        = capacity;
+    slots->high_water      = 0;
+    slots->free_count      = 0;
+    slots->retired_count   = 0;
+    slots->free_slots      = (uint32_t *)malloc(capacity * sizeof(*slots->free_slots));
+    slots->retired_slots   = (uint32_t *)malloc(capacity * sizeof(*slots->retired_slots));
+    slots->retired_pending = (uint32_t *)malloc(capacity * sizeof(*slots->retired_pending));
+    if (slots->free_slots == NULL || slots->retired_slots == NULL
+        || slots->retired_pending == NULL) {
+        log_error("(BINDLESS) malloc failed.");
+        return false;
+    }
+
+    return true;
+}
+
+static void bindless_slots_destroy(bindless_slots_t *slots) {
+    free(slots->free_slots);
+    free(slots->retired_slots);
+    free(slots->retired_pending);
+}
+
+// Released slots are reused first, newest first; otherwise the array grows.
+static uint32_t bindless_slots_acquire(bindless_slots_t *slots) {
+    if (slots->free_count > 0) {
+        return slots->free_slots[--slots->free_count];
+    }
+    if (slots->high_water < slots->capacity) {
+        return slots->high_water++;
+    }
+
+    return BINDLESS_INVALID_HANDLE;
+}
+
+static void bindless_slots_free(bindless_slots_t *slots, uint32_t handle) {
+    assert(slots->free_count < slots->capacity);
+
+    slots->free_slots[slots->free_count++] = handle;
+}
+
+// A slot that pending frames may still read is held back until each of their slots waited.
+static void bindless_slots_release(bindless_slots_t *slots, uint32_t handle, uint32_t frame_count) {
+    assert(handle < slots->high_water);
+    assert(frame_count < 32);
+
+    if (frame_count == 0) {
+        bindless_slots_free(slots, handle);
+        return;
+    }
+
+    assert(slots->retired_count < slots->capacity);
+    slots->retired_slots[slots->retired_count]   = handle;
+    slots->retired_pending[slots->retired_count] = (1U << frame_count) - 1U;
+    ++slots->retired_count;
+}
+
+static void bindless_slots_frame_waited(bindless_slots_t *slots, uint32_t frame_index) {
+    for (uint32_t i = 0; i < slots->retired_count;) {
+        slots->retired_pending[i] &= ~(1U << frame_index);
+        if (slots->retired_pending[i] != 0) {
+            ++i;
+            continue;
+        }
+
+        bindless_slots_free(slots, slots->retired_slots[i]);
+        --slots->retired_count;
+        slots->retired_slots[i]   = slots->retired_slots[slots->retired_count];
+        slots->retired_pending[i] = slots->retired_pending[slots->retired_count];
+    }
+}
+
+static void bindless_slots_flush(bindless_slots_t *slots) {
+    while (slots->retired_count > 0) {
+        bindless_slots_free(slots, slots->retired_slots[--slots->retired_count]);
+    }
+}
+
+// Clamps the array sizes to the update-after-bind limits of the device.
+static void bindless_capacities(const device_t *device, uint32_t *buffers, uint32_t *images) {
+    VkPhysicalDeviceVulkan12Properties vulkan12_properties = {0};
+    vulkan12_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {0};
+    properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext                       = &vulkan12_properties;
+
+    vkGetPhysicalDeviceProperties2(device->vk_physical_device, &properties);
+
+    *buffers = bindless_min(
+        BINDLESS_MAX_BUFFERS,
+        bindless_min(
+            vulkan12_properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+            vulkan12_properties.maxDescriptorSetUpdateAfterBindStorageBuffers
+        )
+    );
+    *images = bindless_min(
+        BINDLESS_MAX_IMAGES,
+        bindless_min(
+            vulkan12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            vulkan12_properties.maxDescriptorSetUpdateAfterBindSampledImages
+        )
+    );
+
+    // Both arrays and the sampler count towards the per-stage resource limit.
+    const uint32_t resources = vulkan12_properties.maxPerStageUpdateAfterBindResources;
+    if (resources > 1 && *buffers + *images > resources - 1) {
+        *buffers = bindless_min(*buffers, (resources - 1) / 2);
+        *images  = bindless_min(*images, resources - 1 - *buffers);
+    }
+}
+
+static bool bindless_create_sampler(bindless_t *bindless) {
+    VkSamplerCreateInfo sampler_create_info = {0};
+    sampler_create_info.sType               = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_create_info.magFilter           = VK_FILTER_LINEAR;
+    sampler_create_info.minFilter           = VK_FILTER_LINEAR;
+    sampler_create_info.mipmapMode          = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_create_info.addressModeU        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeV        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.addressModeW        = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_create_info.maxLod              = VK_LOD_CLAMP_NONE;
+
+    VkResult res;
+    res = vkCreateSampler(
+        bindless->device->vk_device, &sampler_create_info, NULL, &bindless->vk_sampler
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(BINDLESS) vkCreateSampler failed (%s).", vk_res_str(res));
+        bindless->vk_sampler = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+static bool bindless_create_set_layout(bindless_t *bindless) {
+    VkDescriptorSetLayoutBinding set_layout_bindings[BINDLESS_BINDINGS];
+    set_layout_bindings[0]                    = (VkDescriptorSetLayoutBinding){0};
+    set_layout_bindings[0].binding            = 0;
+    set_layout_bindings[0].descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    set_layout_bindings[0].descriptorCount    = bindless->buffers.capacity;
+    set_layout_bindings[0].stageFlags         = BINDLESS_STAGES;
+    set_layout_bindings[1]                    = (VkDescriptorSetLayoutBinding){0};
+    set_layout_bindings[1].binding            = 1;
+    set_layout_bindings[1].descriptorType     = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    set_layout_bindings[1].descriptorCount    = bindless->images.capacity;
+    set_layout_bindings[1].stageFlags         = BINDLESS_STAGES;
+    set_layout_bindings[2]                    = (VkDescriptorSetLayoutBinding){0};
+    set_layout_bindings[2].binding            = 2;
+    set_layout_bindings[2].descriptorType     = VK_DESCRIPTOR_TYPE_SAMPLER;
+    set_layout_bindings[2].descriptorCount    = 1;
+    set_layout_bindings[2].stageFlags         = BINDLESS_STAGES;
+    set_layout_bindings[2].pImmutableSamplers = &bindless->vk_sampler;
+
+    const VkDescriptorBindingFlags array_flags
+        = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    const VkDescriptorBindingFlags binding_flags[BINDLESS_BINDINGS] = {array_flags, array_flags, 0};
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {0};
+    binding_flags_create_info.sType
+        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    binding_flags_create_info.bindingCount  = BINDLESS_BINDINGS;
+    binding_flags_create_info.pBindingFlags = binding_flags;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info = {0};
+    set_layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_create_info.pNext        = &binding_flags_create_info;
+    set_layout_create_info.bindingCount = BINDLESS_BINDINGS;
+    set_layout_create_info.pBindings    = set_layout_bindings;
+    set_layout_create_info.flags
+        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+
+    VkResult res;
+    res = vkCreateDescriptorSetLayout(
+        bindless->device->vk_device, &set_layout_create_info, NULL, &bindless->vk_set_layout
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(BINDLESS) vkCreateDescriptorSetLayout failed (%s).", vk_res_str(res));
+        bindless->vk_set_layout = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+static bool bindless_create_set(bindless_t *bindless) {
+    VkDescriptorPoolSize pool_sizes[BINDLESS_BINDINGS];
+    pool_sizes[0].type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_sizes[0].descriptorCount = bindless->buffers.capacity;
+    pool_sizes[1].type            = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    pool_sizes[1].descriptorCount = bindless->images.capacity;
+    pool_sizes[2].type            = VK_DESCRIPTOR_TYPE_SAMPLER;
+    pool_sizes[2].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {0};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    descriptor_pool_create_info.maxSets       = 1;
+    descriptor_pool_create_info.poolSizeCount = BINDLESS_BINDINGS;
+    descriptor_pool_create_info.pPoolSizes    = pool_sizes;
+
+    VkResult res;
+    res = vkCreateDescriptorPool(
+        bindless->device->vk_device,
+        &descriptor_pool_create_info,
+        NULL,
+        &bindless->vk_descriptor_pool
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(BINDLESS) vkCreateDescriptorPool failed (%s).", vk_res_str(res));
+        bindless->vk_descriptor_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {0};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool     = bindless->vk_descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts        = &bindless->vk_set_layout;
+
+    res = vkAllocateDescriptorSets(
+        bindless->device->vk_device, &descriptor_set_allocate_info, &bindless->vk_descriptor_set
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(BINDLESS) vkAllocateDescriptorSets failed (%s).", vk_res_str(res));
+        bindless->vk_descriptor_set = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+bool bindless_create(bindless_t *bindless, const device_t *device) {
+    memset(bindless, 0, sizeof(*bindless));
+
+    bindless->device = device;
+
+    if (!device->has_descriptor_indexing) {
+        log_error("(BINDLESS) dynamically indexed update-after-bind arrays are not supported.");
+        return false;
+    }
+
+    uint32_t buffers = 0;
+    uint32_t images  = 0;
+    bindless_capacities(device, &buffers, &images);
+
+    if (!bindless_slots_init(&bindless->buffers, buffers)
+        || !bindless_slots_init(&bindless->images, images) || !bindless_create_sampler(bindless)
+        || !bindless_create_set_layout(bindless) || !bindless_create_set(bindless)) {
+        bindless_destroy(bindless);
+        return false;
+    }
+
+    log_debug("(BINDLESS) %u buffer and %u image slots.", buffers, images);
+
+    return true;
+}
+
+void bindless_destroy(bindless_t *bindless) {
+    if (bindless == NULL || bindless->device == NULL) {
+        return;
+    }
+
+    const device_t *device = bindless->device;
+
+    if (bindless->vk_descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device->vk_device, bindless->vk_descriptor_pool, NULL);
+    }
+    if (bindless->vk_set_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device->vk_device, bindless->vk_set_layout, NULL);
+    }
+    if (bindless->vk_sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(device->vk_device, bindless->vk_sampler, NULL);
+    }
+    bindless_slots_destroy(&bindless->buffers);
+    bindless_slots_destroy(&bindless->images);
+
+    memset(bindless, 0, sizeof(*bindless));
+}
+
+uint32_t bindless_register_buffer(
+    bindless_t  *bindless,
+    VkBuffer     vk_buffer,
+    VkDeviceSize offset,
+    VkDeviceSize range
+) {
+    const uint32_t handle = bindless_slots_acquire(&bindless->buffers);
+    if (handle == BINDLESS_INVALID_HANDLE) {
+        log_error("(BINDLESS) all %u buffer slots are in use.", bindless->buffers.capacity);
+        return BINDLESS_INVALID_HANDLE;
+    }
+
+    VkDescriptorBufferInfo descriptor_buffer_info = {0};
+    descriptor_buffer_info.buffer                 = vk_buffer;
+    descriptor_buffer_info.offset                 = offset;
+    descriptor_buffer_info.range                  = range;
+
+    VkWriteDescriptorSet write_descriptor_set = {0};
+    write_descriptor_set.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_set.dstSet               = bindless->vk_descriptor_set;
+    write_descriptor_set.dstBinding           = 0;
+    write_descriptor_set.dstArrayElement      = handle;
+    write_descriptor_set.descriptorCount      = 1;
+    write_descriptor_set.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write_descriptor_set.pBufferInfo          = &descriptor_buffer_info;
+
+    vkUpdateDescriptorSets(bindless->device->vk_device, 1, &write_descriptor_set, 0, NULL);
+    ++bindless->writes;
+
+    return handle;
+}
+
+uint32_t
+bindless_register_image(bindless_t *bindless, VkImageView vk_image_view, VkImageLayout layout) {
+    const uint32_t handle = bindless_slots_acquire(&bindless->images);
+    if (handle == BINDLESS_INVALID_HANDLE) {
+        log_error("(BINDLESS) all %u image slots are in use.", bindless->images.capacity);
+        return BINDLESS_INVALID_HANDLE;
+    }
+
+    VkDescriptorImageInfo descriptor_image_info = {0};
+    descriptor_image_info.imageView             = vk_image_view;
+    descriptor_image_info.imageLayout           = layout;
+
+    VkWriteDescriptorSet write_descriptor_set = {0};
+    write_descriptor_set.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_set.dstSet               = bindless->vk_descriptor_set;
+    write_descriptor_set.dstBinding           = 1;
+    write_descriptor_set.dstArrayElement      = handle;
+    write_descriptor_set.descriptorCount      = 1;
+    write_descriptor_set.descriptorType       = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    write_descriptor_set.pImageInfo           = &descriptor_image_info;
+
+    vkUpdateDescriptorSets(bindless->device->vk_device, 1, &write_descriptor_set, 0, NULL);
+    ++bindless->writes;
+
+    return handle;
+}
+
+// Partially bound arrays allow the stale descriptor to stay until the slot is reused, which
+// happens only after every frame slot waited once since the release.
+void bindless_release_buffer(bindless_t *bindless, uint32_t handle, uint32_t frame_count) {
+    if (handle == BINDLESS_INVALID_HANDLE) {
+        return;
+    }
+
+    bindless_slots_release(&bindless->buffers, handle, frame_count);
+}
+
+void bindless_release_image(bindless_t *bindless, uint32_t handle, uint32_t frame_count) {
+    if (handle == BINDLESS_INVALID_HANDLE) {
+        return;
+    }
+
+    bindless_slots_release(&bindless->images, handle, frame_count);
+}
+
+// Called after the frame slot's fences were waited on.
+void bindless_frame_waited(bindless_t *bindless, uint32_t frame_index) {
+    bindless_slots_frame_waited(&bindless->buffers, frame_index);
+    bindless_slots_frame_waited(&bindless->images, frame_index);
+}
+
+// The caller guarantees no frame is pending.
+void bindless_flush(bindless_t *bindless) {
+    bindless_slots_flush(&bindless->buffers);
+    bindless_slots_flush(&bindless->images);
+}
+
+void bindless_log_stats(const bindless_t *bindless) {
+    if (bindless->writes == 0) {
+        return;
+    }
+
+    log_debug(
+        "(BINDLESS) %u/%u buffers, %u/%u images live, %llu descriptor writes.",
+        bindless->buffers.high_water - bindless->buffers.free_count
+            - bindless->buffers.retired_count,
+        bindless->buffers.capacity,
+        bindless->images.high_water - bindless->images.free_count - bindless->images.retired_count,
+        bindless->images.capacity,
+        (unsigned long long)bindless->writes
+    );
+}
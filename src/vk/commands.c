@@ -1,15 +1,40 @@
 #include "vk/commands.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "util/clock.h"
 #include "util/log.h"
 #include "vk/debug.h"
 
-bool commands_create(commands_t *commands, const device_t *device, uint32_t frame_count) {
+bool commands_create(
+    commands_t        *commands,
+    const device_t    *device,
+    uint32_t           frame_count,
+    uint32_t           draw_count,
+    uint32_t           record_threads,
+    const instances_t *instances,
+    const particles_t *particles,
+    compute_t         *compute,
+    const objects_t   *objects,
+    const materials_t *materials,
+    upload_ring_t     *upload_ring
+) {
     memset(commands, 0, sizeof(*commands));
 
+    assert(upload_ring == NULL || upload_ring->region_count > frame_count);
+    assert(compute == NULL || (particles != NULL && compute->frame_count >= frame_count));
+
+    commands->draw_count  = draw_count;
+    commands->instances   = instances;
+    commands->particles   = particles;
+    commands->compute     = compute;
+    commands->objects     = objects;
+    commands->materials   = materials;
+    commands->upload_ring = upload_ring;
+
     VkCommandPoolCreateInfo command_pool_create_info = {0};
 
     command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -53,6 +78,22 @@ bool commands_create(commands_t *commands, const device_t *device, uint32_t fram
         return false;
     }
 
+    if (record_threads > 0) {
+        commands->recorder = (recorder_t *)malloc(sizeof(*commands->recorder));
+        if (commands->recorder == NULL) {
+            log_error("(COMMANDS) malloc failed.");
+            commands_destroy(commands, device);
+            return false;
+        }
+
+        if (!recorder_create(commands->recorder, device, record_threads, frame_count)) {
+            free(commands->recorder);
+            commands->recorder = NULL;
+            commands_destroy(commands, device);
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -61,6 +102,15 @@ void commands_destroy(commands_t *commands, const device_t *device) {
         return;
     }
 
+    if (commands->recorder != NULL) {
+        recorder_destroy(commands->recorder);
+        free(commands->recorder);
+    }
+
+    if (commands->vk_static_buffers != NULL) {
+        free(commands->vk_static_buffers);
+    }
+
     if (commands->vk_pool != VK_NULL_HANDLE) {
         vkDestroyCommandPool(device->vk_device, commands->vk_pool, NULL);
     }
@@ -72,52 +122,74 @@ void commands_destroy(commands_t *commands, const device_t *device) {
     memset(commands, 0, sizeof(*commands));
 }
 
-bool commands_record_frame(
-    const commands_t   *commands,
-    const device_t     *device,
-    const renderpass_t *renderpass,
-    const pipeline_t   *pipeline,
-    const swapchain_t  *swapchain,
-    uint32_t            image_index,
-    uint32_t            frame_index
-) {
-    assert(frame_index < commands->vk_buffers_count);
+typedef struct {
+    const pipeline_t    *pipeline;
+    const instances_t   *instances;
+    const particles_t   *particles;
+    uint32_t             particles_set;
+    const objects_t     *objects;
+    const materials_t   *materials;
+    const upload_ring_t *upload_ring;
+    uint32_t             frame_offset;
+    VkExtent2D           extent;
+} commands_draws_t;
 
-    VkCommandBuffer command_buffer = commands->vk_buffers[frame_index];
+// Uniform block Frame of the instanced and objects shaders (std140).
+typedef struct {
+    float rotation[4];
+    float view[4];      // center x, center y, scale x, scale y
+    float planes[4][4]; // left, right, bottom, top: normal xy, unused, distance
+} commands_frame_data_t;
 
-    VkCommandBufferBeginInfo command_buffer_create_info = {0};
-    command_buffer_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+// The instanced field turns and the view over the objects pans, so the frame data changes
+// every frame.
+static bool commands_write_frame_data(
+    const commands_t *commands,
+    uint32_t          region,
+    uint32_t         *frame_offset
+) {
+    *frame_offset = 0;
+    if (commands->instances == NULL && commands->objects == NULL) {
+        return true;
+    }
 
-    VkResult res;
-    res = vkBeginCommandBuffer(command_buffer, &command_buffer_create_info);
-    if (res != VK_SUCCESS) {
-        log_error("(COMMANDS) vkBeginCommandBuffer failed (%s).", vk_res_str(res));
+    upload_slice_t slice;
+    if (!upload_ring_alloc(commands->upload_ring, region, sizeof(commands_frame_data_t), &slice)) {
+        log_error("(COMMANDS) upload ring region %u is full.", region);
         return false;
     }
 
-    VkClearValue clear_value = {0};
-    clear_value.color        = (VkClearColorValue){
-        {0.0F, 0.0F, 0.0F, 1.0F}
-    };
+    const double seconds = (double)(clock_now_ns() % 3600000000000ULL) / 1e9;
+    const double angle   = seconds * 0.25;
 
-    VkRenderPassBeginInfo render_pass_begin_info = {0};
-    render_pass_begin_info.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_begin_info.renderPass            = renderpass->vk_render_pass;
-    render_pass_begin_info.framebuffer           = renderpass->vk_framebuffers[image_index];
-    render_pass_begin_info.renderArea.offset     = (VkOffset2D){0, 0};
-    render_pass_begin_info.renderArea.extent     = swapchain->extent;
-    render_pass_begin_info.clearValueCount       = 1;
-    render_pass_begin_info.pClearValues          = &clear_value;
+    commands_frame_data_t *data = (commands_frame_data_t *)slice.data;
+    data->rotation[0]           = (float)cos(angle);
+    data->rotation[1]           = (float)sin(angle);
+    data->rotation[2]           = (float)seconds;
+    data->rotation[3]           = 0.0F;
+    objects_write_frame_view(data->view, data->planes, seconds);
 
-    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    *frame_offset = slice.offset;
+    return true;
+}
 
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->vk_pipeline);
+static void commands_record_draws(
+    VkCommandBuffer command_buffer,
+    const void     *user,
+    uint32_t        first,
+    uint32_t        count
+) {
+    const commands_draws_t *draws = (const commands_draws_t *)user;
+
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draws->pipeline->vk_pipeline
+    );
 
     VkViewport viewport = {0};
     viewport.x          = 0.0F;
     viewport.y          = 0.0F;
-    viewport.width      = (float)swapchain->extent.width;
-    viewport.height     = (float)swapchain->extent.height;
+    viewport.width      = (float)draws->extent.width;
+    viewport.height     = (float)draws->extent.height;
     viewport.minDepth   = 0.0F;
     viewport.maxDepth   = 1.0F;
 
@@ -125,13 +197,292 @@ bool commands_record_frame(
 
     VkRect2D scissor = {0};
     scissor.offset   = (VkOffset2D){0, 0};
-    scissor.extent   = swapchain->extent;
+    scissor.extent   = draws->extent;
 
     vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-    vkCmdDraw(command_buffer, 3, 1, 0, 0);
+    uint32_t vertex_count   = 3;
+    uint32_t instance_count = 1;
+    if (draws->particles != NULL) {
+        vkCmdBindDescriptorSets(
+            command_buffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            draws->pipeline->vk_pipeline_layout,
+            0,
+            1,
+            &draws->particles->vk_descriptor_sets[draws->particles_set],
+            0,
+            NULL
+        );
+        vertex_count = draws->particles->count;
+    } else if (draws->materials != NULL) {
+        // The table is bound once; draws below change only their push constants.
+        vkCmdBindDescriptorSets(
+            command_buffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            draws->pipeline->vk_pipeline_layout,
+            0,
+            1,
+            &draws->materials->bindless->vk_descriptor_set,
+            0,
+            NULL
+        );
+    } else if (draws->instances != NULL || draws->objects != NULL) {
+        const VkDescriptorSet vk_descriptor_sets[2] = {
+            draws->instances != NULL ? draws->instances->vk_descriptor_set
+                                     : draws->objects->vk_descriptor_set,
+            draws->upload_ring->vk_descriptor_set,
+        };
+        const uint32_t dynamic_offsets[2] = {draws->frame_offset, draws->frame_offset};
+
+        vkCmdBindDescriptorSets(
+            command_buffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            draws->pipeline->vk_pipeline_layout,
+            0,
+            2,
+            vk_descriptor_sets,
+            2,
+            dynamic_offsets
+        );
+        if (draws->instances != NULL) {
+            instance_count = draws->instances->count;
+        }
+    }
+
+    for (uint32_t i = first; i < first + count; ++i) {
+        if (draws->objects != NULL) {
+            objects_cmd_draw(draws->objects, command_buffer);
+        } else if (draws->materials != NULL) {
+            bindless_push_t push;
+            materials_push(draws->materials, i, &push);
+            vkCmdPushConstants(
+                command_buffer,
+                draws->pipeline->vk_pipeline_layout,
+                BINDLESS_STAGES,
+                0,
+                sizeof(push),
+                &push
+            );
+            vkCmdDraw(command_buffer, vertex_count, instance_count, 0, 0);
+        } else {
+            vkCmdDraw(command_buffer, vertex_count, instance_count, 0, 0);
+        }
+    }
+}
+
+static void commands_image_barrier(
+    VkCommandBuffer      command_buffer,
+    VkImage              vk_image,
+    VkImageLayout        old_layout,
+    VkImageLayout        new_layout,
+    VkPipelineStageFlags src_stage,
+    VkAccessFlags        src_access,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+) {
+    VkImageMemoryBarrier image_memory_barrier = {0};
+    image_memory_barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_memory_barrier.srcAccessMask        = src_access;
+    image_memory_barrier.dstAccessMask        = dst_access;
+    image_memory_barrier.oldLayout            = old_layout;
+    image_memory_barrier.newLayout            = new_layout;
+    image_memory_barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+    image_memory_barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+    image_memory_barrier.image                = vk_image;
+    image_memory_barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_memory_barrier.subresourceRange.baseMipLevel   = 0;
+    image_memory_barrier.subresourceRange.levelCount     = 1;
+    image_memory_barrier.subresourceRange.baseArrayLayer = 0;
+    image_memory_barrier.subresourceRange.layerCount     = 1;
+
+    vkCmdPipelineBarrier(
+        command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &image_memory_barrier
+    );
+}
+
+static void commands_begin_rendering(
+    VkCommandBuffer     command_buffer,
+    const renderpass_t *renderpass,
+    VkExtent2D          extent,
+    uint32_t            image_index,
+    bool                secondary
+) {
+    VkClearValue clear_value = {0};
+    clear_value.color        = (VkClearColorValue){
+        {0.0F, 0.0F, 0.0F, 1.0F}
+    };
+
+    if (!renderpass->dynamic_rendering) {
+        VkRenderPassBeginInfo render_pass_begin_info = {0};
+        render_pass_begin_info.sType                 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_begin_info.renderPass            = renderpass->vk_render_pass;
+        render_pass_begin_info.framebuffer           = renderpass->vk_framebuffers[image_index];
+        render_pass_begin_info.renderArea.offset     = (VkOffset2D){0, 0};
+        render_pass_begin_info.renderArea.extent     = extent;
+        render_pass_begin_info.clearValueCount       = 1;
+        render_pass_begin_info.pClearValues          = &clear_value;
+
+        vkCmdBeginRenderPass(
+            command_buffer,
+            &render_pass_begin_info,
+            secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE
+        );
+        return;
+    }
+
+    // Same ordering as the render pass dependency: presented images are ordered by the acquire
+    // semaphore wait, offscreen images by the previous frame's attachment writes.
+    VkAccessFlags src_access = 0;
+    if (renderpass->vk_final_layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+        src_access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
+
+    commands_image_barrier(
+        command_buffer,
+        renderpass->vk_images[image_index],
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        src_access,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+    );
+
+    VkRenderingAttachmentInfo rendering_attachment_info = {0};
+    rendering_attachment_info.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    rendering_attachment_info.imageView   = renderpass->vk_image_views[image_index];
+    rendering_attachment_info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    rendering_attachment_info.loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    rendering_attachment_info.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
+    rendering_attachment_info.clearValue  = clear_value;
+
+    VkRenderingInfo rendering_info      = {0};
+    rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.renderArea.offset    = (VkOffset2D){0, 0};
+    rendering_info.renderArea.extent    = extent;
+    rendering_info.layerCount           = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments    = &rendering_attachment_info;
+    if (secondary) {
+        rendering_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    }
+
+    vkCmdBeginRendering(command_buffer, &rendering_info);
+}
+
+static void commands_end_rendering(
+    VkCommandBuffer     command_buffer,
+    const renderpass_t *renderpass,
+    uint32_t            image_index
+) {
+    if (!renderpass->dynamic_rendering) {
+        vkCmdEndRenderPass(command_buffer);
+        return;
+    }
+
+    vkCmdEndRendering(command_buffer);
+
+    if (renderpass->vk_final_layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
+        return;
+    }
+
+    commands_image_barrier(
+        command_buffer,
+        renderpass->vk_images[image_index],
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        renderpass->vk_final_layout,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0
+    );
+}
+
+static bool commands_record_buffer(
+    const commands_t         *commands,
+    VkCommandBuffer           command_buffer,
+    VkCommandBufferUsageFlags usage,
+    const renderpass_t       *renderpass,
+    const pipeline_t         *pipeline,
+    queries_t                *queries,
+    VkExtent2D                extent,
+    uint32_t                  image_index,
+    uint32_t                  frame_index,
+    uint32_t                  frame_offset,
+    bool                      threaded
+) {
+    commands_draws_t draws = {0};
+    draws.pipeline         = pipeline;
+    draws.instances        = commands->instances;
+    draws.particles        = commands->particles;
+    draws.particles_set    = commands->compute != NULL ? commands->compute->target : 0;
+    draws.objects          = commands->objects;
+    draws.materials        = commands->materials;
+    draws.upload_ring      = commands->upload_ring;
+    draws.frame_offset     = frame_offset;
+    draws.extent           = extent;
+
+    // Without a pipeline the pass only clears, a placeholder while the pipeline compiles.
+    threaded = threaded && pipeline != NULL;
+
+    // The workers record the secondary buffers before the primary is begun.
+    VkCommandBuffer vk_secondary_buffers[RECORDER_MAX_THREADS];
+    if (threaded) {
+        recorder_job_t job  = {0};
+        job.vk_render_pass  = renderpass->vk_render_pass;
+        job.vk_color_format = renderpass->vk_color_format;
+        job.frame_index     = frame_index;
+        job.item_count      = commands->draw_count;
+        job.record          = commands_record_draws;
+        job.user            = &draws;
+        if (queries != NULL) {
+            job.pipeline_statistics = queries->inherited_statistics;
+        }
+        if (!renderpass->dynamic_rendering) {
+            job.vk_framebuffer = renderpass->vk_framebuffers[image_index];
+        }
+
+        if (!recorder_record(commands->recorder, &job, vk_secondary_buffers)) {
+            return false;
+        }
+    }
+
+    VkCommandBufferBeginInfo command_buffer_create_info = {0};
+    command_buffer_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_create_info.flags = usage;
 
-    vkCmdEndRenderPass(command_buffer);
+    VkResult res;
+    res = vkBeginCommandBuffer(command_buffer, &command_buffer_create_info);
+    if (res != VK_SUCCESS) {
+        log_error("(COMMANDS) vkBeginCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    queries_cmd_begin(queries, command_buffer, frame_index, threaded);
+
+    // With a dedicated compute queue the step was submitted there and the frame's submission
+    // waits for it.
+    if (commands->compute == NULL && commands->particles != NULL) {
+        particles_cmd_update(commands->particles, command_buffer);
+    }
+    if (commands->objects != NULL) {
+        objects_cmd_cull(commands->objects, command_buffer, commands->upload_ring, frame_offset);
+    }
+
+    commands_begin_rendering(command_buffer, renderpass, extent, image_index, threaded);
+
+    if (threaded) {
+        vkCmdExecuteCommands(
+            command_buffer, commands->recorder->thread_count, vk_secondary_buffers
+        );
+    } else if (pipeline != NULL) {
+        commands_record_draws(command_buffer, &draws, 0, commands->draw_count);
+    }
+
+    commands_end_rendering(command_buffer, renderpass, image_index);
+
+    queries_cmd_end(queries, command_buffer, frame_index);
 
     res = vkEndCommandBuffer(command_buffer);
     if (res != VK_SUCCESS) {
@@ -141,3 +492,139 @@ bool commands_record_frame(
 
     return true;
 }
+
+bool commands_record_frame(
+    const commands_t   *commands,
+    const device_t     *device,
+    const renderpass_t *renderpass,
+    const pipeline_t   *pipeline,
+    queries_t          *queries,
+    VkExtent2D          extent,
+    uint32_t            image_index,
+    uint32_t            frame_index
+) {
+    assert(frame_index < commands->vk_buffers_count);
+
+    uint32_t frame_offset = 0;
+    if (!commands_write_frame_data(commands, frame_index, &frame_offset)) {
+        return false;
+    }
+
+    return commands_record_buffer(
+        commands,
+        commands->vk_buffers[frame_index],
+        0,
+        renderpass,
+        pipeline,
+        queries,
+        extent,
+        image_index,
+        frame_index,
+        frame_offset,
+        commands->recorder != NULL
+    );
+}
+
+static void commands_free_static(commands_t *commands, const device_t *device) {
+    if (commands->vk_static_buffers == NULL) {
+        return;
+    }
+
+    vkFreeCommandBuffers(
+        device->vk_device,
+        commands->vk_pool,
+        commands->vk_static_buffers_count,
+        commands->vk_static_buffers
+    );
+    free(commands->vk_static_buffers);
+
+    commands->vk_static_buffers       = NULL;
+    commands->vk_static_buffers_count = 0;
+    commands->static_valid            = false;
+}
+
+// The caller guarantees the previous static buffers are no longer pending.
+bool commands_record_static(
+    commands_t         *commands,
+    const device_t     *device,
+    const renderpass_t *renderpass,
+    const pipeline_t   *pipeline,
+    VkExtent2D          extent,
+    uint32_t            image_count
+) {
+    assert(image_count <= renderpass->vk_image_count);
+
+    commands->static_valid = false;
+
+    // The particles set drawn alternates per frame, not per image.
+    assert(commands->compute == NULL);
+
+    if (commands->vk_static_buffers_count != image_count) {
+        commands_free_static(commands, device);
+
+        commands->vk_static_buffers
+            = (VkCommandBuffer *)malloc(image_count * sizeof(*commands->vk_static_buffers));
+        if (commands->vk_static_buffers == NULL) {
+            log_error("(COMMANDS) malloc failed.");
+            return false;
+        }
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {0};
+        command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_allocate_info.commandPool        = commands->vk_pool;
+        command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        command_buffer_allocate_info.commandBufferCount = image_count;
+
+        VkResult res;
+        res = vkAllocateCommandBuffers(
+            device->vk_device, &command_buffer_allocate_info, commands->vk_static_buffers
+        );
+        if (res != VK_SUCCESS) {
+            log_error("(COMMANDS) vkAllocateCommandBuffers failed (%s).", vk_res_str(res));
+            free(commands->vk_static_buffers);
+            commands->vk_static_buffers = NULL;
+            return false;
+        }
+        commands->vk_static_buffers_count = image_count;
+    }
+
+    // The static buffers read their frame data from the ring's last region, which no frame
+    // slot writes, so it stays valid while they are pending.
+    uint32_t frame_offset = 0;
+    if (commands->upload_ring != NULL) {
+        const uint32_t region = commands->upload_ring->region_count - 1;
+        upload_ring_begin(commands->upload_ring, region);
+        if (!commands_write_frame_data(commands, region, &frame_offset)
+            || !upload_ring_flush(commands->upload_ring, device, region)) {
+            return false;
+        }
+    }
+
+    // Frames in flight can share an image's buffer while an earlier submission of it is still
+    // executing, hence simultaneous use.
+    for (uint32_t i = 0; i < image_count; ++i) {
+        if (!commands_record_buffer(
+                commands,
+                commands->vk_static_buffers[i],
+                VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+                renderpass,
+                pipeline,
+                NULL,
+                extent,
+                i,
+                0,
+                frame_offset,
+                false
+            )) {
+            return false;
+        }
+    }
+
+    commands->static_valid = true;
+
+    return true;
+}
+
+void commands_invalidate_static(commands_t *commands) {
+    commands->static_valid = false;
+}
@@ -0,0 +1,241 @@
+#include "vk/compute.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static bool compute_create_semaphore(const device_t *device, VkSemaphore *vk_semaphore) {
+    VkSemaphoreCreateInfo semaphore_create_info = {0};
+    semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkResult res;
+    res = vkCreateSemaphore(device->vk_device, &semaphore_create_info, NULL, vk_semaphore);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkCreateSemaphore failed (%s).", vk_res_str(res));
+        *vk_semaphore = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+static bool compute_create_buffers(compute_t *compute) {
+    const device_t *device = compute->device;
+
+    VkCommandPoolCreateInfo command_pool_create_info = {0};
+    command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    command_pool_create_info.queueFamilyIndex = device->compute_queue_family_index;
+
+    VkResult res;
+    res = vkCreateCommandPool(
+        device->vk_device, &command_pool_create_info, NULL, &compute->vk_pool
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkCreateCommandPool failed (%s).", vk_res_str(res));
+        compute->vk_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    compute->vk_command_buffers
+        = (VkCommandBuffer *)calloc(compute->frame_count, sizeof(*compute->vk_command_buffers));
+    if (compute->vk_command_buffers == NULL) {
+        log_error("(COMPUTE) calloc failed.");
+        return false;
+    }
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {0};
+    command_buffer_allocate_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool = compute->vk_pool;
+    command_buffer_allocate_info.level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = compute->frame_count;
+
+    res = vkAllocateCommandBuffers(
+        device->vk_device, &command_buffer_allocate_info, compute->vk_command_buffers
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkAllocateCommandBuffers failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+bool compute_create(
+    compute_t           *compute,
+    const device_t      *device,
+    uint32_t             frame_count,
+    uint32_t             target_count,
+    VkPipelineStageFlags compute_stage,
+    VkPipelineStageFlags graphics_stage
+) {
+    assert(device->has_compute_queue);
+    assert(frame_count > 0);
+    assert(target_count > 1 && target_count <= COMPUTE_MAX_TARGETS);
+
+    memset(compute, 0, sizeof(*compute));
+
+    compute->device         = device;
+    compute->compute_stage  = compute_stage;
+    compute->graphics_stage = graphics_stage;
+    compute->frame_count    = frame_count;
+    compute->target_count   = target_count;
+
+    if (!compute_create_buffers(compute)) {
+        compute_destroy(compute);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < target_count; ++i) {
+        compute_target_t *target = &compute->targets[i];
+        if (!compute_create_semaphore(device, &target->vk_semaphore_computed)
+            || !compute_create_semaphore(device, &target->vk_semaphore_released)) {
+            compute_destroy(compute);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void compute_destroy(compute_t *compute) {
+    if (compute == NULL || compute->device == NULL) {
+        return;
+    }
+
+    const device_t *device = compute->device;
+
+    for (uint32_t i = 0; i < compute->target_count; ++i) {
+        compute_target_t *target = &compute->targets[i];
+        if (target->vk_semaphore_computed != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device->vk_device, target->vk_semaphore_computed, NULL);
+        }
+        if (target->vk_semaphore_released != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device->vk_device, target->vk_semaphore_released, NULL);
+        }
+    }
+
+    // Destroying the pool frees its command buffers.
+    if (compute->vk_pool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device->vk_device, compute->vk_pool, NULL);
+    }
+    free(compute->vk_command_buffers);
+
+    memset(compute, 0, sizeof(*compute));
+}
+
+bool compute_begin(compute_t *compute, uint32_t frame_index, VkCommandBuffer *command_buffer) {
+    assert(frame_index < compute->frame_count);
+
+    *command_buffer = compute->vk_command_buffers[frame_index];
+
+    VkResult res;
+    res = vkResetCommandBuffer(*command_buffer, 0);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkResetCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {0};
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    res = vkBeginCommandBuffer(*command_buffer, &command_buffer_begin_info);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkBeginCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    // The previous submission on this queue wrote the target read here.
+    VkMemoryBarrier memory_barrier = {0};
+    memory_barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(
+        *command_buffer,
+        compute->compute_stage,
+        compute->compute_stage,
+        0,
+        1,
+        &memory_barrier,
+        0,
+        NULL,
+        0,
+        NULL
+    );
+
+    return true;
+}
+
+bool compute_submit(compute_t *compute, uint32_t frame_index) {
+    assert(frame_index < compute->frame_count);
+
+    const device_t   *device         = compute->device;
+    VkCommandBuffer   command_buffer = compute->vk_command_buffers[frame_index];
+    const uint32_t    written        = (compute->target + 1) % compute->target_count;
+    compute_target_t *target         = &compute->targets[written];
+
+    VkResult res;
+    res = vkEndCommandBuffer(command_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkEndCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    // Only the graphics reads of the overwritten target are waited for, not those of the
+    // input, so the step overlaps the frame that draws the input.
+    VkSubmitInfo submit_info         = {0};
+    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount   = 1;
+    submit_info.pCommandBuffers      = &command_buffer;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores    = &target->vk_semaphore_computed;
+    if (target->release_pending) {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores    = &target->vk_semaphore_released;
+        submit_info.pWaitDstStageMask  = &compute->compute_stage;
+    }
+
+    res = vkQueueSubmit(device->compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE) vkQueueSubmit failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    target->release_pending = false;
+    compute->target         = written;
+    ++compute->submits;
+
+    return true;
+}
+
+// Each semaphore is signaled again only by a submission that is ordered after the wait on it:
+// the next write of a target waits on its release, and the next read waits on that write.
+void compute_graphics_semaphores(
+    compute_t   *compute,
+    VkSemaphore *vk_semaphore_computed,
+    VkSemaphore *vk_semaphore_released
+) {
+    compute_target_t *target = &compute->targets[compute->target];
+
+    *vk_semaphore_computed  = target->vk_semaphore_computed;
+    *vk_semaphore_released  = target->vk_semaphore_released;
+    target->release_pending = true;
+}
+
+void compute_log_stats(const compute_t *compute) {
+    if (compute->submits == 0) {
+        return;
+    }
+
+    log_debug(
+        "(COMPUTE) %llu submissions on the dedicated compute queue (family %u), %u targets.",
+        (unsigned long long)compute->submits,
+        compute->device->compute_queue_family_index,
+        compute->target_count
+    );
+}
@@ -0,0 +1,101 @@
+#include "vk/compute_pipeline.h"
+
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+bool compute_pipeline_create(
+    compute_pipeline_t          *pipeline,
+    const device_t              *device,
+    VkPipelineCache              vk_pipeline_cache,
+    const void                  *spv_data,
+    size_t                       spv_size,
+    const VkDescriptorSetLayout *vk_set_layouts,
+    uint32_t                     vk_set_layouts_count,
+    uint32_t                     push_constants_size
+) {
+    memset(pipeline, 0, sizeof(*pipeline));
+
+    VkShaderModuleCreateInfo shader_module_create_info = {0};
+    shader_module_create_info.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shader_module_create_info.codeSize = spv_size;
+    shader_module_create_info.pCode    = (const uint32_t *)spv_data;
+
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+
+    VkResult res;
+    res = vkCreateShaderModule(device->vk_device, &shader_module_create_info, NULL, &shader_module);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE_PIPELINE) vkCreateShaderModule failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    VkPushConstantRange push_constant_range = {0};
+    push_constant_range.stageFlags          = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constant_range.offset              = 0;
+    push_constant_range.size                = push_constants_size;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {0};
+    pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount = vk_set_layouts_count;
+    pipeline_layout_create_info.pSetLayouts    = vk_set_layouts;
+    if (push_constants_size > 0) {
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges    = &push_constant_range;
+    }
+
+    res = vkCreatePipelineLayout(
+        device->vk_device, &pipeline_layout_create_info, NULL, &pipeline->vk_pipeline_layout
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE_PIPELINE) vkCreatePipelineLayout failed (%s).", vk_res_str(res));
+        pipeline->vk_pipeline_layout = VK_NULL_HANDLE;
+        vkDestroyShaderModule(device->vk_device, shader_module, NULL);
+        return false;
+    }
+
+    VkComputePipelineCreateInfo compute_pipeline_create_info = {0};
+    compute_pipeline_create_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_pipeline_create_info.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compute_pipeline_create_info.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    compute_pipeline_create_info.stage.module = shader_module;
+    compute_pipeline_create_info.stage.pName  = "main";
+    compute_pipeline_create_info.layout       = pipeline->vk_pipeline_layout;
+    compute_pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
+    compute_pipeline_create_info.basePipelineIndex  = -1;
+
+    res = vkCreateComputePipelines(
+        device->vk_device,
+        vk_pipeline_cache,
+        1,
+        &compute_pipeline_create_info,
+        NULL,
+        &pipeline->vk_pipeline
+    );
+    vkDestroyShaderModule(device->vk_device, shader_module, NULL);
+    if (res != VK_SUCCESS) {
+        log_error("(COMPUTE_PIPELINE) vkCreateComputePipelines failed (%s).", vk_res_str(res));
+        pipeline->vk_pipeline = VK_NULL_HANDLE;
+        compute_pipeline_destroy(pipeline, device);
+        return false;
+    }
+
+    return true;
+}
+
+void compute_pipeline_destroy(compute_pipeline_t *pipeline, const device_t *device) {
+    if (pipeline == NULL) {
+        return;
+    }
+
+    if (pipeline->vk_pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device->vk_device, pipeline->vk_pipeline, NULL);
+    }
+
+    if (pipeline->vk_pipeline_layout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device->vk_device, pipeline->vk_pipeline_layout, NULL);
+    }
+
+    memset(pipeline, 0, sizeof(*pipeline));
+}
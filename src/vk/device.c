@@ -11,16 +11,22 @@
 typedef struct {
     uint32_t graphics_queue_family_index;
     uint32_t present_queue_family_index;
+    uint32_t transfer_queue_family_index;
+    uint32_t compute_queue_family_index;
     bool     has_graphics_queue_family;
     bool     has_present_queue_family;
+    bool     has_transfer_queue_family;
+    bool     has_compute_queue_family;
 } queue_family_indices_t;
 
-static const char *device_required_extensions[]
-    = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-       VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME,
-       "VK_KHR_portability_subset"};
-static const size_t device_required_extensions_count
-    = sizeof(device_required_extensions) / sizeof(device_required_extensions[0]);
+#define DEVICE_MAX_EXTENSIONS 16
+
+static const char *device_present_extensions[]
+    = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME};
+static const size_t device_present_extensions_count
+    = sizeof(device_present_extensions) / sizeof(device_present_extensions[0]);
+
+static const char *device_portability_subset_extension = "VK_KHR_portability_subset";
 
 static bool device_has_extension(VkPhysicalDevice device, const char *name) {
     uint32_t count = 0;
@@ -83,14 +89,29 @@ find_queue_families(VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface
     );
 
     for (uint32_t i = 0; i < count; ++i) {
+        const VkQueueFlags flags = device_queue_family_properties[i].queueFlags;
+
         if (!queue_family_indices.has_graphics_queue_family) {
-            if (device_queue_family_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            if (flags & VK_QUEUE_GRAPHICS_BIT) {
                 queue_family_indices.graphics_queue_family_index = i;
                 queue_family_indices.has_graphics_queue_family   = true;
             }
         }
 
-        if (!queue_family_indices.has_present_queue_family) {
+        // Dedicated families only: a copy engine without compute, a compute family without
+        // graphics. Work there runs alongside the graphics queue.
+        if (!queue_family_indices.has_transfer_queue_family && (flags & VK_QUEUE_TRANSFER_BIT)
+            && (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0) {
+            queue_family_indices.transfer_queue_family_index = i;
+            queue_family_indices.has_transfer_queue_family   = true;
+        }
+        if (!queue_family_indices.has_compute_queue_family && (flags & VK_QUEUE_COMPUTE_BIT)
+            && (flags & VK_QUEUE_GRAPHICS_BIT) == 0) {
+            queue_family_indices.compute_queue_family_index = i;
+            queue_family_indices.has_compute_queue_family   = true;
+        }
+
+        if (!queue_family_indices.has_present_queue_family && vk_surface != VK_NULL_HANDLE) {
             VkBool32 has_surface_support = VK_FALSE;
             VkResult res;
             res = vkGetPhysicalDeviceSurfaceSupportKHR(
@@ -110,17 +131,38 @@ find_queue_families(VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface
                 queue_family_indices.has_present_queue_family   = true;
             }
         }
-
-        if (queue_family_indices.has_graphics_queue_family
-            && queue_family_indices.has_present_queue_family) {
-            break;
-        }
     }
 
     free(device_queue_family_properties);
     return queue_family_indices;
 }
 
+static uint32_t
+device_timestamp_valid_bits(VkPhysicalDevice vk_physical_device, uint32_t queue_family_index) {
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &count, NULL);
+
+    if (queue_family_index >= count) {
+        return 0;
+    }
+
+    VkQueueFamilyProperties *device_queue_family_properties;
+    device_queue_family_properties
+        = (VkQueueFamilyProperties *)malloc(count * sizeof(*device_queue_family_properties));
+    if (device_queue_family_properties == NULL) {
+        log_error("(DEVICE) malloc failed.");
+        return 0;
+    }
+    vkGetPhysicalDeviceQueueFamilyProperties(
+        vk_physical_device, &count, device_queue_family_properties
+    );
+
+    uint32_t valid_bits = device_queue_family_properties[queue_family_index].timestampValidBits;
+
+    free(device_queue_family_properties);
+    return valid_bits;
+}
+
 static bool
 device_has_swapchain_support(VkPhysicalDevice vk_physical_device, VkSurfaceKHR vk_surface) {
     uint32_t formats_count       = 0;
@@ -155,23 +197,26 @@ static uint32_t device_score(VkPhysicalDevice vk_physical_device, VkSurfaceKHR v
     VkPhysicalDeviceFeatures device_features;
     vkGetPhysicalDeviceFeatures(vk_physical_device, &device_features);
 
-    for (size_t i = 0; i < device_required_extensions_count; ++i) {
-        if (!device_has_extension(vk_physical_device, device_required_extensions[i])) {
-            return 0;
-        }
-    }
-
     queue_family_indices_t queue_family_indices
         = find_queue_families(vk_physical_device, vk_surface);
     if (!queue_family_indices.has_graphics_queue_family) {
         return 0;
     }
-    if (!queue_family_indices.has_present_queue_family) {
-        return 0;
-    }
 
-    if (!device_has_swapchain_support(vk_physical_device, vk_surface)) {
-        return 0;
+    if (vk_surface != VK_NULL_HANDLE) {
+        for (size_t i = 0; i < device_present_extensions_count; ++i) {
+            if (!device_has_extension(vk_physical_device, device_present_extensions[i])) {
+                return 0;
+            }
+        }
+
+        if (!queue_family_indices.has_present_queue_family) {
+            return 0;
+        }
+
+        if (!device_has_swapchain_support(vk_physical_device, vk_surface)) {
+            return 0;
+        }
     }
 
     uint32_t score = 0;
@@ -235,45 +280,181 @@ bool device_create(device_t *device, VkInstance vk_instance, VkSurfaceKHR vk_sur
     queue_family_indices_t queue_family_indices
         = find_queue_families(device->vk_physical_device, vk_surface);
 
-    float                   priority = 1.0F;
-    VkDeviceQueueCreateInfo device_queue_create_infos[2];
-    uint32_t                device_queue_create_infos_count = 1;
+    // One queue per distinct family: graphics, present, dedicated transfer, dedicated compute.
+    uint32_t queue_families[4];
+    uint32_t queue_families_count = 0;
 
-    VkDeviceQueueCreateInfo *queue_create_info = device_queue_create_infos;
+    queue_families[queue_families_count++] = queue_family_indices.graphics_queue_family_index;
+    if (vk_surface != VK_NULL_HANDLE) {
+        queue_families[queue_families_count++] = queue_family_indices.present_queue_family_index;
+    }
+    if (queue_family_indices.has_transfer_queue_family) {
+        queue_families[queue_families_count++] = queue_family_indices.transfer_queue_family_index;
+    }
+    if (queue_family_indices.has_compute_queue_family) {
+        queue_families[queue_families_count++] = queue_family_indices.compute_queue_family_index;
+    }
 
-    *queue_create_info                  = (VkDeviceQueueCreateInfo){0};
-    queue_create_info->sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_create_info->queueFamilyIndex = queue_family_indices.graphics_queue_family_index;
-    queue_create_info->queueCount       = 1;
-    queue_create_info->pQueuePriorities = &priority;
-    ++queue_create_info;
+    float                   priority = 1.0F;
+    VkDeviceQueueCreateInfo device_queue_create_infos[4];
+    uint32_t                device_queue_create_infos_count = 0;
 
-    uint32_t graphics_queue_familiy_index = queue_family_indices.graphics_queue_family_index;
-    uint32_t present_queue_familiy_index  = queue_family_indices.present_queue_family_index;
+    for (uint32_t i = 0; i < queue_families_count; ++i) {
+        bool duplicate = false;
+        for (uint32_t j = 0; j < i; ++j) {
+            duplicate = duplicate || queue_families[j] == queue_families[i];
+        }
+        if (duplicate) {
+            continue;
+        }
 
-    if (graphics_queue_familiy_index != present_queue_familiy_index) {
-        ++device_queue_create_infos_count;
+        VkDeviceQueueCreateInfo *queue_create_info
+            = &device_queue_create_infos[device_queue_create_infos_count++];
         *queue_create_info                  = (VkDeviceQueueCreateInfo){0};
         queue_create_info->sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_create_info->queueFamilyIndex = queue_family_indices.present_queue_family_index;
+        queue_create_info->queueFamilyIndex = queue_families[i];
         queue_create_info->queueCount       = 1;
         queue_create_info->pQueuePriorities = &priority;
     }
 
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device->vk_physical_device, &device_properties);
+
+    VkPhysicalDeviceVulkan13Features supported_vulkan13_features = {0};
+    supported_vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    // Optional frame pacing through present ids, only meaningful when presenting.
+    const bool has_present_wait_extensions
+        = vk_surface != VK_NULL_HANDLE
+       && device_has_extension(device->vk_physical_device, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+       && device_has_extension(device->vk_physical_device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+    VkPhysicalDevicePresentWaitFeaturesKHR supported_present_wait_features = {0};
+    supported_present_wait_features.sType
+        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+    VkPhysicalDevicePresentIdFeaturesKHR supported_present_id_features = {0};
+    supported_present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    supported_present_id_features.pNext = &supported_present_wait_features;
+
+    void *supported_chain = NULL;
+    if (has_present_wait_extensions) {
+        supported_chain = &supported_present_id_features;
+    }
+    if (device_properties.apiVersion >= VK_API_VERSION_1_3) {
+        supported_vulkan13_features.pNext = supported_chain;
+        supported_chain                   = &supported_vulkan13_features;
+    }
+
+    VkPhysicalDeviceVulkan12Features supported_vulkan12_features = {0};
+    supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    supported_vulkan12_features.pNext = supported_chain;
+    if (device_properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures2 supported_features = {0};
+        supported_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features.pNext = &supported_vulkan12_features;
+        vkGetPhysicalDeviceFeatures2(device->vk_physical_device, &supported_features);
+    }
+
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {0};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.timelineSemaphore = supported_vulkan12_features.timelineSemaphore;
+    vulkan12_features.drawIndirectCount = supported_vulkan12_features.drawIndirectCount;
+
+    VkPhysicalDeviceFeatures supported_core_features;
+    vkGetPhysicalDeviceFeatures(device->vk_physical_device, &supported_core_features);
+
+    // Update-after-bind arrays for the bindless table, all or nothing. Shaders index them with
+    // push constant values, which are dynamically uniform but not constant.
+    const bool has_descriptor_indexing
+        = supported_core_features.shaderStorageBufferArrayDynamicIndexing == VK_TRUE
+       && supported_core_features.shaderSampledImageArrayDynamicIndexing == VK_TRUE
+       && supported_vulkan12_features.descriptorIndexing == VK_TRUE
+       && supported_vulkan12_features.runtimeDescriptorArray == VK_TRUE
+       && supported_vulkan12_features.descriptorBindingPartiallyBound == VK_TRUE
+       && supported_vulkan12_features.descriptorBindingUpdateUnusedWhilePending == VK_TRUE
+       && supported_vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind == VK_TRUE
+       && supported_vulkan12_features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE;
+    if (has_descriptor_indexing) {
+        vulkan12_features.descriptorIndexing                            = VK_TRUE;
+        vulkan12_features.runtimeDescriptorArray                        = VK_TRUE;
+        vulkan12_features.descriptorBindingPartiallyBound               = VK_TRUE;
+        vulkan12_features.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+        vulkan12_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        vulkan12_features.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+    }
+
+    VkPhysicalDeviceVulkan13Features vulkan13_features = {0};
+    vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13_features.dynamicRendering = supported_vulkan13_features.dynamicRendering;
+
     VkPhysicalDeviceSwapchainMaintenance1FeaturesKHR swapchain_maintenance1_features = {0};
     swapchain_maintenance1_features.sType
         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_KHR;
     swapchain_maintenance1_features.swapchainMaintenance1 = VK_TRUE;
 
-    VkPhysicalDeviceFeatures features = {0};
+    const bool has_present_wait = supported_present_id_features.presentId == VK_TRUE
+                               && supported_present_wait_features.presentWait == VK_TRUE;
+
+    VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {0};
+    present_id_features.sType     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    present_id_features.presentId = VK_TRUE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {0};
+    present_wait_features.sType       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    present_wait_features.presentWait = VK_TRUE;
+
+    void *features_chain = NULL;
+    if (device_properties.apiVersion >= VK_API_VERSION_1_2) {
+        vulkan12_features.pNext = features_chain;
+        features_chain          = &vulkan12_features;
+    }
+    if (device_properties.apiVersion >= VK_API_VERSION_1_3) {
+        vulkan13_features.pNext = features_chain;
+        features_chain          = &vulkan13_features;
+    }
+    if (vk_surface != VK_NULL_HANDLE) {
+        swapchain_maintenance1_features.pNext = features_chain;
+        features_chain                        = &swapchain_maintenance1_features;
+    }
+    if (has_present_wait) {
+        present_id_features.pNext   = features_chain;
+        present_wait_features.pNext = &present_id_features;
+        features_chain              = &present_wait_features;
+    }
+
+    const char *extensions[DEVICE_MAX_EXTENSIONS];
+    uint32_t    extensions_count = 0;
+    if (vk_surface != VK_NULL_HANDLE) {
+        for (size_t i = 0; i < device_present_extensions_count; ++i) {
+            extensions[extensions_count++] = device_present_extensions[i];
+        }
+    }
+    if (has_present_wait) {
+        extensions[extensions_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        extensions[extensions_count++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+    }
+    if (device_has_extension(device->vk_physical_device, device_portability_subset_extension)) {
+        extensions[extensions_count++] = device_portability_subset_extension;
+    }
+
+    VkPhysicalDeviceFeatures features  = {0};
+    features.pipelineStatisticsQuery   = supported_core_features.pipelineStatisticsQuery;
+    features.inheritedQueries          = supported_core_features.inheritedQueries;
+    features.multiDrawIndirect         = supported_core_features.multiDrawIndirect;
+    features.drawIndirectFirstInstance = supported_core_features.drawIndirectFirstInstance;
+    if (has_descriptor_indexing) {
+        features.shaderStorageBufferArrayDynamicIndexing = VK_TRUE;
+        features.shaderSampledImageArrayDynamicIndexing  = VK_TRUE;
+    }
 
     VkDeviceCreateInfo device_create_info      = {0};
     device_create_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    device_create_info.pNext                   = &swapchain_maintenance1_features;
+    device_create_info.pNext                   = features_chain;
     device_create_info.queueCreateInfoCount    = device_queue_create_infos_count;
     device_create_info.pQueueCreateInfos       = device_queue_create_infos;
-    device_create_info.enabledExtensionCount   = device_required_extensions_count;
-    device_create_info.ppEnabledExtensionNames = device_required_extensions;
+    device_create_info.enabledExtensionCount   = extensions_count;
+    device_create_info.ppEnabledExtensionNames = extensions;
     device_create_info.pEnabledFeatures        = &features;
 
     res = vkCreateDevice(device->vk_physical_device, &device_create_info, NULL, &device->vk_device);
@@ -287,17 +468,99 @@ bool device_create(device_t *device, VkInstance vk_instance, VkSurfaceKHR vk_sur
     device->present_queue_family_index   = queue_family_indices.present_queue_family_index;
     device->has_graphics_queue           = queue_family_indices.has_graphics_queue_family;
     device->has_present_queue            = queue_family_indices.has_present_queue_family;
+    device->has_transfer_queue           = queue_family_indices.has_transfer_queue_family;
+    device->has_compute_queue            = queue_family_indices.has_compute_queue_family;
+    device->api_version                  = device_properties.apiVersion;
+    device->vendor_id                    = device_properties.vendorID;
+    device->device_id                    = device_properties.deviceID;
+    device->has_timeline_semaphore       = vulkan12_features.timelineSemaphore == VK_TRUE;
+    device->has_pipeline_statistics      = features.pipelineStatisticsQuery == VK_TRUE;
+    device->has_inherited_queries        = features.inheritedQueries == VK_TRUE;
+    device->has_dynamic_rendering        = vulkan13_features.dynamicRendering == VK_TRUE;
+    device->has_multi_draw_indirect      = features.multiDrawIndirect == VK_TRUE
+                                        && features.drawIndirectFirstInstance == VK_TRUE;
+    device->has_draw_indirect_count      = vulkan12_features.drawIndirectCount == VK_TRUE;
+    device->has_descriptor_indexing      = has_descriptor_indexing;
+    device->has_present_wait             = has_present_wait;
+    device->timestamp_period             = device_properties.limits.timestampPeriod;
+    device->timestamp_valid_bits         = device_timestamp_valid_bits(
+        device->vk_physical_device, device->graphics_queue_familiy_index
+    );
 
     vkGetDeviceQueue(
         device->vk_device, device->graphics_queue_familiy_index, 0, &device->graphics_queue
     );
-    vkGetDeviceQueue(
-        device->vk_device, device->present_queue_family_index, 0, &device->present_queue
+    if (device->has_present_queue) {
+        vkGetDeviceQueue(
+            device->vk_device, device->present_queue_family_index, 0, &device->present_queue
+        );
+    }
+
+    // Without a dedicated family the work goes to the graphics queue.
+    device->transfer_queue_family_index = device->graphics_queue_familiy_index;
+    device->transfer_queue              = device->graphics_queue;
+    if (device->has_transfer_queue) {
+        device->transfer_queue_family_index = queue_family_indices.transfer_queue_family_index;
+        vkGetDeviceQueue(
+            device->vk_device, device->transfer_queue_family_index, 0, &device->transfer_queue
+        );
+    }
+
+    device->compute_queue_family_index = device->graphics_queue_familiy_index;
+    device->compute_queue              = device->graphics_queue;
+    if (device->has_compute_queue) {
+        device->compute_queue_family_index = queue_family_indices.compute_queue_family_index;
+        vkGetDeviceQueue(
+            device->vk_device, device->compute_queue_family_index, 0, &device->compute_queue
+        );
+    }
+
+    log_debug(
+        "(DEVICE) queue families: graphics %u, transfer %u%s, compute %u%s.",
+        device->graphics_queue_familiy_index,
+        device->transfer_queue_family_index,
+        device->has_transfer_queue ? " (dedicated)" : "",
+        device->compute_queue_family_index,
+        device->has_compute_queue ? " (dedicated)" : ""
+    );
+
+    if (device->has_present_wait) {
+        device->vk_wait_for_present = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(
+            device->vk_device, "vkWaitForPresentKHR"
+        );
+        device->has_present_wait = device->vk_wait_for_present != NULL;
+    }
+
+    vkGetPhysicalDeviceMemoryProperties(device->vk_physical_device, &device->memory_properties);
+
+    memcpy(
+        device->pipeline_cache_uuid,
+        device_properties.pipelineCacheUUID,
+        sizeof(device->pipeline_cache_uuid)
     );
 
     return true;
 }
 
+bool device_find_memory_type(
+    const device_t       *device,
+    uint32_t              type_bits,
+    VkMemoryPropertyFlags properties,
+    uint32_t             *memory_type_index
+) {
+    for (uint32_t i = 0; i < device->memory_properties.memoryTypeCount; ++i) {
+        if ((type_bits & (1U << i)) == 0) {
+            continue;
+        }
+        if ((device->memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            *memory_type_index = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void device_destroy(device_t *device) {
     if (device == NULL) {
         return;
@@ -3,47 +3,162 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include "util/clock.h"
 #include "util/log.h"
 #include "vk/debug.h"
 
-draw_result_t draw_frame(
+static bool draw_prepare_commands(
     const device_t     *device,
-    const swapchain_t  *swapchain,
     const renderpass_t *renderpass,
     const pipeline_t   *pipeline,
     const commands_t   *commands,
-    const sync_t       *sync,
-    uint32_t           *current_frame
+    queries_t          *queries,
+    VkExtent2D          extent,
+    uint32_t            image_index,
+    uint32_t            frame_index,
+    VkCommandBuffer    *command_buffer
 ) {
-    assert(*current_frame < sync->frame_count);
+    // The frame slot was waited on, so its compute command buffer is free as well.
+    if (commands->compute != NULL
+        && !particles_submit_update(commands->particles, commands->compute, frame_index)) {
+        return false;
+    }
+
+    if (commands->static_valid) {
+        *command_buffer = commands->vk_static_buffers[image_index];
+        return true;
+    }
+
+    *command_buffer = commands->vk_buffers[frame_index];
 
     VkResult res;
-    res = vkWaitForFences(
-        device->vk_device, 1, &sync->vk_fence_in_flight[*current_frame], VK_TRUE, UINT64_MAX
-    );
+    res = vkResetCommandBuffer(*command_buffer, 0);
     if (res != VK_SUCCESS) {
-        log_error("(DRAW) vkWaitForFences failed (%s).", vk_res_str(res));
-        return DRAW_ERROR;
+        log_error("(DRAW) vkResetCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
     }
-    res = vkResetFences(device->vk_device, 1, &sync->vk_fence_in_flight[*current_frame]);
-    if (res != VK_SUCCESS) {
-        log_error("(DRAW) vkResetFences failed (%s).", vk_res_str(res));
-        return DRAW_ERROR;
+
+    // The frame slot was waited on, so the GPU is done with its upload region.
+    if (commands->upload_ring != NULL) {
+        upload_ring_begin(commands->upload_ring, frame_index);
     }
 
-    res = vkWaitForFences(
-        device->vk_device, 1, &sync->vk_fence_present_done[*current_frame], VK_TRUE, UINT64_MAX
-    );
-    if (res != VK_SUCCESS) {
-        log_error("(DRAW) vkWaitForFences failed (%s).", vk_res_str(res));
-        return DRAW_ERROR;
+    if (!commands_record_frame(
+            commands, device, renderpass, pipeline, queries, extent, image_index, frame_index
+        )) {
+        return false;
+    }
+
+    return commands->upload_ring == NULL
+        || upload_ring_flush(commands->upload_ring, device, frame_index);
+}
+
+// Submits a frame to the graphics queue, with the frame slot's fence or the next timeline value.
+// With the particles stepped on the compute queue it waits for the step and signals the release
+// the step after next waits on.
+static bool draw_submit(
+    const device_t   *device,
+    const commands_t *commands,
+    sync_t           *sync,
+    VkCommandBuffer   command_buffer,
+    uint32_t          frame_index,
+    VkSemaphore       image_available,
+    VkSemaphore       render_finished
+) {
+    VkSemaphore          wait_semaphores[2] = {0};
+    VkPipelineStageFlags wait_stages[2]     = {0};
+    uint64_t             wait_values[2]     = {0};
+    uint32_t             wait_count         = 0;
+
+    VkSemaphore signal_semaphores[3] = {0};
+    uint64_t    signal_values[3]     = {0};
+    uint32_t    signal_count         = 0;
+
+    if (image_available != VK_NULL_HANDLE) {
+        wait_semaphores[wait_count] = image_available;
+        wait_stages[wait_count++]   = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
+    if (render_finished != VK_NULL_HANDLE) {
+        signal_semaphores[signal_count++] = render_finished;
+    }
+    if (commands->compute != NULL) {
+        compute_graphics_semaphores(
+            commands->compute, &wait_semaphores[wait_count], &signal_semaphores[signal_count++]
+        );
+        wait_stages[wait_count++] = commands->compute->graphics_stage;
     }
-    res = vkResetFences(device->vk_device, 1, &sync->vk_fence_present_done[*current_frame]);
+
+    VkFence submit_fence = VK_NULL_HANDLE;
+
+    VkTimelineSemaphoreSubmitInfo timeline_semaphore_submit_info = {0};
+    if (sync->mode == SYNC_MODE_TIMELINE) {
+        signal_values[signal_count]       = sync->timeline_value + 1;
+        signal_semaphores[signal_count++] = sync->vk_timeline;
+
+        timeline_semaphore_submit_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_semaphore_submit_info.waitSemaphoreValueCount   = wait_count;
+        timeline_semaphore_submit_info.pWaitSemaphoreValues      = wait_values;
+        timeline_semaphore_submit_info.signalSemaphoreValueCount = signal_count;
+        timeline_semaphore_submit_info.pSignalSemaphoreValues    = signal_values;
+    } else {
+        submit_fence = sync->vk_fence_in_flight[frame_index];
+    }
+
+    VkSubmitInfo submit_info         = {0};
+    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount   = wait_count;
+    submit_info.pWaitSemaphores      = wait_semaphores;
+    submit_info.pWaitDstStageMask    = wait_stages;
+    submit_info.commandBufferCount   = 1;
+    submit_info.pCommandBuffers      = &command_buffer;
+    submit_info.signalSemaphoreCount = signal_count;
+    submit_info.pSignalSemaphores    = signal_semaphores;
+    if (sync->mode == SYNC_MODE_TIMELINE) {
+        submit_info.pNext = &timeline_semaphore_submit_info;
+    }
+
+    VkResult res;
+    res = vkQueueSubmit(device->graphics_queue, 1, &submit_info, submit_fence);
     if (res != VK_SUCCESS) {
-        log_error("(DRAW) vkResetFences failed (%s).", vk_res_str(res));
+        log_error("(DRAW) vkQueueSubmit failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    if (sync->mode == SYNC_MODE_TIMELINE) {
+        sync->timeline_value += 1;
+    }
+
+    return true;
+}
+
+draw_result_t draw_frame(
+    const device_t     *device,
+    const swapchain_t  *swapchain,
+    const renderpass_t *renderpass,
+    const pipeline_t   *pipeline,
+    const commands_t   *commands,
+    queries_t          *queries,
+    sync_t             *sync,
+    uint32_t           *current_frame,
+    uint64_t            present_id,
+    draw_timing_t      *timing
+) {
+    assert(*current_frame < sync->frame_count);
+
+    *timing = (draw_timing_t){0};
+
+    uint64_t start_ns = clock_now_ns();
+    if (!sync_wait_frame(sync, device, *current_frame)) {
         return DRAW_ERROR;
     }
+    uint64_t wait_end_ns = clock_now_ns();
+    timing->wait_ns      = wait_end_ns - start_ns;
+
+    // The readback of the slot's queries belongs to neither the wait nor the next phase.
+    queries_collect(queries, device, *current_frame);
+    uint64_t collect_end_ns = clock_now_ns();
 
+    VkResult res;
     uint32_t image_index = 0;
     res                  = vkAcquireNextImageKHR(
         device->vk_device,
@@ -53,6 +168,8 @@ draw_result_t draw_frame(
         VK_NULL_HANDLE,
         &image_index
     );
+    uint64_t acquire_end_ns = clock_now_ns();
+    timing->acquire_ns      = acquire_end_ns - collect_end_ns;
     if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         return DRAW_NEED_RECREATE;
     } else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
@@ -60,56 +177,89 @@ draw_result_t draw_frame(
         return DRAW_ERROR;
     }
 
-    res = vkResetCommandBuffer(commands->vk_buffers[*current_frame], 0);
-    if (res != VK_SUCCESS) {
-        log_error("(DRAW) vkResetCommandBuffer failed (%s).", vk_res_str(res));
+    if (!sync_reset_frame(sync, device, *current_frame)) {
         return DRAW_ERROR;
     }
 
-    if (!commands_record_frame(
-            commands, device, renderpass, pipeline, swapchain, image_index, *current_frame
+    VkSemaphore render_finished = sync->vk_semaphore_render_finished[*current_frame];
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if (!draw_prepare_commands(
+            device,
+            renderpass,
+            pipeline,
+            commands,
+            queries,
+            swapchain->extent,
+            image_index,
+            *current_frame,
+            &command_buffer
         )) {
         return DRAW_ERROR;
     }
+    uint64_t record_end_ns = clock_now_ns();
+    timing->record_ns      = record_end_ns - acquire_end_ns;
 
-    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-    VkSubmitInfo submit_info         = {0};
-    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.waitSemaphoreCount   = 1;
-    submit_info.pWaitSemaphores      = &sync->vk_semaphore_image_available[*current_frame];
-    submit_info.pWaitDstStageMask    = &wait_stage;
-    submit_info.commandBufferCount   = 1;
-    submit_info.pCommandBuffers      = &commands->vk_buffers[*current_frame];
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores    = &sync->vk_semaphore_render_finished[*current_frame];
-
-    res = vkQueueSubmit(
-        device->graphics_queue, 1, &submit_info, sync->vk_fence_in_flight[*current_frame]
-    );
-    if (res != VK_SUCCESS) {
-        log_error("(DRAW) vkQueueSubmit failed (%s).", vk_res_str(res));
+    if (!draw_submit(
+            device,
+            commands,
+            sync,
+            command_buffer,
+            *current_frame,
+            sync->vk_semaphore_image_available[*current_frame],
+            render_finished
+        )) {
         return DRAW_ERROR;
     }
+    uint64_t submit_end_ns = clock_now_ns();
+    timing->submit_ns      = submit_end_ns - record_end_ns;
 
     VkSwapchainPresentFenceInfoKHR swapchain_present_fence_info = {0};
     swapchain_present_fence_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_KHR;
     swapchain_present_fence_info.swapchainCount = 1;
-    swapchain_present_fence_info.pFences        = &sync->vk_fence_present_done[*current_frame];
+    if (sync->vk_fence_present_done != NULL) {
+        swapchain_present_fence_info.pFences = &sync->vk_fence_present_done[*current_frame];
+    }
+
+    VkSwapchainPresentModeInfoEXT swapchain_present_mode_info = {0};
+    swapchain_present_mode_info.sType          = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODE_INFO_EXT;
+    swapchain_present_mode_info.swapchainCount = 1;
+    swapchain_present_mode_info.pPresentModes  = &swapchain->vk_present_mode;
+
+    // VK_KHR_present_id, for the frame pacer's present waits.
+    VkPresentIdKHR present_id_info = {0};
+    present_id_info.sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    present_id_info.swapchainCount = 1;
+    present_id_info.pPresentIds    = &present_id;
+
+    const void *present_chain = NULL;
+    if (present_id != 0) {
+        present_id_info.pNext = present_chain;
+        present_chain         = &present_id_info;
+    }
+    if (swapchain->vk_present_modes_count > 1) {
+        swapchain_present_mode_info.pNext = present_chain;
+        present_chain                     = &swapchain_present_mode_info;
+    }
+    if (sync->vk_fence_present_done != NULL) {
+        swapchain_present_fence_info.pNext = present_chain;
+        present_chain                      = &swapchain_present_fence_info;
+    }
 
     VkPresentInfoKHR present_info   = {0};
     present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.pNext              = &swapchain_present_fence_info;
     present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores    = &sync->vk_semaphore_render_finished[*current_frame];
+    present_info.pWaitSemaphores    = &render_finished;
     present_info.swapchainCount     = 1;
     present_info.pSwapchains        = &swapchain->vk_swapchain;
     present_info.pImageIndices      = &image_index;
+    present_info.pNext              = present_chain;
 
-    res = vkQueuePresentKHR(device->present_queue, &present_info);
+    res                = vkQueuePresentKHR(device->present_queue, &present_info);
+    timing->present_ns = clock_now_ns() - submit_end_ns;
     if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
         *current_frame = (*current_frame + 1) % sync->frame_count;
-        return DRAW_NEED_RECREATE;
+        return res == VK_SUBOPTIMAL_KHR ? DRAW_SUBOPTIMAL : DRAW_NEED_RECREATE;
     } else if (res != VK_SUCCESS) {
         log_error("(DRAW) vkQueuePresentKHR failed (%s).", vk_res_str(res));
         return DRAW_ERROR;
@@ -119,3 +269,63 @@ draw_result_t draw_frame(
 
     return DRAW_SUCCESS;
 }
+
+draw_result_t draw_offscreen_frame(
+    const device_t     *device,
+    const offscreen_t  *offscreen,
+    const renderpass_t *renderpass,
+    const pipeline_t   *pipeline,
+    const commands_t   *commands,
+    queries_t          *queries,
+    sync_t             *sync,
+    uint32_t           *current_frame,
+    draw_timing_t      *timing
+) {
+    assert(*current_frame < sync->frame_count);
+
+    *timing = (draw_timing_t){0};
+
+    uint64_t start_ns = clock_now_ns();
+    if (!sync_wait_frame(sync, device, *current_frame)) {
+        return DRAW_ERROR;
+    }
+    uint64_t wait_end_ns = clock_now_ns();
+    timing->wait_ns      = wait_end_ns - start_ns;
+
+    queries_collect(queries, device, *current_frame);
+    uint64_t collect_end_ns = clock_now_ns();
+
+    if (!sync_reset_frame(sync, device, *current_frame)) {
+        return DRAW_ERROR;
+    }
+
+    uint32_t image_index = *current_frame % offscreen->vk_image_count;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if (!draw_prepare_commands(
+            device,
+            renderpass,
+            pipeline,
+            commands,
+            queries,
+            offscreen->extent,
+            image_index,
+            *current_frame,
+            &command_buffer
+        )) {
+        return DRAW_ERROR;
+    }
+    uint64_t record_end_ns = clock_now_ns();
+    timing->record_ns      = record_end_ns - collect_end_ns;
+
+    if (!draw_submit(
+            device, commands, sync, command_buffer, *current_frame, VK_NULL_HANDLE, VK_NULL_HANDLE
+        )) {
+        return DRAW_ERROR;
+    }
+    timing->submit_ns = clock_now_ns() - record_end_ns;
+
+    *current_frame = (*current_frame + 1) % sync->frame_count;
+
+    return DRAW_SUCCESS;
+}
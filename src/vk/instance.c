@@ -102,10 +102,10 @@ static bool instance_has_extension(const char *name) {
     return found;
 }
 
-bool instance_create(instance_t *instance) {
+bool instance_create(instance_t *instance, bool headless) {
     memset(instance, 0, sizeof(*instance));
 
-    if (!platform_vulkan_supported()) {
+    if (!headless && !platform_vulkan_supported()) {
         return false;
     }
 
@@ -115,8 +115,10 @@ bool instance_create(instance_t *instance) {
     uint32_t flags = 0;
 
     uint32_t     platform_extensions_count = 0;
-    const char **platform_extensions
-        = platform_required_instance_extensions(&platform_extensions_count);
+    const char **platform_extensions       = NULL;
+    if (!headless) {
+        platform_extensions = platform_required_instance_extensions(&platform_extensions_count);
+    }
     for (uint32_t i = 0; i < platform_extensions_count; ++i) {
         if (!instance_has_extension(platform_extensions[i])) {
             log_error(
@@ -128,7 +130,10 @@ bool instance_create(instance_t *instance) {
         }
     }
 
-    for (uint32_t i = 0; i < instance_required_extensions_count; ++i) {
+    const uint32_t required_extensions_count
+        = headless ? 0 : (uint32_t)instance_required_extensions_count;
+
+    for (uint32_t i = 0; i < required_extensions_count; ++i) {
         if (!instance_has_extension(instance_required_extensions[i])) {
             log_error(
                 "(INSTANCE) required instance extension not available (%s).",
@@ -143,7 +148,7 @@ bool instance_create(instance_t *instance) {
     const bool has_debug_utils_extension
         = has_validation && instance_has_extension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
-    uint32_t extensions_count = platform_extensions_count + instance_required_extensions_count;
+    uint32_t extensions_count = platform_extensions_count + required_extensions_count;
     if (has_portability_enumeration_extension) {
         ++extensions_count;
     }
@@ -151,13 +156,13 @@ bool instance_create(instance_t *instance) {
         ++extensions_count;
     }
 
-    const char *extensions[extensions_count];
+    const char *extensions[extensions_count + 1];
 
     const char **exts = extensions;
     for (uint32_t i = 0; i < platform_extensions_count; ++i) {
         *(exts++) = platform_extensions[i];
     }
-    for (uint32_t i = 0; i < instance_required_extensions_count; ++i) {
+    for (uint32_t i = 0; i < required_extensions_count; ++i) {
         *(exts++) = instance_required_extensions[i];
     }
     if (has_portability_enumeration_extension) {
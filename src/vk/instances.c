@@ -0,0 +1,237 @@
+#include "vk/instances.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static bool instances_create_buffer(
+    const device_t       *device,
+    memory_t             *memory,
+    VkDeviceSize          size,
+    VkBufferUsageFlags    usage,
+    VkMemoryPropertyFlags properties,
+    memory_strategy_t     strategy,
+    VkBuffer             *vk_buffer,
+    memory_allocation_t  *allocation
+) {
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size               = size;
+    buffer_create_info.usage              = usage;
+    buffer_create_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult res;
+    res = vkCreateBuffer(device->vk_device, &buffer_create_info, NULL, vk_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(INSTANCES) vkCreateBuffer failed (%s).", vk_res_str(res));
+        *vk_buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!memory_alloc_buffer(memory, *vk_buffer, properties, 0, strategy, allocation)) {
+        log_error("(INSTANCES) failed to allocate buffer memory.");
+        return false;
+    }
+
+    return true;
+}
+
+static uint32_t instances_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static float instances_unit(uint32_t seed) {
+    return (float)(instances_hash(seed) & 0xffffffU) / (float)0x1000000U;
+}
+
+// Scattered over the viewport, scaled so the whole set covers it about twice.
+static void instances_fill(instance_data_t *data, uint32_t count) {
+    const float scale = 3.0F / sqrtf((float)count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        data[i].transform[0] = instances_unit(4 * i + 0) * 2.0F - 1.0F;
+        data[i].transform[1] = instances_unit(4 * i + 1) * 2.0F - 1.0F;
+        data[i].transform[2] = scale * (0.5F + instances_unit(4 * i + 2));
+        data[i].transform[3] = instances_unit(4 * i + 3) * 6.2831853F;
+        data[i].color[0]     = instances_unit(i ^ 0x9e3779b9U);
+        data[i].color[1]     = instances_unit(i ^ 0x85ebca6bU);
+        data[i].color[2]     = instances_unit(i ^ 0xc2b2ae35U);
+        data[i].color[3]     = 1.0F;
+    }
+}
+
+// Stages the instance data through the transfer queue; the vertex shader of later graphics
+// submissions reads it.
+static bool instances_upload(instances_t *instances, transfer_t *transfer, VkDeviceSize size) {
+    instance_data_t *data = malloc(size);
+    if (data == NULL) {
+        log_error("(INSTANCES) failed to allocate instance data.");
+        return false;
+    }
+    instances_fill(data, instances->count);
+
+    bool ok = transfer_upload_buffer(
+        transfer,
+        instances->vk_buffer,
+        0,
+        data,
+        size,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT
+    );
+    if (!ok) {
+        log_error("(INSTANCES) failed to upload instance data.");
+    }
+
+    free(data);
+
+    return ok;
+}
+
+static bool instances_create_descriptors(instances_t *instances, const device_t *device) {
+    VkDescriptorSetLayoutBinding set_layout_binding = {0};
+    set_layout_binding.binding                      = 0;
+    set_layout_binding.descriptorType               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    set_layout_binding.descriptorCount              = 1;
+    set_layout_binding.stageFlags                   = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info = {0};
+    set_layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_create_info.bindingCount = 1;
+    set_layout_create_info.pBindings    = &set_layout_binding;
+
+    VkResult res;
+    res = vkCreateDescriptorSetLayout(
+        device->vk_device, &set_layout_create_info, NULL, &instances->vk_set_layout
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(INSTANCES) vkCreateDescriptorSetLayout failed (%s).", vk_res_str(res));
+        instances->vk_set_layout = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {0};
+    pool_size.type                 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount      = 1;
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {0};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.maxSets       = 1;
+    descriptor_pool_create_info.poolSizeCount = 1;
+    descriptor_pool_create_info.pPoolSizes    = &pool_size;
+
+    res = vkCreateDescriptorPool(
+        device->vk_device, &descriptor_pool_create_info, NULL, &instances->vk_descriptor_pool
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(INSTANCES) vkCreateDescriptorPool failed (%s).", vk_res_str(res));
+        instances->vk_descriptor_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {0};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool     = instances->vk_descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts        = &instances->vk_set_layout;
+
+    res = vkAllocateDescriptorSets(
+        device->vk_device, &descriptor_set_allocate_info, &instances->vk_descriptor_set
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(INSTANCES) vkAllocateDescriptorSets failed (%s).", vk_res_str(res));
+        instances->vk_descriptor_set = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorBufferInfo descriptor_buffer_info = {0};
+    descriptor_buffer_info.buffer                 = instances->vk_buffer;
+    descriptor_buffer_info.offset                 = 0;
+    descriptor_buffer_info.range                  = VK_WHOLE_SIZE;
+
+    VkWriteDescriptorSet write_descriptor_set = {0};
+    write_descriptor_set.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_set.dstSet               = instances->vk_descriptor_set;
+    write_descriptor_set.dstBinding           = 0;
+    write_descriptor_set.descriptorCount      = 1;
+    write_descriptor_set.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write_descriptor_set.pBufferInfo          = &descriptor_buffer_info;
+
+    vkUpdateDescriptorSets(device->vk_device, 1, &write_descriptor_set, 0, NULL);
+
+    return true;
+}
+
+bool instances_create(
+    instances_t    *instances,
+    const device_t *device,
+    memory_t       *memory,
+    transfer_t     *transfer,
+    uint32_t        count
+) {
+    assert(count > 0);
+
+    memset(instances, 0, sizeof(*instances));
+    instances->count  = count;
+    instances->memory = memory;
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device->vk_physical_device, &device_properties);
+
+    const VkDeviceSize size = (VkDeviceSize)count * sizeof(instance_data_t);
+    if (size > device_properties.limits.maxStorageBufferRange) {
+        log_error(
+            "(INSTANCES) %u instances need %llu bytes, the storage buffer range is %u.",
+            count,
+            (unsigned long long)size,
+            device_properties.limits.maxStorageBufferRange
+        );
+        return false;
+    }
+
+    if (!instances_create_buffer(
+            device,
+            memory,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            MEMORY_STRATEGY_BUDDY,
+            &instances->vk_buffer,
+            &instances->allocation
+        )
+        || !instances_upload(instances, transfer, size)
+        || !instances_create_descriptors(instances, device)) {
+        instances_destroy(instances, device);
+        return false;
+    }
+
+    return true;
+}
+
+void instances_destroy(instances_t *instances, const device_t *device) {
+    if (instances == NULL) {
+        return;
+    }
+
+    if (instances->vk_descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device->vk_device, instances->vk_descriptor_pool, NULL);
+    }
+    if (instances->vk_set_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device->vk_device, instances->vk_set_layout, NULL);
+    }
+    if (instances->vk_buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device->vk_device, instances->vk_buffer, NULL);
+    }
+    memory_free(instances->memory, &instances->allocation);
+
+    memset(instances, 0, sizeof(*instances));
+}
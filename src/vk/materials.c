@@ -0,0 +1,164 @@
+#include "vk/materials.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static uint32_t materials_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static float materials_unit(uint32_t seed) {
+    return (float)(materials_hash(seed) & 0xffffffU) / (float)0x1000000U;
+}
+
+static void materials_fill(material_t *data, uint32_t count, uint32_t buffer, uint32_t draws) {
+    const float scale = fminf(1.0F, 3.0F / sqrtf((float)draws));
+
+    for (uint32_t e = 0; e < count; ++e) {
+        const uint32_t i = e * MATERIALS_BUFFER_COUNT + buffer;
+
+        data[e].transform[0] = draws > 1 ? materials_unit(4 * i + 0) * 2.0F - 1.0F : 0.0F;
+        data[e].transform[1] = draws > 1 ? materials_unit(4 * i + 1) * 2.0F - 1.0F : 0.0F;
+        data[e].transform[2] = scale;
+        data[e].transform[3] = materials_unit(4 * i + 3) * 6.2831853F;
+        data[e].color[0]     = materials_unit(i ^ 0x9e3779b9U);
+        data[e].color[1]     = materials_unit(i ^ 0x85ebca6bU);
+        data[e].color[2]     = materials_unit(i ^ 0xc2b2ae35U);
+        data[e].color[3]     = 1.0F;
+    }
+}
+
+static bool materials_create_buffer(
+    materials_t    *materials,
+    const device_t *device,
+    transfer_t     *transfer,
+    uint32_t        buffer,
+    uint32_t        count
+) {
+    const VkDeviceSize size = (VkDeviceSize)count * sizeof(material_t);
+
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size               = size;
+    buffer_create_info.usage
+        = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult res;
+    res = vkCreateBuffer(
+        device->vk_device, &buffer_create_info, NULL, &materials->vk_buffers[buffer]
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(MATERIALS) vkCreateBuffer failed (%s).", vk_res_str(res));
+        materials->vk_buffers[buffer] = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!memory_alloc_buffer(
+            materials->memory,
+            materials->vk_buffers[buffer],
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            0,
+            MEMORY_STRATEGY_BUDDY,
+            &materials->allocations[buffer]
+        )) {
+        log_error("(MATERIALS) failed to allocate buffer memory.");
+        return false;
+    }
+
+    material_t *data = malloc(size);
+    if (data == NULL) {
+        log_error("(MATERIALS) failed to allocate material data.");
+        return false;
+    }
+    materials_fill(data, count, buffer, materials->count);
+
+    bool ok = transfer_upload_buffer(
+        transfer,
+        materials->vk_buffers[buffer],
+        0,
+        data,
+        size,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT
+    );
+    free(data);
+    if (!ok) {
+        log_error("(MATERIALS) failed to upload material data.");
+        return false;
+    }
+
+    materials->handles[buffer] = bindless_register_buffer(
+        materials->bindless, materials->vk_buffers[buffer], 0, VK_WHOLE_SIZE
+    );
+
+    return materials->handles[buffer] != BINDLESS_INVALID_HANDLE;
+}
+
+bool materials_create(
+    materials_t    *materials,
+    const device_t *device,
+    memory_t       *memory,
+    transfer_t     *transfer,
+    bindless_t     *bindless,
+    uint32_t        count
+) {
+    assert(count > 0);
+
+    memset(materials, 0, sizeof(*materials));
+    materials->count    = count;
+    materials->memory   = memory;
+    materials->bindless = bindless;
+    for (uint32_t b = 0; b < MATERIALS_BUFFER_COUNT; ++b) {
+        materials->handles[b] = BINDLESS_INVALID_HANDLE;
+    }
+
+    for (uint32_t b = 0; b < MATERIALS_BUFFER_COUNT && b < count; ++b) {
+        const uint32_t elements = (count - b + MATERIALS_BUFFER_COUNT - 1) / MATERIALS_BUFFER_COUNT;
+        if (!materials_create_buffer(materials, device, transfer, b, elements)) {
+            materials_destroy(materials, device, 0);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The slots are held back from reuse while frames may still read them; the buffers themselves
+// must no longer be in use.
+void materials_destroy(materials_t *materials, const device_t *device, uint32_t frame_count) {
+    if (materials == NULL) {
+        return;
+    }
+
+    for (uint32_t b = 0; b < MATERIALS_BUFFER_COUNT; ++b) {
+        if (materials->bindless != NULL) {
+            bindless_release_buffer(materials->bindless, materials->handles[b], frame_count);
+        }
+        if (materials->vk_buffers[b] != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device->vk_device, materials->vk_buffers[b], NULL);
+        }
+        memory_free(materials->memory, &materials->allocations[b]);
+    }
+
+    memset(materials, 0, sizeof(*materials));
+}
+
+void materials_push(const materials_t *materials, uint32_t draw_index, bindless_push_t *push) {
+    const uint32_t buffer = draw_index % MATERIALS_BUFFER_COUNT;
+
+    push->handles[0] = materials->handles[buffer];
+    push->handles[1] = draw_index / MATERIALS_BUFFER_COUNT;
+    push->handles[2] = 0;
+    push->handles[3] = 0;
+}
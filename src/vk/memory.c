@@ -0,0 +1,625 @@
+#include "vk/memory.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+#define MEMORY_MIN_SIZE ((VkDeviceSize)256)
+
+static VkDeviceSize memory_align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+static VkDeviceSize memory_pow2_ceil(VkDeviceSize value) {
+    VkDeviceSize result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+static VkDeviceSize memory_pow2_floor(VkDeviceSize value) {
+    VkDeviceSize result = 1;
+    while (result <= value / 2) {
+        result <<= 1;
+    }
+    return result;
+}
+
+static uint32_t memory_log2(VkDeviceSize value) {
+    uint32_t result = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++result;
+    }
+    return result;
+}
+
+static bool memory_free_list_reserve(memory_free_list_t *list) {
+    if (list->count < list->capacity) {
+        return true;
+    }
+
+    uint32_t      capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+    VkDeviceSize *offsets
+        = (VkDeviceSize *)realloc(list->offsets, capacity * sizeof(*list->offsets));
+    if (offsets == NULL) {
+        log_error("(MEMORY) realloc failed.");
+        return false;
+    }
+    list->offsets  = offsets;
+    list->capacity = capacity;
+
+    return true;
+}
+
+static bool memory_free_list_push(memory_free_list_t *list, VkDeviceSize offset) {
+    if (!memory_free_list_reserve(list)) {
+        return false;
+    }
+
+    list->offsets[list->count++] = offset;
+    return true;
+}
+
+static bool memory_free_list_remove(memory_free_list_t *list, VkDeviceSize offset) {
+    for (uint32_t i = 0; i < list->count; ++i) {
+        if (list->offsets[i] == offset) {
+            list->offsets[i] = list->offsets[--list->count];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Small heaps (integrated GPUs, the 256 MiB BAR window) get smaller blocks so one block
+// cannot take a large share of the heap.
+static VkDeviceSize memory_block_size_for_type(const memory_t *memory, uint32_t type_index) {
+    const VkPhysicalDeviceMemoryProperties *properties = &memory->device->memory_properties;
+    const uint32_t     heap_index = properties->memoryTypes[type_index].heapIndex;
+    const VkDeviceSize heap_size  = properties->memoryHeaps[heap_index].size;
+
+    VkDeviceSize block_size = memory->block_size;
+    if (heap_size / 8 < block_size) {
+        block_size = memory_pow2_floor(heap_size / 8);
+    }
+
+    return block_size < memory->min_size ? memory->min_size : block_size;
+}
+
+static void memory_block_destroy(memory_t *memory, memory_block_t *block) {
+    if (block->mapped != NULL) {
+        vkUnmapMemory(memory->device->vk_device, block->vk_memory);
+    }
+    if (block->vk_memory != VK_NULL_HANDLE) {
+        vkFreeMemory(memory->device->vk_device, block->vk_memory, NULL);
+    }
+    for (uint32_t i = 0; i < MEMORY_MAX_ORDERS; ++i) {
+        free(block->free_lists[i].offsets);
+    }
+    free(block);
+}
+
+static memory_block_t *memory_block_create(
+    memory_t         *memory,
+    uint32_t          type_index,
+    VkDeviceSize      size,
+    memory_strategy_t strategy,
+    bool              dedicated
+) {
+    if (memory->max_vk_allocations > 0 && memory->blocks_count >= memory->max_vk_allocations) {
+        log_error("(MEMORY) maxMemoryAllocationCount (%u) reached.", memory->max_vk_allocations);
+        return NULL;
+    }
+
+    memory_block_t *block = (memory_block_t *)calloc(1, sizeof(*block));
+    if (block == NULL) {
+        log_error("(MEMORY) calloc failed.");
+        return NULL;
+    }
+
+    block->size              = size;
+    block->memory_type_index = type_index;
+    block->strategy          = strategy;
+    block->dedicated         = dedicated;
+
+    VkMemoryAllocateInfo memory_allocate_info = {0};
+    memory_allocate_info.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memory_allocate_info.allocationSize       = size;
+    memory_allocate_info.memoryTypeIndex      = type_index;
+
+    VkResult res;
+    res = vkAllocateMemory(
+        memory->device->vk_device, &memory_allocate_info, NULL, &block->vk_memory
+    );
+    if (res != VK_SUCCESS) {
+        // Out of memory is expected on a full heap, the caller tries the next memory type.
+        if (res != VK_ERROR_OUT_OF_DEVICE_MEMORY && res != VK_ERROR_OUT_OF_HOST_MEMORY) {
+            log_error("(MEMORY) vkAllocateMemory failed (%s).", vk_res_str(res));
+        }
+        block->vk_memory = VK_NULL_HANDLE;
+        memory_block_destroy(memory, block);
+        return NULL;
+    }
+    ++memory->vk_allocations;
+
+    const VkMemoryPropertyFlags flags
+        = memory->device->memory_properties.memoryTypes[type_index].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        res = vkMapMemory(memory->device->vk_device, block->vk_memory, 0, size, 0, &block->mapped);
+        if (res != VK_SUCCESS) {
+            log_error("(MEMORY) vkMapMemory failed (%s).", vk_res_str(res));
+            block->mapped = NULL;
+            memory_block_destroy(memory, block);
+            return NULL;
+        }
+    }
+
+    if (strategy == MEMORY_STRATEGY_BUDDY && !dedicated) {
+        block->max_order = memory_log2(size / memory->min_size);
+        if (!memory_free_list_push(&block->free_lists[block->max_order], 0)) {
+            memory_block_destroy(memory, block);
+            return NULL;
+        }
+    }
+
+    block->next           = memory->blocks;
+    memory->blocks        = block;
+    memory->blocks_count += 1;
+
+    return block;
+}
+
+static bool memory_block_alloc_buddy(
+    memory_t               *memory,
+    memory_block_t         *block,
+    const memory_request_t *request,
+    memory_allocation_t    *allocation
+) {
+    VkDeviceSize size = request->requirements.size;
+    if (size < request->requirements.alignment) {
+        size = request->requirements.alignment;
+    }
+    if (size < memory->min_size) {
+        size = memory->min_size;
+    }
+    size = memory_pow2_ceil(size);
+
+    // Buddies are aligned to their size and at least min_size, which is a multiple of
+    // bufferImageGranularity, so neighbours never share a granularity page.
+    const uint32_t order = memory_log2(size / memory->min_size);
+    if (order > block->max_order) {
+        return false;
+    }
+
+    uint32_t found = order;
+    while (found <= block->max_order && block->free_lists[found].count == 0) {
+        ++found;
+    }
+    if (found > block->max_order) {
+        return false;
+    }
+
+    // Room for the split-off halves first, so a failed realloc leaves the lists untouched.
+    for (uint32_t i = order; i < found; ++i) {
+        if (!memory_free_list_reserve(&block->free_lists[i])) {
+            return false;
+        }
+    }
+
+    memory_free_list_t *list   = &block->free_lists[found];
+    const VkDeviceSize  offset = list->offsets[--list->count];
+
+    while (found > order) {
+        --found;
+        memory_free_list_push(&block->free_lists[found], offset + (memory->min_size << found));
+    }
+
+    allocation->offset = offset;
+    allocation->size   = size;
+    allocation->order  = order;
+    return true;
+}
+
+static void memory_block_free_buddy(
+    memory_t                  *memory,
+    memory_block_t            *block,
+    const memory_allocation_t *allocation
+) {
+    VkDeviceSize offset = allocation->offset;
+    uint32_t     order  = allocation->order;
+
+    while (order < block->max_order) {
+        const VkDeviceSize buddy = offset ^ (memory->min_size << order);
+        if (!memory_free_list_remove(&block->free_lists[order], buddy)) {
+            break;
+        }
+        offset = offset < buddy ? offset : buddy;
+        ++order;
+    }
+
+    if (!memory_free_list_push(&block->free_lists[order], offset)) {
+        log_error("(MEMORY) range at %llu is lost.", (unsigned long long)offset);
+    }
+}
+
+static bool memory_block_alloc_linear(
+    memory_t               *memory,
+    memory_block_t         *block,
+    const memory_request_t *request,
+    memory_allocation_t    *allocation
+) {
+    VkDeviceSize offset = memory_align_up(block->top, request->requirements.alignment);
+    if (block->top > 0 && block->top_optimal != request->optimal_tiling) {
+        offset = memory_align_up(offset, memory->buffer_image_granularity);
+    }
+    if (offset + request->requirements.size > block->size) {
+        return false;
+    }
+
+    block->top         = offset + request->requirements.size;
+    block->top_optimal = request->optimal_tiling;
+
+    allocation->offset = offset;
+    allocation->size   = request->requirements.size;
+    allocation->order  = 0;
+    return true;
+}
+
+static bool memory_alloc_from_type(
+    memory_t               *memory,
+    uint32_t                type_index,
+    const memory_request_t *request,
+    memory_allocation_t    *allocation
+) {
+    const VkDeviceSize block_size = memory_block_size_for_type(memory, type_index);
+
+    memory_block_t *block = NULL;
+    if (request->requirements.size > block_size / 2) {
+        block = memory_block_create(
+            memory, type_index, request->requirements.size, request->strategy, true
+        );
+        if (block == NULL) {
+            return false;
+        }
+        allocation->offset = 0;
+        allocation->size   = request->requirements.size;
+        allocation->order  = 0;
+    } else {
+        for (block = memory->blocks; block != NULL; block = block->next) {
+            if (block->dedicated || block->memory_type_index != type_index
+                || block->strategy != request->strategy) {
+                continue;
+            }
+            bool ok = block->strategy == MEMORY_STRATEGY_BUDDY
+                        ? memory_block_alloc_buddy(memory, block, request, allocation)
+                        : memory_block_alloc_linear(memory, block, request, allocation);
+            if (ok) {
+                break;
+            }
+        }
+
+        if (block == NULL) {
+            block = memory_block_create(memory, type_index, block_size, request->strategy, false);
+            if (block == NULL) {
+                return false;
+            }
+            bool ok = block->strategy == MEMORY_STRATEGY_BUDDY
+                        ? memory_block_alloc_buddy(memory, block, request, allocation)
+                        : memory_block_alloc_linear(memory, block, request, allocation);
+            assert(ok);
+            (void)ok;
+        }
+    }
+
+    block->live_allocations += 1;
+    block->used             += allocation->size;
+
+    allocation->vk_memory = block->vk_memory;
+    allocation->block     = block;
+    allocation->mapped    = NULL;
+    if (block->mapped != NULL) {
+        allocation->mapped = (char *)block->mapped + allocation->offset;
+    }
+
+    ++memory->allocations;
+    return true;
+}
+
+static void memory_unlink_block(memory_t *memory, memory_block_t *block) {
+    for (memory_block_t **link = &memory->blocks; *link != NULL; link = &(*link)->next) {
+        if (*link == block) {
+            *link                 = block->next;
+            memory->blocks_count -= 1;
+            return;
+        }
+    }
+}
+
+// One empty block per memory type and strategy stays around to absorb alloc/free churn.
+static bool memory_should_release(const memory_t *memory, const memory_block_t *block) {
+    if (block->dedicated) {
+        return true;
+    }
+
+    for (const memory_block_t *other = memory->blocks; other != NULL; other = other->next) {
+        if (other != block && !other->dedicated
+            && other->memory_type_index == block->memory_type_index
+            && other->strategy == block->strategy) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool memory_create(memory_t *memory, const device_t *device, VkDeviceSize block_size) {
+    memset(memory, 0, sizeof(*memory));
+
+    memory->device = device;
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device->vk_physical_device, &device_properties);
+
+    memory->buffer_image_granularity = device_properties.limits.bufferImageGranularity;
+    memory->non_coherent_atom_size   = device_properties.limits.nonCoherentAtomSize;
+    memory->max_vk_allocations       = device_properties.limits.maxMemoryAllocationCount;
+
+    memory->min_size = memory_pow2_ceil(MEMORY_MIN_SIZE);
+    if (memory->min_size < memory->buffer_image_granularity) {
+        memory->min_size = memory_pow2_ceil(memory->buffer_image_granularity);
+    }
+
+    memory->block_size = memory_pow2_ceil(block_size > 0 ? block_size : MEMORY_DEFAULT_BLOCK_SIZE);
+    if (memory->block_size < memory->min_size) {
+        memory->block_size = memory->min_size;
+    }
+    while (memory_log2(memory->block_size / memory->min_size) >= MEMORY_MAX_ORDERS) {
+        memory->block_size >>= 1;
+    }
+
+    if (pthread_mutex_init(&memory->mutex, NULL) != 0) {
+        log_error("(MEMORY) pthread_mutex_init failed.");
+        return false;
+    }
+    memory->has_mutex = true;
+
+    return true;
+}
+
+void memory_destroy(memory_t *memory) {
+    if (memory == NULL || memory->device == NULL) {
+        return;
+    }
+
+    memory_block_t *block = memory->blocks;
+    while (block != NULL) {
+        memory_block_t *next = block->next;
+        if (block->live_allocations > 0) {
+            log_warn(
+                "(MEMORY) block destroyed with %u live allocations.", block->live_allocations
+            );
+        }
+        memory_block_destroy(memory, block);
+        block = next;
+    }
+
+    if (memory->has_mutex) {
+        pthread_mutex_destroy(&memory->mutex);
+    }
+
+    memset(memory, 0, sizeof(*memory));
+}
+
+bool memory_alloc(
+    memory_t               *memory,
+    const memory_request_t *request,
+    memory_allocation_t    *allocation
+) {
+    memset(allocation, 0, sizeof(*allocation));
+
+    const VkPhysicalDeviceMemoryProperties *properties = &memory->device->memory_properties;
+    const VkMemoryPropertyFlags             preferred
+        = request->required_flags | request->preferred_flags;
+
+    pthread_mutex_lock(&memory->mutex);
+
+    // Types with the preferred flags first, then those with only the required ones.
+    bool ok = false;
+    for (uint32_t pass = 0; pass < 2 && !ok; ++pass) {
+        const VkMemoryPropertyFlags flags = pass == 0 ? preferred : request->required_flags;
+        for (uint32_t i = 0; i < properties->memoryTypeCount && !ok; ++i) {
+            if ((request->requirements.memoryTypeBits & (1U << i)) == 0) {
+                continue;
+            }
+            const VkMemoryPropertyFlags type_flags = properties->memoryTypes[i].propertyFlags;
+            if ((type_flags & flags) != flags) {
+                continue;
+            }
+            if (pass == 1 && (type_flags & preferred) == preferred) {
+                continue;
+            }
+            ok = memory_alloc_from_type(memory, i, request, allocation);
+        }
+    }
+
+    pthread_mutex_unlock(&memory->mutex);
+
+    if (!ok) {
+        log_error(
+            "(MEMORY) no memory for %llu bytes (types 0x%x, flags 0x%x).",
+            (unsigned long long)request->requirements.size,
+            request->requirements.memoryTypeBits,
+            (unsigned)request->required_flags
+        );
+    }
+
+    return ok;
+}
+
+void memory_free(memory_t *memory, memory_allocation_t *allocation) {
+    if (allocation == NULL || allocation->block == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&memory->mutex);
+
+    memory_block_t *block = allocation->block;
+    assert(block->live_allocations > 0);
+
+    if (block->strategy == MEMORY_STRATEGY_BUDDY && !block->dedicated) {
+        memory_block_free_buddy(memory, block, allocation);
+    }
+
+    block->live_allocations -= 1;
+    block->used             -= allocation->size;
+    ++memory->frees;
+
+    if (block->live_allocations == 0) {
+        block->top         = 0;
+        block->top_optimal = false;
+        if (memory_should_release(memory, block)) {
+            memory_unlink_block(memory, block);
+            memory_block_destroy(memory, block);
+        }
+    }
+
+    pthread_mutex_unlock(&memory->mutex);
+
+    memset(allocation, 0, sizeof(*allocation));
+}
+
+bool memory_alloc_buffer(
+    memory_t             *memory,
+    VkBuffer              vk_buffer,
+    VkMemoryPropertyFlags required_flags,
+    VkMemoryPropertyFlags preferred_flags,
+    memory_strategy_t     strategy,
+    memory_allocation_t  *allocation
+) {
+    memory_request_t request = {0};
+    vkGetBufferMemoryRequirements(memory->device->vk_device, vk_buffer, &request.requirements);
+    request.required_flags  = required_flags;
+    request.preferred_flags = preferred_flags;
+    request.strategy        = strategy;
+    request.optimal_tiling  = false;
+
+    if (!memory_alloc(memory, &request, allocation)) {
+        return false;
+    }
+
+    VkResult res;
+    res = vkBindBufferMemory(
+        memory->device->vk_device, vk_buffer, allocation->vk_memory, allocation->offset
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(MEMORY) vkBindBufferMemory failed (%s).", vk_res_str(res));
+        memory_free(memory, allocation);
+        return false;
+    }
+
+    return true;
+}
+
+bool memory_alloc_image(
+    memory_t             *memory,
+    VkImage               vk_image,
+    VkImageTiling         tiling,
+    VkMemoryPropertyFlags required_flags,
+    memory_strategy_t     strategy,
+    memory_allocation_t  *allocation
+) {
+    memory_request_t request = {0};
+    vkGetImageMemoryRequirements(memory->device->vk_device, vk_image, &request.requirements);
+    request.required_flags = required_flags;
+    request.strategy       = strategy;
+    request.optimal_tiling = tiling == VK_IMAGE_TILING_OPTIMAL;
+
+    if (!memory_alloc(memory, &request, allocation)) {
+        return false;
+    }
+
+    VkResult res;
+    res = vkBindImageMemory(
+        memory->device->vk_device, vk_image, allocation->vk_memory, allocation->offset
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(MEMORY) vkBindImageMemory failed (%s).", vk_res_str(res));
+        memory_free(memory, allocation);
+        return false;
+    }
+
+    return true;
+}
+
+bool memory_is_coherent(const memory_t *memory, const memory_allocation_t *allocation) {
+    assert(allocation->block != NULL);
+
+    const uint32_t type_index = allocation->block->memory_type_index;
+    return (memory->device->memory_properties.memoryTypes[type_index].propertyFlags
+            & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        != 0;
+}
+
+void memory_get_stats(memory_t *memory, memory_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    VkDeviceSize free_bytes   = 0;
+    VkDeviceSize largest_free = 0;
+
+    pthread_mutex_lock(&memory->mutex);
+
+    for (const memory_block_t *block = memory->blocks; block != NULL; block = block->next) {
+        stats->block_count      += 1;
+        stats->dedicated_count  += block->dedicated ? 1 : 0;
+        stats->allocation_count += block->live_allocations;
+        stats->reserved_bytes   += block->size;
+        stats->used_bytes       += block->used;
+
+        if (block->strategy != MEMORY_STRATEGY_BUDDY || block->dedicated) {
+            continue;
+        }
+        for (uint32_t order = 0; order <= block->max_order; ++order) {
+            const VkDeviceSize size = memory->min_size << order;
+            free_bytes += size * block->free_lists[order].count;
+            if (block->free_lists[order].count > 0 && size > largest_free) {
+                largest_free = size;
+            }
+        }
+    }
+
+    stats->vk_allocations = memory->vk_allocations;
+    stats->allocations    = memory->allocations;
+    stats->frees          = memory->frees;
+
+    pthread_mutex_unlock(&memory->mutex);
+
+    if (free_bytes > 0) {
+        stats->fragmentation = 1.0F - (float)largest_free / (float)free_bytes;
+    }
+}
+
+void memory_log_stats(memory_t *memory) {
+    if (memory->device == NULL || memory->allocations == 0) {
+        return;
+    }
+
+    memory_stats_t stats;
+    memory_get_stats(memory, &stats);
+
+    log_debug(
+        "(MEMORY) %llu allocations from %llu vkAllocateMemory calls, %llu live in %u blocks "
+        "(%u dedicated), %.1f of %.1f MiB used, fragmentation %.2f.",
+        (unsigned long long)stats.allocations,
+        (unsigned long long)stats.vk_allocations,
+        (unsigned long long)stats.allocation_count,
+        stats.block_count,
+        stats.dedicated_count,
+        (double)stats.used_bytes / (1024.0 * 1024.0),
+        (double)stats.reserved_bytes / (1024.0 * 1024.0),
+        (double)stats.fragmentation
+    );
+}
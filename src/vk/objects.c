@@ -0,0 +1,531 @@
+#include "vk/objects.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/shader.h"
+#include "vk/debug.h"
+
+#define OBJECTS_BINDINGS 3
+
+// Push constant block Cull of shaders/objects_cull.comp.
+typedef struct {
+    uint32_t count;
+    uint32_t compact;
+} objects_cull_t;
+
+static uint32_t objects_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static float objects_unit(uint32_t seed) {
+    return (float)(objects_hash(seed) & 0xffffffU) / (float)0x1000000U;
+}
+
+// Radii shrink with the count so the world stays about equally covered.
+static void objects_fill(object_data_t *data, uint32_t count) {
+    const float scale = 3.0F * OBJECTS_WORLD_EXTENT / sqrtf((float)count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        data[i].bounds[0] = (objects_unit(4 * i + 0) * 2.0F - 1.0F) * OBJECTS_WORLD_EXTENT;
+        data[i].bounds[1] = (objects_unit(4 * i + 1) * 2.0F - 1.0F) * OBJECTS_WORLD_EXTENT;
+        data[i].bounds[2] = scale * (0.5F + objects_unit(4 * i + 2));
+        data[i].bounds[3] = objects_unit(4 * i + 3) * 6.2831853F;
+        data[i].color[0]  = objects_unit(i ^ 0x9e3779b9U);
+        data[i].color[1]  = objects_unit(i ^ 0x85ebca6bU);
+        data[i].color[2]  = objects_unit(i ^ 0xc2b2ae35U);
+        data[i].color[3]  = 1.0F;
+    }
+}
+
+static bool objects_create_buffer(
+    objects_t           *objects,
+    const device_t      *device,
+    VkDeviceSize         size,
+    VkBufferUsageFlags   usage,
+    VkBuffer            *vk_buffer,
+    memory_allocation_t *allocation
+) {
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size               = size;
+    buffer_create_info.usage              = usage;
+    buffer_create_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult res;
+    res = vkCreateBuffer(device->vk_device, &buffer_create_info, NULL, vk_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(OBJECTS) vkCreateBuffer failed (%s).", vk_res_str(res));
+        *vk_buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!memory_alloc_buffer(
+            objects->memory,
+            *vk_buffer,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            0,
+            MEMORY_STRATEGY_BUDDY,
+            allocation
+        )) {
+        log_error("(OBJECTS) failed to allocate buffer memory.");
+        return false;
+    }
+
+    return true;
+}
+
+static bool objects_create_buffers(objects_t *objects, const device_t *device) {
+    const VkBufferUsageFlags indirect_usage
+        = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+    return objects_create_buffer(
+               objects,
+               device,
+               (VkDeviceSize)objects->count * sizeof(object_data_t),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               &objects->vk_object_buffer,
+               &objects->object_allocation
+           )
+        && objects_create_buffer(
+               objects,
+               device,
+               (VkDeviceSize)objects->count * sizeof(VkDrawIndexedIndirectCommand),
+               indirect_usage,
+               &objects->vk_draw_buffer,
+               &objects->draw_allocation
+           )
+        && objects_create_buffer(
+               objects,
+               device,
+               sizeof(uint32_t),
+               indirect_usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               &objects->vk_count_buffer,
+               &objects->count_allocation
+           )
+        && objects_create_buffer(
+               objects,
+               device,
+               3 * sizeof(uint16_t),
+               VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               &objects->vk_index_buffer,
+               &objects->index_allocation
+           );
+}
+
+static bool objects_upload(objects_t *objects, transfer_t *transfer) {
+    const VkDeviceSize size = (VkDeviceSize)objects->count * sizeof(object_data_t);
+
+    object_data_t *data = malloc(size);
+    if (data == NULL) {
+        log_error("(OBJECTS) failed to allocate object data.");
+        return false;
+    }
+    objects_fill(data, objects->count);
+
+    // Every object is the same triangle; the index buffer only exists for the indexed draws.
+    static const uint16_t indices[3] = {0, 1, 2};
+
+    bool ok = transfer_upload_buffer(
+        transfer,
+        objects->vk_object_buffer,
+        0,
+        data,
+        size,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT
+    );
+    if (ok) {
+        ok = transfer_upload_buffer(
+            transfer,
+            objects->vk_index_buffer,
+            0,
+            indices,
+            sizeof(indices),
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+            VK_ACCESS_INDEX_READ_BIT
+        );
+    }
+    if (!ok) {
+        log_error("(OBJECTS) failed to upload object data.");
+    }
+
+    free(data);
+
+    return ok;
+}
+
+static bool objects_create_descriptors(objects_t *objects, const device_t *device) {
+    VkDescriptorSetLayoutBinding set_layout_bindings[OBJECTS_BINDINGS];
+    for (uint32_t i = 0; i < OBJECTS_BINDINGS; ++i) {
+        set_layout_bindings[i]                 = (VkDescriptorSetLayoutBinding){0};
+        set_layout_bindings[i].binding         = i;
+        set_layout_bindings[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        set_layout_bindings[i].descriptorCount = 1;
+        set_layout_bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    set_layout_bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info = {0};
+    set_layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_create_info.bindingCount = OBJECTS_BINDINGS;
+    set_layout_create_info.pBindings    = set_layout_bindings;
+
+    VkResult res;
+    res = vkCreateDescriptorSetLayout(
+        device->vk_device, &set_layout_create_info, NULL, &objects->vk_set_layout
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(OBJECTS) vkCreateDescriptorSetLayout failed (%s).", vk_res_str(res));
+        objects->vk_set_layout = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {0};
+    pool_size.type                 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount      = OBJECTS_BINDINGS;
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {0};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.maxSets       = 1;
+    descriptor_pool_create_info.poolSizeCount = 1;
+    descriptor_pool_create_info.pPoolSizes    = &pool_size;
+
+    res = vkCreateDescriptorPool(
+        device->vk_device, &descriptor_pool_create_info, NULL, &objects->vk_descriptor_pool
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(OBJECTS) vkCreateDescriptorPool failed (%s).", vk_res_str(res));
+        objects->vk_descriptor_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {0};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool     = objects->vk_descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts        = &objects->vk_set_layout;
+
+    res = vkAllocateDescriptorSets(
+        device->vk_device, &descriptor_set_allocate_info, &objects->vk_descriptor_set
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(OBJECTS) vkAllocateDescriptorSets failed (%s).", vk_res_str(res));
+        objects->vk_descriptor_set = VK_NULL_HANDLE;
+        return false;
+    }
+
+    const VkBuffer vk_buffers[OBJECTS_BINDINGS] = {
+        objects->vk_object_buffer,
+        objects->vk_draw_buffer,
+        objects->vk_count_buffer,
+    };
+
+    VkDescriptorBufferInfo descriptor_buffer_infos[OBJECTS_BINDINGS];
+    VkWriteDescriptorSet   write_descriptor_sets[OBJECTS_BINDINGS];
+    for (uint32_t i = 0; i < OBJECTS_BINDINGS; ++i) {
+        descriptor_buffer_infos[i]        = (VkDescriptorBufferInfo){0};
+        descriptor_buffer_infos[i].buffer = vk_buffers[i];
+        descriptor_buffer_infos[i].offset = 0;
+        descriptor_buffer_infos[i].range  = VK_WHOLE_SIZE;
+
+        write_descriptor_sets[i]                 = (VkWriteDescriptorSet){0};
+        write_descriptor_sets[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_descriptor_sets[i].dstSet          = objects->vk_descriptor_set;
+        write_descriptor_sets[i].dstBinding      = i;
+        write_descriptor_sets[i].descriptorCount = 1;
+        write_descriptor_sets[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write_descriptor_sets[i].pBufferInfo     = &descriptor_buffer_infos[i];
+    }
+
+    vkUpdateDescriptorSets(device->vk_device, OBJECTS_BINDINGS, write_descriptor_sets, 0, NULL);
+
+    return true;
+}
+
+static bool objects_create_pipeline(
+    objects_t            *objects,
+    const device_t       *device,
+    VkPipelineCache       vk_pipeline_cache,
+    VkDescriptorSetLayout vk_frame_set_layout,
+    compute_pipeline_t   *pipeline
+) {
+    const VkDescriptorSetLayout vk_set_layouts[2] = {objects->vk_set_layout, vk_frame_set_layout};
+
+    uint32_t    spv_size = 0;
+    const void *spv_data = shader_get_objects_cull_spv_data(&spv_size);
+
+    return compute_pipeline_create(
+        pipeline,
+        device,
+        vk_pipeline_cache,
+        spv_data,
+        spv_size,
+        vk_set_layouts,
+        2,
+        sizeof(objects_cull_t)
+    );
+}
+
+bool objects_create(
+    objects_t            *objects,
+    const device_t       *device,
+    memory_t             *memory,
+    transfer_t           *transfer,
+    VkPipelineCache       vk_pipeline_cache,
+    VkDescriptorSetLayout vk_frame_set_layout,
+    uint32_t              count
+) {
+    assert(count > 0);
+
+    memset(objects, 0, sizeof(*objects));
+    objects->count   = count;
+    objects->memory  = memory;
+    objects->compact = device->has_draw_indirect_count;
+
+    if (!device->has_multi_draw_indirect) {
+        log_error("(OBJECTS) multiDrawIndirect and drawIndirectFirstInstance are required.");
+        return false;
+    }
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device->vk_physical_device, &device_properties);
+
+    const VkPhysicalDeviceLimits *limits = &device_properties.limits;
+    const VkDeviceSize            size   = (VkDeviceSize)count * sizeof(object_data_t);
+    const uint32_t groups = (count + OBJECTS_GROUP_SIZE - 1) / OBJECTS_GROUP_SIZE;
+    if (size > limits->maxStorageBufferRange || count > limits->maxDrawIndirectCount
+        || groups > limits->maxComputeWorkGroupCount[0]) {
+        log_error(
+            "(OBJECTS) %u objects exceed the storage buffer range (%u), the indirect draw count "
+            "(%u) or the workgroup count (%u).",
+            count,
+            limits->maxStorageBufferRange,
+            limits->maxDrawIndirectCount,
+            limits->maxComputeWorkGroupCount[0]
+        );
+        return false;
+    }
+
+    if (!objects_create_buffers(objects, device) || !objects_upload(objects, transfer)
+        || !objects_create_descriptors(objects, device)
+        || !objects_create_pipeline(
+            objects, device, vk_pipeline_cache, vk_frame_set_layout, &objects->pipeline
+        )) {
+        objects_destroy(objects, device);
+        return false;
+    }
+
+    log_debug(
+        "(OBJECTS) %u objects, %s.",
+        count,
+        objects->compact ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirect"
+    );
+
+    return true;
+}
+
+void objects_destroy(objects_t *objects, const device_t *device) {
+    if (objects == NULL) {
+        return;
+    }
+
+    compute_pipeline_destroy(&objects->rebuilt_pipeline, device);
+    compute_pipeline_destroy(&objects->pipeline, device);
+    if (objects->vk_descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device->vk_device, objects->vk_descriptor_pool, NULL);
+    }
+    if (objects->vk_set_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device->vk_device, objects->vk_set_layout, NULL);
+    }
+
+    VkBuffer *vk_buffers[4] = {
+        &objects->vk_object_buffer,
+        &objects->vk_draw_buffer,
+        &objects->vk_count_buffer,
+        &objects->vk_index_buffer,
+    };
+    memory_allocation_t *allocations[4] = {
+        &objects->object_allocation,
+        &objects->draw_allocation,
+        &objects->count_allocation,
+        &objects->index_allocation,
+    };
+    for (uint32_t i = 0; i < 4; ++i) {
+        if (*vk_buffers[i] != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device->vk_device, *vk_buffers[i], NULL);
+        }
+        memory_free(objects->memory, allocations[i]);
+    }
+
+    memset(objects, 0, sizeof(*objects));
+}
+
+bool objects_rebuild_pipeline(
+    objects_t            *objects,
+    const device_t       *device,
+    VkPipelineCache       vk_pipeline_cache,
+    VkDescriptorSetLayout vk_frame_set_layout
+) {
+    compute_pipeline_destroy(&objects->rebuilt_pipeline, device);
+
+    return objects_create_pipeline(
+        objects, device, vk_pipeline_cache, vk_frame_set_layout, &objects->rebuilt_pipeline
+    );
+}
+
+bool objects_swap_pipeline(objects_t *objects, const device_t *device) {
+    if (objects->rebuilt_pipeline.vk_pipeline == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    compute_pipeline_destroy(&objects->pipeline, device);
+    objects->pipeline = objects->rebuilt_pipeline;
+    memset(&objects->rebuilt_pipeline, 0, sizeof(objects->rebuilt_pipeline));
+
+    return true;
+}
+
+static void objects_memory_barrier(
+    VkCommandBuffer      command_buffer,
+    VkPipelineStageFlags src_stage,
+    VkAccessFlags        src_access,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+) {
+    VkMemoryBarrier memory_barrier = {0};
+    memory_barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask   = src_access;
+    memory_barrier.dstAccessMask   = dst_access;
+
+    vkCmdPipelineBarrier(
+        command_buffer, src_stage, dst_stage, 0, 1, &memory_barrier, 0, NULL, 0, NULL
+    );
+}
+
+void objects_cmd_cull(
+    const objects_t     *objects,
+    VkCommandBuffer      command_buffer,
+    const upload_ring_t *upload_ring,
+    uint32_t             frame_offset
+) {
+    // The previous frame's indirect reads must finish before the commands are rewritten.
+    objects_memory_barrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0
+    );
+
+    if (objects->compact) {
+        vkCmdFillBuffer(command_buffer, objects->vk_count_buffer, 0, sizeof(uint32_t), 0);
+        objects_memory_barrier(
+            command_buffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        );
+    }
+
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, objects->pipeline.vk_pipeline
+    );
+
+    const VkDescriptorSet vk_descriptor_sets[2] = {
+        objects->vk_descriptor_set,
+        upload_ring->vk_descriptor_set,
+    };
+    const uint32_t dynamic_offsets[2] = {frame_offset, frame_offset};
+
+    vkCmdBindDescriptorSets(
+        command_buffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        objects->pipeline.vk_pipeline_layout,
+        0,
+        2,
+        vk_descriptor_sets,
+        2,
+        dynamic_offsets
+    );
+
+    objects_cull_t cull = {0};
+    cull.count          = objects->count;
+    cull.compact        = objects->compact ? 1 : 0;
+
+    vkCmdPushConstants(
+        command_buffer,
+        objects->pipeline.vk_pipeline_layout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(cull),
+        &cull
+    );
+    vkCmdDispatch(
+        command_buffer, (objects->count + OBJECTS_GROUP_SIZE - 1) / OBJECTS_GROUP_SIZE, 1, 1
+    );
+
+    objects_memory_barrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+    );
+}
+
+// The view covers a quarter of the world's width and circles around its center.
+void objects_write_frame_view(float view[4], float planes[4][4], double seconds) {
+    const float half  = OBJECTS_WORLD_EXTENT * 0.25F;
+    const float orbit = OBJECTS_WORLD_EXTENT * 0.5F;
+    const float x     = orbit * (float)cos(seconds * 0.1);
+    const float y     = orbit * (float)sin(seconds * 0.1);
+
+    view[0] = x;
+    view[1] = y;
+    view[2] = 1.0F / half;
+    view[3] = 1.0F / half;
+
+    // A point p is inside when dot(normal, p) + distance >= 0.
+    const float view_planes[4][4] = {
+        {1.0F,  0.0F,  0.0F, half - x},
+        {-1.0F, 0.0F,  0.0F, half + x},
+        {0.0F,  1.0F,  0.0F, half - y},
+        {0.0F,  -1.0F, 0.0F, half + y},
+    };
+    memcpy(planes, view_planes, sizeof(view_planes));
+}
+
+void objects_cmd_draw(const objects_t *objects, VkCommandBuffer command_buffer) {
+    vkCmdBindIndexBuffer(command_buffer, objects->vk_index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+    if (objects->compact) {
+        vkCmdDrawIndexedIndirectCount(
+            command_buffer,
+            objects->vk_draw_buffer,
+            0,
+            objects->vk_count_buffer,
+            0,
+            objects->count,
+            sizeof(VkDrawIndexedIndirectCommand)
+        );
+        return;
+    }
+
+    vkCmdDrawIndexedIndirect(
+        command_buffer,
+        objects->vk_draw_buffer,
+        0,
+        objects->count,
+        sizeof(VkDrawIndexedIndirectCommand)
+    );
+}
@@ -0,0 +1,152 @@
+#include "vk/offscreen.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static const VkFormat offscreen_candidate_formats[]
+    = {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM};
+static const size_t offscreen_candidate_formats_count
+    = sizeof(offscreen_candidate_formats) / sizeof(offscreen_candidate_formats[0]);
+
+static VkFormat offscreen_choose_format(const device_t *device) {
+    for (size_t i = 0; i < offscreen_candidate_formats_count; ++i) {
+        VkFormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(
+            device->vk_physical_device, offscreen_candidate_formats[i], &format_properties
+        );
+        if (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) {
+            return offscreen_candidate_formats[i];
+        }
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+static bool offscreen_create_image(offscreen_t *offscreen, const device_t *device, uint32_t index) {
+    VkImageCreateInfo image_create_info = {0};
+    image_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_create_info.imageType         = VK_IMAGE_TYPE_2D;
+    image_create_info.format            = offscreen->vk_image_format;
+    image_create_info.extent.width      = offscreen->extent.width;
+    image_create_info.extent.height     = offscreen->extent.height;
+    image_create_info.extent.depth      = 1;
+    image_create_info.mipLevels         = 1;
+    image_create_info.arrayLayers       = 1;
+    image_create_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+    image_create_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+    image_create_info.usage
+        = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    image_create_info.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+    image_create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkResult res;
+    res = vkCreateImage(device->vk_device, &image_create_info, NULL, &offscreen->vk_images[index]);
+    if (res != VK_SUCCESS) {
+        log_error("(OFFSCREEN) vkCreateImage failed (%s).", vk_res_str(res));
+        offscreen->vk_images[index] = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!memory_alloc_image(
+            offscreen->memory,
+            offscreen->vk_images[index],
+            image_create_info.tiling,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            MEMORY_STRATEGY_BUDDY,
+            &offscreen->allocations[index]
+        )) {
+        log_error("(OFFSCREEN) failed to allocate image memory.");
+        return false;
+    }
+
+    VkImageViewCreateInfo image_view_create_info = {0};
+    image_view_create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    image_view_create_info.image                 = offscreen->vk_images[index];
+    image_view_create_info.viewType              = VK_IMAGE_VIEW_TYPE_2D;
+    image_view_create_info.format                = offscreen->vk_image_format;
+    image_view_create_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    image_view_create_info.subresourceRange.baseMipLevel   = 0;
+    image_view_create_info.subresourceRange.levelCount     = 1;
+    image_view_create_info.subresourceRange.baseArrayLayer = 0;
+    image_view_create_info.subresourceRange.layerCount     = 1;
+
+    res = vkCreateImageView(
+        device->vk_device, &image_view_create_info, NULL, &offscreen->vk_image_views[index]
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(OFFSCREEN) vkCreateImageView failed (%s).", vk_res_str(res));
+        offscreen->vk_image_views[index] = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+bool offscreen_create(
+    offscreen_t    *offscreen,
+    const device_t *device,
+    memory_t       *memory,
+    VkExtent2D      extent,
+    uint32_t        image_count
+) {
+    memset(offscreen, 0, sizeof(*offscreen));
+
+    assert(image_count > 0);
+
+    offscreen->vk_image_format = offscreen_choose_format(device);
+    if (offscreen->vk_image_format == VK_FORMAT_UNDEFINED) {
+        log_error("(OFFSCREEN) no color attachment format found.");
+        return false;
+    }
+
+    offscreen->extent = extent;
+    offscreen->memory = memory;
+
+    offscreen->vk_images = (VkImage *)calloc(image_count, sizeof(*offscreen->vk_images));
+    offscreen->allocations
+        = (memory_allocation_t *)calloc(image_count, sizeof(*offscreen->allocations));
+    offscreen->vk_image_views
+        = (VkImageView *)calloc(image_count, sizeof(*offscreen->vk_image_views));
+    if (offscreen->vk_images == NULL || offscreen->allocations == NULL
+        || offscreen->vk_image_views == NULL) {
+        log_error("(OFFSCREEN) calloc failed.");
+        offscreen_destroy(offscreen, device);
+        return false;
+    }
+    offscreen->vk_image_count = image_count;
+
+    for (uint32_t i = 0; i < image_count; ++i) {
+        if (!offscreen_create_image(offscreen, device, i)) {
+            offscreen_destroy(offscreen, device);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void offscreen_destroy(offscreen_t *offscreen, const device_t *device) {
+    if (offscreen == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < offscreen->vk_image_count; ++i) {
+        if (offscreen->vk_image_views[i] != VK_NULL_HANDLE) {
+            vkDestroyImageView(device->vk_device, offscreen->vk_image_views[i], NULL);
+        }
+        if (offscreen->vk_images[i] != VK_NULL_HANDLE) {
+            vkDestroyImage(device->vk_device, offscreen->vk_images[i], NULL);
+        }
+        memory_free(offscreen->memory, &offscreen->allocations[i]);
+    }
+
+    free(offscreen->vk_image_views);
+    free(offscreen->allocations);
+    free(offscreen->vk_images);
+
+    memset(offscreen, 0, sizeof(*offscreen));
+}
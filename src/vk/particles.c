@@ -0,0 +1,481 @@
+#include "vk/particles.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/shader.h"
+#include "vk/debug.h"
+
+// Push constant block Step of shaders/particles.comp.
+typedef struct {
+    float    dt;
+    uint32_t count;
+} particles_step_t;
+
+static uint32_t particles_hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static float particles_unit(uint32_t seed) {
+    return (float)(particles_hash(seed) & 0xffffffU) / (float)0x1000000U;
+}
+
+// A disc of particles on near-circular orbits around the attractor in the shader.
+static void particles_fill(particle_t *data, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const float radius = 0.2F + 0.7F * sqrtf(particles_unit(2 * i + 0));
+        const float angle  = particles_unit(2 * i + 1) * 6.2831853F;
+        const float r2     = radius * radius + 0.01F;
+        const float speed  = sqrtf(0.5F * radius * radius / (r2 * sqrtf(r2)));
+
+        data[i].position[0] = radius * cosf(angle);
+        data[i].position[1] = radius * sinf(angle);
+        data[i].velocity[0] = -speed * sinf(angle);
+        data[i].velocity[1] = speed * cosf(angle);
+    }
+}
+
+// With several buffers the compute queue writes them while the graphics queue reads the other
+// one, so they are shared by both families, and by the transfer family for the upload.
+static bool particles_create_buffer(
+    particles_t    *particles,
+    const device_t *device,
+    VkDeviceSize    size,
+    uint32_t        index
+) {
+    uint32_t families[3]    = {device->graphics_queue_familiy_index, 0, 0};
+    uint32_t families_count = 1;
+    if (device->compute_queue_family_index != device->graphics_queue_familiy_index) {
+        families[families_count++] = device->compute_queue_family_index;
+    }
+    if (device->transfer_queue_family_index != device->graphics_queue_familiy_index
+        && device->transfer_queue_family_index != device->compute_queue_family_index) {
+        families[families_count++] = device->transfer_queue_family_index;
+    }
+
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size               = size;
+    buffer_create_info.usage
+        = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (particles->buffer_count > 1 && families_count > 1) {
+        buffer_create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+        buffer_create_info.queueFamilyIndexCount = families_count;
+        buffer_create_info.pQueueFamilyIndices   = families;
+    }
+
+    VkResult res;
+    res = vkCreateBuffer(
+        device->vk_device, &buffer_create_info, NULL, &particles->vk_buffers[index]
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PARTICLES) vkCreateBuffer failed (%s).", vk_res_str(res));
+        particles->vk_buffers[index] = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!memory_alloc_buffer(
+            particles->memory,
+            particles->vk_buffers[index],
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            0,
+            MEMORY_STRATEGY_BUDDY,
+            &particles->allocations[index]
+        )) {
+        log_error("(PARTICLES) failed to allocate buffer memory.");
+        return false;
+    }
+
+    return true;
+}
+
+static bool particles_upload(particles_t *particles, transfer_t *transfer, VkDeviceSize size) {
+    particle_t *data = malloc(size);
+    if (data == NULL) {
+        log_error("(PARTICLES) failed to allocate particle data.");
+        return false;
+    }
+    particles_fill(data, particles->count);
+
+    // The first step reads buffer 0. With several buffers it runs on the compute queue, which
+    // transfer_t does not order after the upload, so the upload is waited for here.
+    bool ok;
+    if (particles->buffer_count > 1) {
+        ok = transfer_upload_concurrent_buffer(
+            transfer,
+            particles->vk_buffers[0],
+            0,
+            data,
+            size,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT
+        );
+        ok = ok && transfer_wait_all(transfer);
+    } else {
+        ok = transfer_upload_buffer(
+            transfer,
+            particles->vk_buffers[0],
+            0,
+            data,
+            size,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        );
+    }
+    if (!ok) {
+        log_error("(PARTICLES) failed to upload particle data.");
+    }
+
+    free(data);
+
+    return ok;
+}
+
+static bool particles_create_descriptors(particles_t *particles, const device_t *device) {
+    VkDescriptorSetLayoutBinding set_layout_bindings[2] = {0};
+    set_layout_bindings[0].binding                      = 0;
+    set_layout_bindings[0].descriptorType               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    set_layout_bindings[0].descriptorCount              = 1;
+    set_layout_bindings[0].stageFlags
+        = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    set_layout_bindings[1].binding         = 1;
+    set_layout_bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    set_layout_bindings[1].descriptorCount = 1;
+    set_layout_bindings[1].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info = {0};
+    set_layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_create_info.bindingCount = 2;
+    set_layout_create_info.pBindings    = set_layout_bindings;
+
+    VkResult res;
+    res = vkCreateDescriptorSetLayout(
+        device->vk_device, &set_layout_create_info, NULL, &particles->vk_set_layout
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PARTICLES) vkCreateDescriptorSetLayout failed (%s).", vk_res_str(res));
+        particles->vk_set_layout = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_size = {0};
+    pool_size.type                 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    pool_size.descriptorCount      = 2 * particles->buffer_count;
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {0};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.maxSets       = particles->buffer_count;
+    descriptor_pool_create_info.poolSizeCount = 1;
+    descriptor_pool_create_info.pPoolSizes    = &pool_size;
+
+    res = vkCreateDescriptorPool(
+        device->vk_device, &descriptor_pool_create_info, NULL, &particles->vk_descriptor_pool
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PARTICLES) vkCreateDescriptorPool failed (%s).", vk_res_str(res));
+        particles->vk_descriptor_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorSetLayout vk_set_layouts[PARTICLES_MAX_BUFFERS];
+    for (uint32_t i = 0; i < particles->buffer_count; ++i) {
+        vk_set_layouts[i] = particles->vk_set_layout;
+    }
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {0};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool     = particles->vk_descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = particles->buffer_count;
+    descriptor_set_allocate_info.pSetLayouts        = vk_set_layouts;
+
+    res = vkAllocateDescriptorSets(
+        device->vk_device, &descriptor_set_allocate_info, particles->vk_descriptor_sets
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PARTICLES) vkAllocateDescriptorSets failed (%s).", vk_res_str(res));
+        memset(particles->vk_descriptor_sets, 0, sizeof(particles->vk_descriptor_sets));
+        return false;
+    }
+
+    // With a single buffer both bindings name it and the step runs in place.
+    VkDescriptorBufferInfo descriptor_buffer_infos[2 * PARTICLES_MAX_BUFFERS];
+    VkWriteDescriptorSet   write_descriptor_sets[2 * PARTICLES_MAX_BUFFERS];
+    memset(descriptor_buffer_infos, 0, sizeof(descriptor_buffer_infos));
+    memset(write_descriptor_sets, 0, sizeof(write_descriptor_sets));
+
+    for (uint32_t i = 0; i < 2 * particles->buffer_count; ++i) {
+        const uint32_t set     = i / 2;
+        const uint32_t binding = i % 2;
+
+        descriptor_buffer_infos[i].buffer
+            = particles->vk_buffers[(set + binding) % particles->buffer_count];
+        descriptor_buffer_infos[i].offset = 0;
+        descriptor_buffer_infos[i].range  = VK_WHOLE_SIZE;
+
+        write_descriptor_sets[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_descriptor_sets[i].dstSet          = particles->vk_descriptor_sets[set];
+        write_descriptor_sets[i].dstBinding      = binding;
+        write_descriptor_sets[i].descriptorCount = 1;
+        write_descriptor_sets[i].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write_descriptor_sets[i].pBufferInfo     = &descriptor_buffer_infos[i];
+    }
+
+    vkUpdateDescriptorSets(
+        device->vk_device, 2 * particles->buffer_count, write_descriptor_sets, 0, NULL
+    );
+
+    return true;
+}
+
+static bool particles_create_pipeline(
+    particles_t        *particles,
+    const device_t     *device,
+    VkPipelineCache     vk_pipeline_cache,
+    compute_pipeline_t *pipeline
+) {
+    uint32_t    spv_size = 0;
+    const void *spv_data = shader_get_particles_compute_spv_data(&spv_size);
+
+    return compute_pipeline_create(
+        pipeline,
+        device,
+        vk_pipeline_cache,
+        spv_data,
+        spv_size,
+        &particles->vk_set_layout,
+        1,
+        sizeof(particles_step_t)
+    );
+}
+
+bool particles_create(
+    particles_t    *particles,
+    const device_t *device,
+    memory_t       *memory,
+    transfer_t     *transfer,
+    VkPipelineCache vk_pipeline_cache,
+    uint32_t        count
+) {
+    assert(count > 0);
+
+    memset(particles, 0, sizeof(*particles));
+    particles->count        = count;
+    particles->memory       = memory;
+    particles->buffer_count = device->has_compute_queue ? PARTICLES_MAX_BUFFERS : 1;
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device->vk_physical_device, &device_properties);
+
+    const VkDeviceSize size   = (VkDeviceSize)count * sizeof(particle_t);
+    const uint32_t     groups = (count + PARTICLES_GROUP_SIZE - 1) / PARTICLES_GROUP_SIZE;
+    if (size > device_properties.limits.maxStorageBufferRange) {
+        log_error(
+            "(PARTICLES) %u particles need %llu bytes, the storage buffer range is %u.",
+            count,
+            (unsigned long long)size,
+            device_properties.limits.maxStorageBufferRange
+        );
+        return false;
+    }
+    if (groups > device_properties.limits.maxComputeWorkGroupCount[0]) {
+        log_error(
+            "(PARTICLES) %u particles need %u workgroups, the limit is %u.",
+            count,
+            groups,
+            device_properties.limits.maxComputeWorkGroupCount[0]
+        );
+        return false;
+    }
+
+    bool ok = true;
+    for (uint32_t i = 0; i < particles->buffer_count && ok; ++i) {
+        ok = particles_create_buffer(particles, device, size, i);
+    }
+
+    if (!ok || !particles_upload(particles, transfer, size)
+        || !particles_create_descriptors(particles, device)
+        || !particles_create_pipeline(
+            particles, device, vk_pipeline_cache, &particles->pipeline
+        )) {
+        particles_destroy(particles, device);
+        return false;
+    }
+
+    return true;
+}
+
+void particles_destroy(particles_t *particles, const device_t *device) {
+    if (particles == NULL) {
+        return;
+    }
+
+    compute_pipeline_destroy(&particles->rebuilt_pipeline, device);
+    compute_pipeline_destroy(&particles->pipeline, device);
+    if (particles->vk_descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device->vk_device, particles->vk_descriptor_pool, NULL);
+    }
+    if (particles->vk_set_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device->vk_device, particles->vk_set_layout, NULL);
+    }
+    for (uint32_t i = 0; i < particles->buffer_count; ++i) {
+        if (particles->vk_buffers[i] != VK_NULL_HANDLE) {
+            vkDestroyBuffer(device->vk_device, particles->vk_buffers[i], NULL);
+        }
+        memory_free(particles->memory, &particles->allocations[i]);
+    }
+
+    memset(particles, 0, sizeof(*particles));
+}
+
+bool particles_rebuild_pipeline(
+    particles_t    *particles,
+    const device_t *device,
+    VkPipelineCache vk_pipeline_cache
+) {
+    compute_pipeline_destroy(&particles->rebuilt_pipeline, device);
+
+    return particles_create_pipeline(
+        particles, device, vk_pipeline_cache, &particles->rebuilt_pipeline
+    );
+}
+
+bool particles_swap_pipeline(particles_t *particles, const device_t *device) {
+    if (particles->rebuilt_pipeline.vk_pipeline == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    compute_pipeline_destroy(&particles->pipeline, device);
+    particles->pipeline = particles->rebuilt_pipeline;
+    memset(&particles->rebuilt_pipeline, 0, sizeof(particles->rebuilt_pipeline));
+
+    return true;
+}
+
+static void particles_cmd_dispatch(
+    const particles_t *particles,
+    VkCommandBuffer    command_buffer,
+    uint32_t           set
+) {
+    vkCmdBindPipeline(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, particles->pipeline.vk_pipeline
+    );
+    vkCmdBindDescriptorSets(
+        command_buffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        particles->pipeline.vk_pipeline_layout,
+        0,
+        1,
+        &particles->vk_descriptor_sets[set],
+        0,
+        NULL
+    );
+
+    particles_step_t step = {0};
+    step.dt               = PARTICLES_STEP_SECONDS;
+    step.count            = particles->count;
+
+    vkCmdPushConstants(
+        command_buffer,
+        particles->pipeline.vk_pipeline_layout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(step),
+        &step
+    );
+    vkCmdDispatch(
+        command_buffer, (particles->count + PARTICLES_GROUP_SIZE - 1) / PARTICLES_GROUP_SIZE, 1, 1
+    );
+}
+
+bool particles_create_compute(
+    const particles_t *particles,
+    compute_t         *compute,
+    const device_t    *device,
+    uint32_t           frame_count
+) {
+    assert(particles->buffer_count == PARTICLES_MAX_BUFFERS);
+
+    return compute_create(
+        compute,
+        device,
+        frame_count,
+        particles->buffer_count,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+    );
+}
+
+void particles_cmd_update(const particles_t *particles, VkCommandBuffer command_buffer) {
+    assert(particles->buffer_count == 1);
+
+    // The previous step's writes are read here, and the previous frame's vertex reads must be
+    // done before they are overwritten.
+    VkMemoryBarrier memory_barrier = {0};
+    memory_barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    memory_barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &memory_barrier,
+        0,
+        NULL,
+        0,
+        NULL
+    );
+
+    particles_cmd_dispatch(particles, command_buffer, 0);
+
+    VkBufferMemoryBarrier buffer_memory_barrier = {0};
+    buffer_memory_barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_memory_barrier.srcAccessMask         = VK_ACCESS_SHADER_WRITE_BIT;
+    buffer_memory_barrier.dstAccessMask         = VK_ACCESS_SHADER_READ_BIT;
+    buffer_memory_barrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+    buffer_memory_barrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+    buffer_memory_barrier.buffer                = particles->vk_buffers[0];
+    buffer_memory_barrier.offset                = 0;
+    buffer_memory_barrier.size                  = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+        command_buffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0,
+        0,
+        NULL,
+        1,
+        &buffer_memory_barrier,
+        0,
+        NULL
+    );
+}
+
+// The step reads the buffer the previous frame draws and writes the one the frame before drew;
+// compute_t orders it after that frame's vertex reads and before this frame's.
+bool particles_submit_update(
+    const particles_t *particles,
+    compute_t         *compute,
+    uint32_t           frame_index
+) {
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if (!compute_begin(compute, frame_index, &command_buffer)) {
+        return false;
+    }
+
+    particles_cmd_dispatch(particles, command_buffer, compute->target);
+
+    return compute_submit(compute, frame_index);
+}
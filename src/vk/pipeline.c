@@ -7,6 +7,7 @@
 
 #include "util/log.h"
 #include "util/shader.h"
+#include "vk/bindless.h"
 #include "vk/debug.h"
 
 static VkShaderModule
@@ -28,12 +29,46 @@ pipeline_create_shader_module(VkDevice vk_device, const void *code, size_t size)
     return mod;
 }
 
-bool pipeline_create(pipeline_t *pipeline, const device_t *device, const renderpass_t *renderpass) {
+static shader_id_t pipeline_variant_vertex_shader(pipeline_variant_t variant) {
+    switch (variant) {
+    case PIPELINE_VARIANT_INSTANCED:
+        return SHADER_INSTANCED_VERTEX;
+    case PIPELINE_VARIANT_PARTICLES:
+        return SHADER_PARTICLES_VERTEX;
+    case PIPELINE_VARIANT_OBJECTS:
+        return SHADER_OBJECTS_VERTEX;
+    case PIPELINE_VARIANT_BINDLESS:
+        return SHADER_BINDLESS_VERTEX;
+    default:
+        return SHADER_VERTEX;
+    }
+}
+
+uint32_t pipeline_variant_shaders(pipeline_variant_t variant) {
+    return SHADER_BIT(pipeline_variant_vertex_shader(variant)) | SHADER_BIT(SHADER_FRAGMENT);
+}
+
+bool pipeline_create(
+    pipeline_t                  *pipeline,
+    const device_t              *device,
+    const renderpass_t          *renderpass,
+    VkPipelineCache              vk_pipeline_cache,
+    pipeline_variant_t           variant,
+    const VkDescriptorSetLayout *vk_set_layouts,
+    uint32_t                     vk_set_layouts_count
+) {
     memset(pipeline, 0, sizeof(*pipeline));
 
-    uint32_t       vertex_shader_spv_size = 0;
-    const void    *vertex_shader_spv_data = shader_get_vertex_spv_data(&vertex_shader_spv_size);
-    VkShaderModule vertex_shader_module   = pipeline_create_shader_module(
+    uint32_t    vertex_shader_spv_size = 0;
+    const void *vertex_shader_spv_data
+        = shader_get_spv_data(pipeline_variant_vertex_shader(variant), &vertex_shader_spv_size);
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    if (variant == PIPELINE_VARIANT_PARTICLES) {
+        topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    }
+
+    VkShaderModule vertex_shader_module = pipeline_create_shader_module(
         device->vk_device, vertex_shader_spv_data, vertex_shader_spv_size
     );
     if (vertex_shader_module == VK_NULL_HANDLE) {
@@ -71,7 +106,7 @@ bool pipeline_create(pipeline_t *pipeline, const device_t *device, const renderp
     VkPipelineInputAssemblyStateCreateInfo input_assembly_state_create_info = {0};
     input_assembly_state_create_info.sType
         = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_assembly_state_create_info.topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_state_create_info.topology               = topology;
     input_assembly_state_create_info.primitiveRestartEnable = VK_FALSE;
 
     VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
@@ -116,6 +151,18 @@ bool pipeline_create(pipeline_t *pipeline, const device_t *device, const renderp
 
     VkPipelineLayoutCreateInfo pipeline_layout_create_info = {0};
     pipeline_layout_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipeline_layout_create_info.setLayoutCount = vk_set_layouts_count;
+    pipeline_layout_create_info.pSetLayouts    = vk_set_layouts;
+
+    // Bindless draws pass their handles as push constants.
+    VkPushConstantRange push_constant_range = {0};
+    push_constant_range.stageFlags          = BINDLESS_STAGES;
+    push_constant_range.offset              = 0;
+    push_constant_range.size                = sizeof(bindless_push_t);
+    if (variant == PIPELINE_VARIANT_BINDLESS) {
+        pipeline_layout_create_info.pushConstantRangeCount = 1;
+        pipeline_layout_create_info.pPushConstantRanges    = &push_constant_range;
+    }
 
     VkResult res;
     res = vkCreatePipelineLayout(
@@ -129,6 +176,12 @@ bool pipeline_create(pipeline_t *pipeline, const device_t *device, const renderp
         return false;
     }
 
+    // With dynamic rendering the pipeline depends on the attachment formats only.
+    VkPipelineRenderingCreateInfo pipeline_rendering_create_info = {0};
+    pipeline_rendering_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    pipeline_rendering_create_info.colorAttachmentCount    = 1;
+    pipeline_rendering_create_info.pColorAttachmentFormats = &renderpass->vk_color_format;
+
     VkGraphicsPipelineCreateInfo graphics_pipeline_create_info = {0};
     graphics_pipeline_create_info.sType      = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     graphics_pipeline_create_info.stageCount = 2;
@@ -146,10 +199,13 @@ bool pipeline_create(pipeline_t *pipeline, const device_t *device, const renderp
     graphics_pipeline_create_info.subpass             = 0;
     graphics_pipeline_create_info.basePipelineHandle  = VK_NULL_HANDLE;
     graphics_pipeline_create_info.basePipelineIndex   = -1;
+    if (renderpass->dynamic_rendering) {
+        graphics_pipeline_create_info.pNext = &pipeline_rendering_create_info;
+    }
 
     res = vkCreateGraphicsPipelines(
         device->vk_device,
-        VK_NULL_HANDLE,
+        vk_pipeline_cache,
         1,
         &graphics_pipeline_create_info,
         NULL,
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "vk/pipeline_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+// VkPipelineCacheHeaderVersionOne: header size, header version, vendor id, device id, uuid.
+#define PIPELINE_CACHE_HEADER_SIZE (4 * sizeof(uint32_t) + VK_UUID_SIZE)
+
+static uint32_t pipeline_cache_read_u32(const unsigned char *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static bool pipeline_cache_is_valid(const device_t *device, const void *data, size_t size) {
+    const unsigned char *header = (const unsigned char *)data;
+
+    if (size < PIPELINE_CACHE_HEADER_SIZE) {
+        log_warn("(PIPELINE_CACHE) file too small (%zu bytes).", size);
+        return false;
+    }
+
+    uint32_t header_size    = pipeline_cache_read_u32(header);
+    uint32_t header_version = pipeline_cache_read_u32(header + 4);
+    uint32_t vendor_id      = pipeline_cache_read_u32(header + 8);
+    uint32_t device_id      = pipeline_cache_read_u32(header + 12);
+
+    if (header_size < PIPELINE_CACHE_HEADER_SIZE || header_size > size
+        || header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        log_warn(
+            "(PIPELINE_CACHE) unknown header (size %u, version %u).", header_size, header_version
+        );
+        return false;
+    }
+
+    if (vendor_id != device->vendor_id || device_id != device->device_id) {
+        log_warn(
+            "(PIPELINE_CACHE) written by another device (%04x:%04x, expected %04x:%04x).",
+            vendor_id,
+            device_id,
+            device->vendor_id,
+            device->device_id
+        );
+        return false;
+    }
+
+    if (memcmp(header + 16, device->pipeline_cache_uuid, VK_UUID_SIZE) != 0) {
+        log_warn("(PIPELINE_CACHE) pipeline cache uuid mismatch, driver changed.");
+        return false;
+    }
+
+    return true;
+}
+
+static bool pipeline_cache_create_vk(
+    pipeline_cache_t *pipeline_cache,
+    const device_t   *device,
+    const void       *data,
+    size_t            size
+) {
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {0};
+    pipeline_cache_create_info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipeline_cache_create_info.initialDataSize = size;
+    pipeline_cache_create_info.pInitialData    = data;
+
+    VkResult res;
+    res = vkCreatePipelineCache(
+        device->vk_device, &pipeline_cache_create_info, NULL, &pipeline_cache->vk_pipeline_cache
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PIPELINE_CACHE) vkCreatePipelineCache failed (%s).", vk_res_str(res));
+        pipeline_cache->vk_pipeline_cache = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+bool pipeline_cache_create(
+    pipeline_cache_t *pipeline_cache,
+    const device_t   *device,
+    const char       *path
+) {
+    memset(pipeline_cache, 0, sizeof(*pipeline_cache));
+
+    pipeline_cache->path = path;
+
+    int fd = path != NULL ? open(path, O_RDONLY) : -1;
+    if (fd < 0) {
+        if (path != NULL && errno != ENOENT) {
+            log_warn("(PIPELINE_CACHE) failed to open %s (%s).", path, strerror(errno));
+        }
+        return pipeline_cache_create_vk(pipeline_cache, device, NULL, 0);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return pipeline_cache_create_vk(pipeline_cache, device, NULL, 0);
+    }
+
+    size_t size = (size_t)st.st_size;
+    void  *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        log_warn("(PIPELINE_CACHE) failed to map %s (%s).", path, strerror(errno));
+        return pipeline_cache_create_vk(pipeline_cache, device, NULL, 0);
+    }
+
+    bool valid = pipeline_cache_is_valid(device, data, size);
+    bool ok    = pipeline_cache_create_vk(
+        pipeline_cache, device, valid ? data : NULL, valid ? size : 0
+    );
+
+    munmap(data, size);
+
+    if (ok && valid) {
+        pipeline_cache->warm        = true;
+        pipeline_cache->loaded_size = size;
+        log_debug("(PIPELINE_CACHE) loaded %zu bytes from %s.", size, path);
+    } else if (ok) {
+        log_warn("(PIPELINE_CACHE) discarded %s.", path);
+    }
+
+    return ok;
+}
+
+// Written to a temporary file next to the cache and renamed over it, so a crash never leaves
+// a truncated cache behind.
+bool pipeline_cache_save(const pipeline_cache_t *pipeline_cache, const device_t *device) {
+    if (pipeline_cache->vk_pipeline_cache == VK_NULL_HANDLE || pipeline_cache->path == NULL) {
+        return true;
+    }
+
+    size_t   size = 0;
+    VkResult res;
+    res = vkGetPipelineCacheData(
+        device->vk_device, pipeline_cache->vk_pipeline_cache, &size, NULL
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PIPELINE_CACHE) vkGetPipelineCacheData failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    if (size == 0) {
+        return true;
+    }
+
+    void *data = malloc(size);
+    if (data == NULL) {
+        log_error("(PIPELINE_CACHE) malloc failed.");
+        return false;
+    }
+
+    res = vkGetPipelineCacheData(
+        device->vk_device, pipeline_cache->vk_pipeline_cache, &size, data
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(PIPELINE_CACHE) vkGetPipelineCacheData failed (%s).", vk_res_str(res));
+        free(data);
+        return false;
+    }
+
+    size_t tmp_path_size = strlen(pipeline_cache->path) + sizeof(".tmp");
+    char  *tmp_path      = (char *)malloc(tmp_path_size);
+    if (tmp_path == NULL) {
+        log_error("(PIPELINE_CACHE) malloc failed.");
+        free(data);
+        return false;
+    }
+    snprintf(tmp_path, tmp_path_size, "%s.tmp", pipeline_cache->path);
+
+    bool ok = false;
+    int  fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        const unsigned char *cursor    = (const unsigned char *)data;
+        size_t               remaining = size;
+        while (remaining > 0) {
+            ssize_t written = write(fd, cursor, remaining);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                break;
+            }
+            cursor    += written;
+            remaining -= (size_t)written;
+        }
+
+        ok = remaining == 0 && fsync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        ok = ok && rename(tmp_path, pipeline_cache->path) == 0;
+    }
+
+    if (ok) {
+        log_debug("(PIPELINE_CACHE) saved %zu bytes to %s.", size, pipeline_cache->path);
+    } else {
+        log_warn(
+            "(PIPELINE_CACHE) failed to save %s (%s).", pipeline_cache->path, strerror(errno)
+        );
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+    free(data);
+
+    return ok;
+}
+
+void pipeline_cache_destroy(pipeline_cache_t *pipeline_cache, const device_t *device) {
+    if (pipeline_cache == NULL) {
+        return;
+    }
+
+    if (pipeline_cache->vk_pipeline_cache != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(device->vk_device, pipeline_cache->vk_pipeline_cache, NULL);
+    }
+
+    memset(pipeline_cache, 0, sizeof(*pipeline_cache));
+}
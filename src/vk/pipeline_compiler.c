@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "vk/pipeline_compiler.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/clock.h"
+#include "util/log.h"
+
+static void *pipeline_compiler_main(void *arg) {
+    pipeline_compiler_t *compiler = (pipeline_compiler_t *)arg;
+
+    pthread_mutex_lock(&compiler->mutex);
+    for (;;) {
+        while (!compiler->quit && compiler->head == NULL) {
+            pthread_cond_wait(&compiler->work_cond, &compiler->mutex);
+        }
+        if (compiler->quit) {
+            break;
+        }
+
+        pipeline_job_t *job = compiler->head;
+        compiler->head      = job->next;
+        if (compiler->head == NULL) {
+            compiler->tail = NULL;
+        }
+        job->next         = NULL;
+        job->running      = true;
+        compiler->running = true;
+        pthread_mutex_unlock(&compiler->mutex);
+
+        // vkCreateGraphicsPipelines is free-threaded and the cache is internally synchronized.
+        bool ok = pipeline_create(
+            &job->pipeline,
+            compiler->device,
+            job->renderpass,
+            compiler->vk_pipeline_cache,
+            compiler->variant,
+            compiler->vk_set_layouts,
+            compiler->vk_set_layouts_count
+        );
+
+        pthread_mutex_lock(&compiler->mutex);
+        job->running      = false;
+        job->status       = ok ? PIPELINE_JOB_READY : PIPELINE_JOB_FAILED;
+        job->ready_ns     = clock_now_ns();
+        compiler->running = false;
+        pthread_cond_broadcast(&compiler->done_cond);
+    }
+    pthread_mutex_unlock(&compiler->mutex);
+
+    return NULL;
+}
+
+bool pipeline_compiler_create(
+    pipeline_compiler_t         *compiler,
+    const device_t              *device,
+    VkPipelineCache              vk_pipeline_cache,
+    pipeline_variant_t           variant,
+    const VkDescriptorSetLayout *vk_set_layouts,
+    uint32_t                     vk_set_layouts_count
+) {
+    memset(compiler, 0, sizeof(*compiler));
+
+    assert(vk_set_layouts_count <= PIPELINE_MAX_SET_LAYOUTS);
+
+    compiler->device               = device;
+    compiler->vk_pipeline_cache    = vk_pipeline_cache;
+    compiler->variant              = variant;
+    compiler->vk_set_layouts_count = vk_set_layouts_count;
+    for (uint32_t i = 0; i < vk_set_layouts_count; ++i) {
+        compiler->vk_set_layouts[i] = vk_set_layouts[i];
+    }
+
+    if (pthread_mutex_init(&compiler->mutex, NULL) != 0) {
+        log_error("(PIPELINE_COMPILER) pthread_mutex_init failed.");
+        return false;
+    }
+    if (pthread_cond_init(&compiler->work_cond, NULL) != 0) {
+        log_error("(PIPELINE_COMPILER) pthread_cond_init failed.");
+        pthread_mutex_destroy(&compiler->mutex);
+        return false;
+    }
+    if (pthread_cond_init(&compiler->done_cond, NULL) != 0) {
+        log_error("(PIPELINE_COMPILER) pthread_cond_init failed.");
+        pthread_cond_destroy(&compiler->work_cond);
+        pthread_mutex_destroy(&compiler->mutex);
+        return false;
+    }
+    compiler->has_sync_objects = true;
+
+    if (pthread_create(&compiler->thread, NULL, pipeline_compiler_main, compiler) != 0) {
+        log_error("(PIPELINE_COMPILER) pthread_create failed.");
+        pipeline_compiler_destroy(compiler);
+        return false;
+    }
+    compiler->started = true;
+
+    return true;
+}
+
+// Jobs still queued are marked failed; the caller remains responsible for cancelling them.
+void pipeline_compiler_destroy(pipeline_compiler_t *compiler) {
+    if (compiler == NULL) {
+        return;
+    }
+
+    if (compiler->has_sync_objects) {
+        pthread_mutex_lock(&compiler->mutex);
+        compiler->quit = true;
+        pthread_cond_broadcast(&compiler->work_cond);
+        pthread_mutex_unlock(&compiler->mutex);
+    }
+
+    if (compiler->started) {
+        pthread_join(compiler->thread, NULL);
+    }
+
+    for (pipeline_job_t *job = compiler->head; job != NULL;) {
+        pipeline_job_t *next = job->next;
+        job->status          = PIPELINE_JOB_FAILED;
+        job->next            = NULL;
+        job                  = next;
+    }
+
+    if (compiler->has_sync_objects) {
+        pthread_cond_destroy(&compiler->done_cond);
+        pthread_cond_destroy(&compiler->work_cond);
+        pthread_mutex_destroy(&compiler->mutex);
+    }
+
+    memset(compiler, 0, sizeof(*compiler));
+}
+
+// The render pass must outlive the job; it is only read by the compile thread.
+pipeline_job_t *
+pipeline_compiler_submit(pipeline_compiler_t *compiler, const renderpass_t *renderpass) {
+    pipeline_job_t *job = (pipeline_job_t *)calloc(1, sizeof(*job));
+    if (job == NULL) {
+        log_error("(PIPELINE_COMPILER) calloc failed.");
+        return NULL;
+    }
+
+    job->renderpass = renderpass;
+    job->status     = PIPELINE_JOB_PENDING;
+    job->submit_ns  = clock_now_ns();
+
+    pthread_mutex_lock(&compiler->mutex);
+    if (compiler->tail != NULL) {
+        compiler->tail->next = job;
+    } else {
+        compiler->head = job;
+    }
+    compiler->tail = job;
+    pthread_cond_signal(&compiler->work_cond);
+    pthread_mutex_unlock(&compiler->mutex);
+
+    return job;
+}
+
+pipeline_job_status_t pipeline_compiler_poll(pipeline_compiler_t *compiler, pipeline_job_t *job) {
+    pthread_mutex_lock(&compiler->mutex);
+    pipeline_job_status_t status = job->status;
+    pthread_mutex_unlock(&compiler->mutex);
+
+    return status;
+}
+
+pipeline_job_status_t pipeline_compiler_wait(pipeline_compiler_t *compiler, pipeline_job_t *job) {
+    pthread_mutex_lock(&compiler->mutex);
+    while (job->status == PIPELINE_JOB_PENDING && !compiler->quit) {
+        pthread_cond_wait(&compiler->done_cond, &compiler->mutex);
+    }
+    pipeline_job_status_t status = job->status;
+    pthread_mutex_unlock(&compiler->mutex);
+
+    return status;
+}
+
+// Moves the built pipeline out of a ready job and frees the handle.
+bool pipeline_compiler_take(
+    pipeline_compiler_t *compiler,
+    pipeline_job_t      *job,
+    pipeline_t          *pipeline
+) {
+    if (pipeline_compiler_poll(compiler, job) != PIPELINE_JOB_READY) {
+        return false;
+    }
+
+    *pipeline = job->pipeline;
+    free(job);
+
+    return true;
+}
+
+// Unlinks a queued job, or waits for a running one, then destroys whatever it built.
+void pipeline_compiler_cancel(pipeline_compiler_t *compiler, pipeline_job_t *job) {
+    if (job == NULL) {
+        return;
+    }
+
+    if (compiler->has_sync_objects) {
+        pthread_mutex_lock(&compiler->mutex);
+
+        pipeline_job_t *prev = NULL;
+        for (pipeline_job_t *it = compiler->head; it != NULL; prev = it, it = it->next) {
+            if (it != job) {
+                continue;
+            }
+            if (prev != NULL) {
+                prev->next = it->next;
+            } else {
+                compiler->head = it->next;
+            }
+            if (compiler->tail == it) {
+                compiler->tail = prev;
+            }
+            job->status = PIPELINE_JOB_FAILED;
+            break;
+        }
+
+        while (job->running) {
+            pthread_cond_wait(&compiler->done_cond, &compiler->mutex);
+        }
+
+        pthread_mutex_unlock(&compiler->mutex);
+    }
+
+    assert(job->status != PIPELINE_JOB_PENDING);
+
+    pipeline_destroy(&job->pipeline, compiler->device);
+    free(job);
+}
+
+// True while nothing is queued or building, so shader code may be replaced.
+bool pipeline_compiler_idle(pipeline_compiler_t *compiler) {
+    pthread_mutex_lock(&compiler->mutex);
+    bool idle = compiler->head == NULL && !compiler->running;
+    pthread_mutex_unlock(&compiler->mutex);
+
+    return idle;
+}
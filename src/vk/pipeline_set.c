@@ -0,0 +1,226 @@
+#include "vk/pipeline_set.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util/log.h"
+
+static pipeline_set_entry_t *pipeline_set_find(pipeline_set_t *pipeline_set, VkFormat vk_format) {
+    for (uint32_t i = 0; i < pipeline_set->entries_count; ++i) {
+        if (pipeline_set->entries[i].vk_format == vk_format) {
+            return &pipeline_set->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+void pipeline_set_init(
+    pipeline_set_t      *pipeline_set,
+    const device_t      *device,
+    pipeline_compiler_t *compiler,
+    VkImageLayout        vk_final_layout,
+    bool                 dynamic_rendering
+) {
+    memset(pipeline_set, 0, sizeof(*pipeline_set));
+
+    pipeline_set->device            = device;
+    pipeline_set->compiler          = compiler;
+    pipeline_set->vk_final_layout   = vk_final_layout;
+    pipeline_set->dynamic_rendering = dynamic_rendering;
+}
+
+void pipeline_set_destroy(pipeline_set_t *pipeline_set) {
+    if (pipeline_set == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < pipeline_set->entries_count; ++i) {
+        pipeline_set_entry_t *entry = &pipeline_set->entries[i];
+
+        pipeline_compiler_cancel(pipeline_set->compiler, entry->job);
+        pipeline_compiler_cancel(pipeline_set->compiler, entry->rebuild_job);
+        pipeline_destroy(&entry->pipeline, pipeline_set->device);
+        renderpass_destroy(&entry->renderpass, pipeline_set->device);
+    }
+
+    memset(pipeline_set, 0, sizeof(*pipeline_set));
+}
+
+// Queues a build for the format unless one exists already.
+bool pipeline_set_request(pipeline_set_t *pipeline_set, VkFormat vk_format) {
+    if (pipeline_set_find(pipeline_set, vk_format) != NULL) {
+        return true;
+    }
+
+    if (pipeline_set->entries_count == PIPELINE_SET_MAX_FORMATS) {
+        log_error("(PIPELINE_SET) no room for format %d.", (int)vk_format);
+        return false;
+    }
+
+    pipeline_set_entry_t *entry = &pipeline_set->entries[pipeline_set->entries_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->vk_format = vk_format;
+
+    if (!renderpass_create_format(
+            &entry->renderpass,
+            pipeline_set->device,
+            vk_format,
+            pipeline_set->vk_final_layout,
+            pipeline_set->dynamic_rendering
+        )) {
+        return false;
+    }
+
+    entry->job = pipeline_compiler_submit(pipeline_set->compiler, &entry->renderpass);
+    if (entry->job == NULL) {
+        renderpass_destroy(&entry->renderpass, pipeline_set->device);
+        return false;
+    }
+
+    ++pipeline_set->entries_count;
+
+    return true;
+}
+
+// Yields the format's pipeline once built, NULL while it is still compiling. Requests the
+// format if it is not part of the set yet.
+bool pipeline_set_poll(
+    pipeline_set_t    *pipeline_set,
+    VkFormat           vk_format,
+    const pipeline_t **pipeline
+) {
+    *pipeline = NULL;
+
+    if (!pipeline_set_request(pipeline_set, vk_format)) {
+        return false;
+    }
+
+    pipeline_set_entry_t *entry = pipeline_set_find(pipeline_set, vk_format);
+    assert(entry != NULL);
+
+    if (entry->job != NULL) {
+        pipeline_job_status_t status = pipeline_compiler_poll(pipeline_set->compiler, entry->job);
+        if (status == PIPELINE_JOB_PENDING) {
+            return true;
+        }
+
+        if (status == PIPELINE_JOB_FAILED) {
+            log_error("(PIPELINE_SET) failed to build pipeline for format %d.", (int)vk_format);
+            return false;
+        }
+
+        entry->compile_ns = entry->job->ready_ns - entry->job->submit_ns;
+        pipeline_compiler_take(pipeline_set->compiler, entry->job, &entry->pipeline);
+        entry->job   = NULL;
+        entry->ready = true;
+    }
+
+    *pipeline = &entry->pipeline;
+
+    return true;
+}
+
+bool pipeline_set_wait(pipeline_set_t *pipeline_set, VkFormat vk_format) {
+    if (!pipeline_set_request(pipeline_set, vk_format)) {
+        return false;
+    }
+
+    pipeline_set_entry_t *entry = pipeline_set_find(pipeline_set, vk_format);
+    assert(entry != NULL);
+
+    if (entry->job == NULL) {
+        return entry->ready;
+    }
+
+    return pipeline_compiler_wait(pipeline_set->compiler, entry->job) == PIPELINE_JOB_READY;
+}
+
+uint64_t pipeline_set_compile_ns(const pipeline_set_t *pipeline_set, VkFormat vk_format) {
+    for (uint32_t i = 0; i < pipeline_set->entries_count; ++i) {
+        if (pipeline_set->entries[i].vk_format == vk_format) {
+            return pipeline_set->entries[i].compile_ns;
+        }
+    }
+
+    return 0;
+}
+
+bool pipeline_set_uses(const pipeline_set_t *pipeline_set, uint32_t shaders) {
+    return (pipeline_variant_shaders(pipeline_set->compiler->variant) & shaders) != 0;
+}
+
+// Queues a new build of every pipeline in the set from the current shader code. Built
+// pipelines stay in use until pipeline_set_swap; unfinished initial builds are restarted.
+bool pipeline_set_rebuild(pipeline_set_t *pipeline_set) {
+    for (uint32_t i = 0; i < pipeline_set->entries_count; ++i) {
+        pipeline_set_entry_t *entry = &pipeline_set->entries[i];
+
+        pipeline_compiler_cancel(pipeline_set->compiler, entry->rebuild_job);
+        entry->rebuild_job = NULL;
+
+        if (!entry->ready) {
+            pipeline_compiler_cancel(pipeline_set->compiler, entry->job);
+            entry->job = pipeline_compiler_submit(pipeline_set->compiler, &entry->renderpass);
+            if (entry->job == NULL) {
+                return false;
+            }
+            continue;
+        }
+
+        entry->rebuild_job = pipeline_compiler_submit(pipeline_set->compiler, &entry->renderpass);
+        if (entry->rebuild_job == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// True once no rebuild is pending any more.
+bool pipeline_set_rebuilt(pipeline_set_t *pipeline_set) {
+    for (uint32_t i = 0; i < pipeline_set->entries_count; ++i) {
+        const pipeline_set_entry_t *entry = &pipeline_set->entries[i];
+        if (entry->rebuild_job != NULL
+            && pipeline_compiler_poll(pipeline_set->compiler, entry->rebuild_job)
+                   == PIPELINE_JOB_PENDING) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Replaces every pipeline whose rebuild succeeded and returns how many were replaced. A failed
+// rebuild keeps the old pipeline. No pending frame may still use the replaced pipelines, but
+// the entries keep their addresses, so pointers into the set stay valid.
+uint32_t pipeline_set_swap(pipeline_set_t *pipeline_set) {
+    uint32_t swapped = 0;
+    for (uint32_t i = 0; i < pipeline_set->entries_count; ++i) {
+        pipeline_set_entry_t *entry = &pipeline_set->entries[i];
+        if (entry->rebuild_job == NULL) {
+            continue;
+        }
+
+        pipeline_job_t *job = entry->rebuild_job;
+        entry->rebuild_job  = NULL;
+
+        const uint64_t compile_ns = job->ready_ns - job->submit_ns;
+        pipeline_t     pipeline   = {0};
+        if (!pipeline_compiler_take(pipeline_set->compiler, job, &pipeline)) {
+            log_error(
+                "(PIPELINE_SET) failed to rebuild pipeline for format %d, keeping the old one.",
+                (int)entry->vk_format
+            );
+            pipeline_compiler_cancel(pipeline_set->compiler, job);
+            continue;
+        }
+
+        pipeline_destroy(&entry->pipeline, pipeline_set->device);
+        entry->pipeline   = pipeline;
+        entry->compile_ns = compile_ns;
+        ++swapped;
+    }
+
+    return swapped;
+}
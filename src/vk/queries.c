@@ -0,0 +1,279 @@
+#include "vk/queries.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+#define QUERIES_TIMESTAMPS_PER_FRAME 2
+
+static const VkQueryPipelineStatisticFlags queries_statistics
+    = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+static bool queries_create_pool(
+    const device_t               *device,
+    VkQueryType                   type,
+    VkQueryPipelineStatisticFlags statistics,
+    uint32_t                      count,
+    VkQueryPool                  *vk_pool
+) {
+    VkQueryPoolCreateInfo query_pool_create_info = {0};
+    query_pool_create_info.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_pool_create_info.queryType             = type;
+    query_pool_create_info.queryCount            = count;
+    query_pool_create_info.pipelineStatistics    = statistics;
+
+    VkResult res;
+    res = vkCreateQueryPool(device->vk_device, &query_pool_create_info, NULL, vk_pool);
+    if (res != VK_SUCCESS) {
+        log_error("(QUERIES) vkCreateQueryPool failed (%s).", vk_res_str(res));
+        *vk_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+bool queries_create(queries_t *queries, const device_t *device, uint32_t frame_count) {
+    memset(queries, 0, sizeof(*queries));
+
+    queries->frame_count = frame_count;
+
+    queries->pending = (bool *)calloc(frame_count, sizeof(*queries->pending));
+    queries->statistics_pending
+        = (bool *)calloc(frame_count, sizeof(*queries->statistics_pending));
+    if (queries->pending == NULL || queries->statistics_pending == NULL) {
+        log_error("(QUERIES) calloc failed.");
+        queries_destroy(queries, device);
+        return false;
+    }
+
+    if (device->timestamp_valid_bits > 0) {
+        if (!queries_create_pool(
+                device,
+                VK_QUERY_TYPE_TIMESTAMP,
+                0,
+                frame_count * QUERIES_TIMESTAMPS_PER_FRAME,
+                &queries->vk_timestamp_pool
+            )) {
+            queries_destroy(queries, device);
+            return false;
+        }
+
+        queries->timestamp_mask = device->timestamp_valid_bits >= 64
+                                    ? UINT64_MAX
+                                    : (1ULL << device->timestamp_valid_bits) - 1;
+        queries->timestamp_period = device->timestamp_period;
+    } else {
+        log_warn("(QUERIES) graphics queue has no timestamp support, gpu time disabled.");
+    }
+
+    if (device->has_pipeline_statistics) {
+        if (!queries_create_pool(
+                device,
+                VK_QUERY_TYPE_PIPELINE_STATISTICS,
+                queries_statistics,
+                frame_count,
+                &queries->vk_statistics_pool
+            )) {
+            queries_destroy(queries, device);
+            return false;
+        }
+
+        queries->statistics = queries_statistics;
+        if (device->has_inherited_queries) {
+            queries->inherited_statistics = queries_statistics;
+        } else {
+            log_debug("(QUERIES) no inherited queries, threaded frames skip the statistics.");
+        }
+    }
+
+    return true;
+}
+
+void queries_destroy(queries_t *queries, const device_t *device) {
+    if (queries == NULL) {
+        return;
+    }
+
+    if (queries->vk_timestamp_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device->vk_device, queries->vk_timestamp_pool, NULL);
+    }
+
+    if (queries->vk_statistics_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device->vk_device, queries->vk_statistics_pool, NULL);
+    }
+
+    if (queries->pending != NULL) {
+        free(queries->pending);
+    }
+
+    if (queries->statistics_pending != NULL) {
+        free(queries->statistics_pending);
+    }
+
+    memset(queries, 0, sizeof(*queries));
+}
+
+void queries_cmd_begin(
+    queries_t      *queries,
+    VkCommandBuffer command_buffer,
+    uint32_t        frame_index,
+    bool            secondaries
+) {
+    if (queries == NULL || queries->pending == NULL) {
+        return;
+    }
+
+    assert(frame_index < queries->frame_count);
+
+    if (queries->vk_timestamp_pool != VK_NULL_HANDLE) {
+        uint32_t first_query = frame_index * QUERIES_TIMESTAMPS_PER_FRAME;
+        vkCmdResetQueryPool(
+            command_buffer, queries->vk_timestamp_pool, first_query, QUERIES_TIMESTAMPS_PER_FRAME
+        );
+        vkCmdWriteTimestamp(
+            command_buffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            queries->vk_timestamp_pool,
+            first_query
+        );
+    }
+
+    queries->statistics_pending[frame_index]
+        = queries->vk_statistics_pool != VK_NULL_HANDLE
+       && (!secondaries || queries->inherited_statistics != 0);
+    if (queries->statistics_pending[frame_index]) {
+        vkCmdResetQueryPool(command_buffer, queries->vk_statistics_pool, frame_index, 1);
+        vkCmdBeginQuery(command_buffer, queries->vk_statistics_pool, frame_index, 0);
+    }
+}
+
+void queries_cmd_end(queries_t *queries, VkCommandBuffer command_buffer, uint32_t frame_index) {
+    if (queries == NULL || queries->pending == NULL) {
+        return;
+    }
+
+    assert(frame_index < queries->frame_count);
+
+    if (queries->statistics_pending[frame_index]) {
+        vkCmdEndQuery(command_buffer, queries->vk_statistics_pool, frame_index);
+    }
+
+    if (queries->vk_timestamp_pool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(
+            command_buffer,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            queries->vk_timestamp_pool,
+            frame_index * QUERIES_TIMESTAMPS_PER_FRAME + 1
+        );
+    }
+
+    queries->pending[frame_index] = true;
+}
+
+// Called once the frame's fence or timeline value has been waited on, so the results are
+// normally available. Never waits: a result that is not ready yet is dropped.
+bool queries_collect(queries_t *queries, const device_t *device, uint32_t frame_index) {
+    if (queries == NULL || queries->pending == NULL) {
+        return false;
+    }
+
+    assert(frame_index < queries->frame_count);
+
+    if (!queries->pending[frame_index]) {
+        return false;
+    }
+    queries->pending[frame_index] = false;
+
+    queries_result_t result = {0};
+
+    VkResult res;
+    if (queries->vk_timestamp_pool != VK_NULL_HANDLE) {
+        uint64_t timestamps[QUERIES_TIMESTAMPS_PER_FRAME] = {0};
+        res = vkGetQueryPoolResults(
+            device->vk_device,
+            queries->vk_timestamp_pool,
+            frame_index * QUERIES_TIMESTAMPS_PER_FRAME,
+            QUERIES_TIMESTAMPS_PER_FRAME,
+            sizeof(timestamps),
+            timestamps,
+            sizeof(timestamps[0]),
+            VK_QUERY_RESULT_64_BIT
+        );
+        if (res == VK_NOT_READY) {
+            return false;
+        } else if (res != VK_SUCCESS) {
+            log_error("(QUERIES) vkGetQueryPoolResults failed (%s).", vk_res_str(res));
+            return false;
+        }
+
+        uint64_t ticks = (timestamps[1] - timestamps[0]) & queries->timestamp_mask;
+        result.gpu_ns  = (uint64_t)((double)ticks * (double)queries->timestamp_period);
+    }
+
+    if (queries->statistics_pending[frame_index]) {
+        // Results are written in statistic bit order: vertex, then fragment invocations.
+        uint64_t statistics[2] = {0};
+        res                    = vkGetQueryPoolResults(
+            device->vk_device,
+            queries->vk_statistics_pool,
+            frame_index,
+            1,
+            sizeof(statistics),
+            statistics,
+            sizeof(statistics),
+            VK_QUERY_RESULT_64_BIT
+        );
+        if (res == VK_SUCCESS) {
+            result.has_statistics       = true;
+            result.vertex_invocations   = statistics[0];
+            result.fragment_invocations = statistics[1];
+        } else if (res != VK_NOT_READY) {
+            log_error("(QUERIES) vkGetQueryPoolResults failed (%s).", vk_res_str(res));
+        }
+    }
+
+    queries->latest     = result;
+    queries->has_latest = true;
+
+    ++queries->stats.frames;
+    queries->stats.gpu_ns += result.gpu_ns;
+    if (result.gpu_ns > queries->stats.max_gpu_ns) {
+        queries->stats.max_gpu_ns = result.gpu_ns;
+    }
+    if (result.has_statistics) {
+        ++queries->stats.statistics_frames;
+    }
+    queries->stats.vertex_invocations   += result.vertex_invocations;
+    queries->stats.fragment_invocations += result.fragment_invocations;
+
+    return true;
+}
+
+void queries_log_stats(const queries_t *queries) {
+    if (queries->stats.frames == 0) {
+        return;
+    }
+
+    double frames = (double)queries->stats.frames;
+
+    log_debug(
+        "(QUERIES) gpu render pass: avg %.3f ms, max %.3f ms (%llu frames).",
+        (double)queries->stats.gpu_ns / frames / 1e6,
+        (double)queries->stats.max_gpu_ns / 1e6,
+        (unsigned long long)queries->stats.frames
+    );
+
+    if (queries->stats.statistics_frames > 0) {
+        double statistics_frames = (double)queries->stats.statistics_frames;
+        log_debug(
+            "(QUERIES) %.0f vertex + %.0f fragment shader invocations per frame.",
+            (double)queries->stats.vertex_invocations / statistics_frames,
+            (double)queries->stats.fragment_invocations / statistics_frames
+        );
+    }
+}
@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "vk/recorder.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static bool recorder_worker_create_pools(recorder_worker_t *worker, const device_t *device) {
+    uint32_t frame_count = worker->recorder->frame_count;
+
+    worker->vk_pools   = (VkCommandPool *)calloc(frame_count, sizeof(*worker->vk_pools));
+    worker->vk_buffers = (VkCommandBuffer *)calloc(frame_count, sizeof(*worker->vk_buffers));
+    if (worker->vk_pools == NULL || worker->vk_buffers == NULL) {
+        log_error("(RECORDER) calloc failed.");
+        return false;
+    }
+
+    VkCommandPoolCreateInfo command_pool_create_info = {0};
+    command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    command_pool_create_info.queueFamilyIndex = device->graphics_queue_familiy_index;
+
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        VkResult res;
+        res = vkCreateCommandPool(
+            device->vk_device, &command_pool_create_info, NULL, &worker->vk_pools[i]
+        );
+        if (res != VK_SUCCESS) {
+            log_error("(RECORDER) vkCreateCommandPool failed (%s).", vk_res_str(res));
+            worker->vk_pools[i] = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {0};
+        command_buffer_allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_buffer_allocate_info.commandPool        = worker->vk_pools[i];
+        command_buffer_allocate_info.level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        command_buffer_allocate_info.commandBufferCount = 1;
+
+        res = vkAllocateCommandBuffers(
+            device->vk_device, &command_buffer_allocate_info, &worker->vk_buffers[i]
+        );
+        if (res != VK_SUCCESS) {
+            log_error("(RECORDER) vkAllocateCommandBuffers failed (%s).", vk_res_str(res));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool recorder_worker_record(recorder_worker_t *worker, const recorder_job_t *job) {
+    const recorder_t *recorder = worker->recorder;
+    const device_t   *device   = recorder->device;
+
+    VkCommandBuffer command_buffer = worker->vk_buffers[job->frame_index];
+
+    VkResult res;
+    res = vkResetCommandPool(device->vk_device, worker->vk_pools[job->frame_index], 0);
+    if (res != VK_SUCCESS) {
+        log_error("(RECORDER) vkResetCommandPool failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    VkCommandBufferInheritanceRenderingInfo command_buffer_inheritance_rendering_info = {0};
+    command_buffer_inheritance_rendering_info.sType
+        = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    command_buffer_inheritance_rendering_info.colorAttachmentCount    = 1;
+    command_buffer_inheritance_rendering_info.pColorAttachmentFormats = &job->vk_color_format;
+    command_buffer_inheritance_rendering_info.rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo command_buffer_inheritance_info = {0};
+    command_buffer_inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    command_buffer_inheritance_info.renderPass         = job->vk_render_pass;
+    command_buffer_inheritance_info.subpass            = 0;
+    command_buffer_inheritance_info.framebuffer        = job->vk_framebuffer;
+    command_buffer_inheritance_info.pipelineStatistics = job->pipeline_statistics;
+    if (job->vk_render_pass == VK_NULL_HANDLE) {
+        command_buffer_inheritance_info.pNext = &command_buffer_inheritance_rendering_info;
+    }
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {0};
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+                                    | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    command_buffer_begin_info.pInheritanceInfo = &command_buffer_inheritance_info;
+
+    res = vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    if (res != VK_SUCCESS) {
+        log_error("(RECORDER) vkBeginCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    uint64_t items = job->item_count;
+    uint32_t first = (uint32_t)(items * worker->index / recorder->thread_count);
+    uint32_t last  = (uint32_t)(items * (worker->index + 1) / recorder->thread_count);
+    job->record(command_buffer, job->user, first, last - first);
+
+    res = vkEndCommandBuffer(command_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(RECORDER) vkEndCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+static void *recorder_worker_main(void *arg) {
+    recorder_worker_t *worker   = (recorder_worker_t *)arg;
+    recorder_t        *recorder = worker->recorder;
+
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&recorder->mutex);
+    for (;;) {
+        while (!recorder->quit && recorder->generation == seen) {
+            pthread_cond_wait(&recorder->start_cond, &recorder->mutex);
+        }
+        if (recorder->quit) {
+            break;
+        }
+
+        seen               = recorder->generation;
+        recorder_job_t job = recorder->job;
+        pthread_mutex_unlock(&recorder->mutex);
+
+        bool ok = recorder_worker_record(worker, &job);
+
+        pthread_mutex_lock(&recorder->mutex);
+        worker->ok = ok;
+        if (--recorder->pending == 0) {
+            pthread_cond_signal(&recorder->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+
+    return NULL;
+}
+
+bool recorder_create(
+    recorder_t     *recorder,
+    const device_t *device,
+    uint32_t        thread_count,
+    uint32_t        frame_count
+) {
+    memset(recorder, 0, sizeof(*recorder));
+
+    assert(thread_count > 0 && thread_count <= RECORDER_MAX_THREADS);
+
+    recorder->device       = device;
+    recorder->thread_count = thread_count;
+    recorder->frame_count  = frame_count;
+
+    if (pthread_mutex_init(&recorder->mutex, NULL) != 0) {
+        log_error("(RECORDER) pthread_mutex_init failed.");
+        return false;
+    }
+    if (pthread_cond_init(&recorder->start_cond, NULL) != 0) {
+        log_error("(RECORDER) pthread_cond_init failed.");
+        pthread_mutex_destroy(&recorder->mutex);
+        return false;
+    }
+    if (pthread_cond_init(&recorder->done_cond, NULL) != 0) {
+        log_error("(RECORDER) pthread_cond_init failed.");
+        pthread_cond_destroy(&recorder->start_cond);
+        pthread_mutex_destroy(&recorder->mutex);
+        return false;
+    }
+    recorder->has_sync_objects = true;
+
+    recorder->workers = (recorder_worker_t *)calloc(thread_count, sizeof(*recorder->workers));
+    if (recorder->workers == NULL) {
+        log_error("(RECORDER) calloc failed.");
+        recorder_destroy(recorder);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        recorder_worker_t *worker = &recorder->workers[i];
+        worker->recorder          = recorder;
+        worker->index             = i;
+
+        if (!recorder_worker_create_pools(worker, device)) {
+            recorder_destroy(recorder);
+            return false;
+        }
+
+        if (pthread_create(&worker->thread, NULL, recorder_worker_main, worker) != 0) {
+            log_error("(RECORDER) pthread_create failed.");
+            recorder_destroy(recorder);
+            return false;
+        }
+        worker->started = true;
+    }
+
+    return true;
+}
+
+void recorder_destroy(recorder_t *recorder) {
+    if (recorder == NULL) {
+        return;
+    }
+
+    if (recorder->has_sync_objects) {
+        pthread_mutex_lock(&recorder->mutex);
+        recorder->quit = true;
+        pthread_cond_broadcast(&recorder->start_cond);
+        pthread_mutex_unlock(&recorder->mutex);
+    }
+
+    for (uint32_t i = 0; recorder->workers != NULL && i < recorder->thread_count; ++i) {
+        recorder_worker_t *worker = &recorder->workers[i];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+        }
+
+        for (uint32_t j = 0; worker->vk_pools != NULL && j < recorder->frame_count; ++j) {
+            if (worker->vk_pools[j] != VK_NULL_HANDLE) {
+                vkDestroyCommandPool(recorder->device->vk_device, worker->vk_pools[j], NULL);
+            }
+        }
+        free(worker->vk_pools);
+        free(worker->vk_buffers);
+    }
+    free(recorder->workers);
+
+    if (recorder->has_sync_objects) {
+        pthread_cond_destroy(&recorder->done_cond);
+        pthread_cond_destroy(&recorder->start_cond);
+        pthread_mutex_destroy(&recorder->mutex);
+    }
+
+    memset(recorder, 0, sizeof(*recorder));
+}
+
+// Hands the job to every worker and blocks until all secondary buffers are recorded. The
+// frame's previous submission must have retired, since the workers reset its pools.
+bool recorder_record(
+    recorder_t           *recorder,
+    const recorder_job_t *job,
+    VkCommandBuffer       vk_secondary_buffers[RECORDER_MAX_THREADS]
+) {
+    assert(job->frame_index < recorder->frame_count);
+
+    pthread_mutex_lock(&recorder->mutex);
+    recorder->job     = *job;
+    recorder->pending = recorder->thread_count;
+    ++recorder->generation;
+    pthread_cond_broadcast(&recorder->start_cond);
+
+    while (recorder->pending > 0) {
+        pthread_cond_wait(&recorder->done_cond, &recorder->mutex);
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < recorder->thread_count; ++i) {
+        ok                      = ok && recorder->workers[i].ok;
+        vk_secondary_buffers[i] = recorder->workers[i].vk_buffers[job->frame_index];
+    }
+
+    return ok;
+}
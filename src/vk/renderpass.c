@@ -23,11 +23,13 @@ static void renderpass_destroy_framebuffers(renderpass_t *renderpass, const devi
 static bool renderpass_create_framebuffers(
     renderpass_t      *renderpass,
     const device_t    *device,
-    const swapchain_t *swapchain
+    const VkImageView *vk_image_views,
+    uint32_t           vk_image_count,
+    VkExtent2D         extent
 ) {
     renderpass_destroy_framebuffers(renderpass, device);
 
-    renderpass->vk_framebuffers_count = swapchain->vk_image_count;
+    renderpass->vk_framebuffers_count = vk_image_count;
     renderpass->vk_framebuffers       = (VkFramebuffer *)malloc(
         renderpass->vk_framebuffers_count * sizeof(*renderpass->vk_framebuffers)
     );
@@ -37,16 +39,16 @@ static bool renderpass_create_framebuffers(
         return false;
     }
 
-    for (uint32_t i = 0; i < swapchain->vk_image_count; ++i) {
-        VkImageView image_view_attachments[] = {swapchain->vk_image_views[i]};
+    for (uint32_t i = 0; i < vk_image_count; ++i) {
+        VkImageView image_view_attachments[] = {vk_image_views[i]};
 
         VkFramebufferCreateInfo framebuffer_create_info = {0};
         framebuffer_create_info.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebuffer_create_info.renderPass              = renderpass->vk_render_pass;
         framebuffer_create_info.attachmentCount         = 1;
         framebuffer_create_info.pAttachments            = image_view_attachments;
-        framebuffer_create_info.width                   = swapchain->extent.width;
-        framebuffer_create_info.height                  = swapchain->extent.height;
+        framebuffer_create_info.width                   = extent.width;
+        framebuffer_create_info.height                  = extent.height;
         framebuffer_create_info.layers                  = 1;
 
         VkResult res;
@@ -63,22 +65,21 @@ static bool renderpass_create_framebuffers(
     return true;
 }
 
-bool renderpass_create(
-    renderpass_t      *renderpass,
-    const device_t    *device,
-    const swapchain_t *swapchain
+static bool renderpass_create_core(
+    renderpass_t   *renderpass,
+    const device_t *device,
+    VkFormat        vk_color_format,
+    VkImageLayout   vk_final_layout
 ) {
-    memset(renderpass, 0, sizeof(*renderpass));
-
     VkAttachmentDescription attachment_description = {0};
-    attachment_description.format                  = swapchain->vk_image_format;
+    attachment_description.format                  = vk_color_format;
     attachment_description.samples                 = VK_SAMPLE_COUNT_1_BIT;
     attachment_description.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachment_description.storeOp                 = VK_ATTACHMENT_STORE_OP_STORE;
     attachment_description.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachment_description.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachment_description.initialLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachment_description.finalLayout             = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachment_description.finalLayout             = vk_final_layout;
 
     VkAttachmentReference attachment_reference = {0};
     attachment_reference.attachment            = 0;
@@ -97,6 +98,11 @@ bool renderpass_create(
     subpass_dependency.srcAccessMask       = 0;
     subpass_dependency.dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+    // Offscreen targets have no acquire semaphore, so order against the previous frame's writes.
+    if (vk_final_layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+        subpass_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    }
+
     VkRenderPassCreateInfo render_pass_create_info = {0};
     render_pass_create_info.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
     render_pass_create_info.attachmentCount        = 1;
@@ -116,11 +122,114 @@ bool renderpass_create(
         return false;
     }
 
-    renderpass->vk_color_format = swapchain->vk_image_format;
+    renderpass->vk_color_format = vk_color_format;
+    renderpass->vk_final_layout = vk_final_layout;
 
-    if (!renderpass_create_framebuffers(renderpass, device, swapchain)) {
-        vkDestroyRenderPass(device->vk_device, renderpass->vk_render_pass, NULL);
-        memset(renderpass, 0, sizeof(*renderpass));
+    return true;
+}
+
+static bool renderpass_create_targets(
+    renderpass_t      *renderpass,
+    const device_t    *device,
+    const VkImage     *vk_images,
+    const VkImageView *vk_image_views,
+    uint32_t           vk_image_count,
+    VkExtent2D         extent
+) {
+    renderpass->vk_images      = vk_images;
+    renderpass->vk_image_views = vk_image_views;
+    renderpass->vk_image_count = vk_image_count;
+
+    if (renderpass->dynamic_rendering) {
+        return true;
+    }
+
+    return renderpass_create_framebuffers(
+        renderpass, device, vk_image_views, vk_image_count, extent
+    );
+}
+
+bool renderpass_create_format(
+    renderpass_t   *renderpass,
+    const device_t *device,
+    VkFormat        vk_color_format,
+    VkImageLayout   vk_final_layout,
+    bool            dynamic_rendering
+) {
+    memset(renderpass, 0, sizeof(*renderpass));
+
+    if (dynamic_rendering && !device->has_dynamic_rendering) {
+        log_error("(RENDERPASS) dynamic rendering is not supported by the device.");
+        return false;
+    }
+
+    renderpass->dynamic_rendering = dynamic_rendering;
+
+    if (dynamic_rendering) {
+        renderpass->vk_color_format = vk_color_format;
+        renderpass->vk_final_layout = vk_final_layout;
+        return true;
+    }
+
+    return renderpass_create_core(renderpass, device, vk_color_format, vk_final_layout);
+}
+
+bool renderpass_create(
+    renderpass_t      *renderpass,
+    const device_t    *device,
+    const swapchain_t *swapchain,
+    bool               dynamic_rendering
+) {
+    if (!renderpass_create_format(
+            renderpass,
+            device,
+            swapchain->vk_image_format,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            dynamic_rendering
+        )) {
+        return false;
+    }
+
+    if (!renderpass_create_targets(
+            renderpass,
+            device,
+            swapchain->vk_images,
+            swapchain->vk_image_views,
+            swapchain->vk_image_count,
+            swapchain->extent
+        )) {
+        renderpass_destroy(renderpass, device);
+        return false;
+    }
+
+    return true;
+}
+
+bool renderpass_create_offscreen(
+    renderpass_t      *renderpass,
+    const device_t    *device,
+    const offscreen_t *offscreen,
+    bool               dynamic_rendering
+) {
+    if (!renderpass_create_format(
+            renderpass,
+            device,
+            offscreen->vk_image_format,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            dynamic_rendering
+        )) {
+        return false;
+    }
+
+    if (!renderpass_create_targets(
+            renderpass,
+            device,
+            offscreen->vk_images,
+            offscreen->vk_image_views,
+            offscreen->vk_image_count,
+            offscreen->extent
+        )) {
+        renderpass_destroy(renderpass, device);
         return false;
     }
 
@@ -141,19 +250,51 @@ void renderpass_destroy(renderpass_t *renderpass, const device_t *device) {
     memset(renderpass, 0, sizeof(*renderpass));
 }
 
+static void renderpass_retire_framebuffers(renderpass_t *renderpass, retire_entry_t *retired) {
+    assert(retired->vk_framebuffers == NULL);
+
+    retired->vk_framebuffers       = renderpass->vk_framebuffers;
+    retired->vk_framebuffers_count = renderpass->vk_framebuffers_count;
+
+    renderpass->vk_framebuffers       = NULL;
+    renderpass->vk_framebuffers_count = 0;
+}
+
+// Moves the render pass and its framebuffers into the retire entry instead of destroying them.
+void renderpass_retire(renderpass_t *renderpass, retire_entry_t *retired) {
+    assert(retired->vk_render_pass == VK_NULL_HANDLE);
+
+    renderpass_retire_framebuffers(renderpass, retired);
+    retired->vk_render_pass = renderpass->vk_render_pass;
+
+    memset(renderpass, 0, sizeof(*renderpass));
+}
+
+// With dynamic rendering this only picks up the new image views, no Vulkan objects change.
+// Otherwise the old framebuffers are retired, frames in flight may still use them.
 bool renderpass_recreate_framebuffers(
     renderpass_t      *renderpass,
     const device_t    *device,
-    const swapchain_t *swapchain
+    const swapchain_t *swapchain,
+    retire_entry_t    *retired
 ) {
     if (renderpass_has_format_mismatch(renderpass, swapchain)) {
         return false;
     }
 
-    return renderpass_create_framebuffers(renderpass, device, swapchain);
+    renderpass_retire_framebuffers(renderpass, retired);
+
+    return renderpass_create_targets(
+        renderpass,
+        device,
+        swapchain->vk_images,
+        swapchain->vk_image_views,
+        swapchain->vk_image_count,
+        swapchain->extent
+    );
 }
 
 bool renderpass_has_format_mismatch(const renderpass_t *renderpass, const swapchain_t *swapchain) {
-    return renderpass->vk_render_pass != VK_NULL_HANDLE
+    return (renderpass->vk_render_pass != VK_NULL_HANDLE || renderpass->dynamic_rendering)
         && renderpass->vk_color_format != swapchain->vk_image_format;
 }
@@ -0,0 +1,118 @@
+#include "vk/retire.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static bool retire_entry_is_empty(const retire_entry_t *entry) {
+    return entry->vk_swapchain == VK_NULL_HANDLE && entry->vk_images == NULL
+        && entry->vk_image_views == NULL && entry->vk_render_pass == VK_NULL_HANDLE
+        && entry->vk_framebuffers == NULL;
+}
+
+// Framebuffers go before their views and the swapchain last, after everything made from it.
+static void retire_entry_destroy(retire_entry_t *entry, const device_t *device) {
+    for (uint32_t i = 0; entry->vk_framebuffers != NULL && i < entry->vk_framebuffers_count; ++i) {
+        if (entry->vk_framebuffers[i] != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(device->vk_device, entry->vk_framebuffers[i], NULL);
+        }
+    }
+    free(entry->vk_framebuffers);
+
+    if (entry->vk_render_pass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(device->vk_device, entry->vk_render_pass, NULL);
+    }
+
+    for (uint32_t i = 0; entry->vk_image_views != NULL && i < entry->vk_image_views_count; ++i) {
+        if (entry->vk_image_views[i] != VK_NULL_HANDLE) {
+            vkDestroyImageView(device->vk_device, entry->vk_image_views[i], NULL);
+        }
+    }
+    free(entry->vk_image_views);
+    free(entry->vk_images);
+
+    if (entry->vk_swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(device->vk_device, entry->vk_swapchain, NULL);
+    }
+
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void retire_release(retire_t *retire, const device_t *device, uint32_t index) {
+    retire_entry_destroy(&retire->entries[index], device);
+
+    --retire->entries_count;
+    retire->entries[index] = retire->entries[retire->entries_count];
+    memset(&retire->entries[retire->entries_count], 0, sizeof(retire->entries[0]));
+}
+
+// Takes ownership of the entry's objects and clears it.
+void retire_push(
+    retire_t       *retire,
+    const device_t *device,
+    retire_entry_t *entry,
+    uint32_t        frame_count
+) {
+    assert(frame_count > 0 && frame_count < 32);
+
+    if (retire_entry_is_empty(entry)) {
+        return;
+    }
+
+    // Resizing faster than frames retire; the oldest entry is released after draining the GPU.
+    if (retire->entries_count == RETIRE_MAX_ENTRIES) {
+        VkResult res;
+        res = vkDeviceWaitIdle(device->vk_device);
+        if (res != VK_SUCCESS) {
+            log_error("(RETIRE) vkDeviceWaitIdle failed (%s).", vk_res_str(res));
+        }
+
+        retire_release(retire, device, 0);
+        ++retire->forced;
+    }
+
+    entry->pending_frames = (1U << frame_count) - 1U;
+
+    retire->entries[retire->entries_count++] = *entry;
+    ++retire->retired;
+
+    memset(entry, 0, sizeof(*entry));
+}
+
+// Called after the frame slot's fences were waited on.
+void retire_frame_waited(retire_t *retire, const device_t *device, uint32_t frame_index) {
+    for (uint32_t i = 0; i < retire->entries_count;) {
+        retire->entries[i].pending_frames &= ~(1U << frame_index);
+
+        if (retire->entries[i].pending_frames == 0) {
+            retire_release(retire, device, i);
+            ++retire->released;
+        } else {
+            ++i;
+        }
+    }
+}
+
+// The caller guarantees the device is idle.
+void retire_flush(retire_t *retire, const device_t *device) {
+    while (retire->entries_count > 0) {
+        retire_release(retire, device, retire->entries_count - 1);
+        ++retire->released;
+    }
+}
+
+void retire_log_stats(const retire_t *retire) {
+    if (retire->retired == 0) {
+        return;
+    }
+
+    log_debug(
+        "(RETIRE) %llu swapchains retired, %llu released, %llu forced by a full queue.",
+        (unsigned long long)retire->retired,
+        (unsigned long long)retire->released,
+        (unsigned long long)retire->forced
+    );
+}
@@ -127,8 +127,17 @@ static bool swapchain_support_create(
     return true;
 }
 
-static VkSurfaceFormatKHR swapchain_choose_format(const swapchain_support_t *swapchain_support) {
+static VkSurfaceFormatKHR swapchain_choose_format(
+    const swapchain_support_t *swapchain_support,
+    VkFormat                   requested_format
+) {
     assert(swapchain_support->vk_surface_formats_count > 0);
+    for (uint32_t i = 0; i < swapchain_support->vk_surface_formats_count; ++i) {
+        if (requested_format != VK_FORMAT_UNDEFINED
+            && swapchain_support->vk_surface_formats[i].format == requested_format) {
+            return swapchain_support->vk_surface_formats[i];
+        }
+    }
     for (uint32_t i = 0; i < swapchain_support->vk_surface_formats_count; ++i) {
         if (swapchain_support->vk_surface_formats[i].format == VK_FORMAT_B8G8R8A8_SRGB
             && swapchain_support->vk_surface_formats[i].colorSpace
@@ -140,13 +149,26 @@ static VkSurfaceFormatKHR swapchain_choose_format(const swapchain_support_t *swa
     return swapchain_support->vk_surface_formats[0];
 }
 
-static VkPresentModeKHR
-swapchain_choose_present_mode(const swapchain_support_t *swapchain_support) {
+static bool swapchain_supports_present_mode(
+    const swapchain_support_t *swapchain_support,
+    VkPresentModeKHR           present_mode
+) {
     for (uint32_t i = 0; i < swapchain_support->vk_present_modes_count; ++i) {
-        if (swapchain_support->vk_present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return VK_PRESENT_MODE_MAILBOX_KHR;
+        if (swapchain_support->vk_present_modes[i] == present_mode) {
+            return true;
         }
     }
+    return false;
+}
+
+// The preferred mode if the surface offers it, FIFO otherwise, which is always available.
+static VkPresentModeKHR swapchain_choose_present_mode(
+    const swapchain_support_t *swapchain_support,
+    VkPresentModeKHR           preferred
+) {
+    if (swapchain_supports_present_mode(swapchain_support, preferred)) {
+        return preferred;
+    }
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -179,6 +201,156 @@ static VkExtent2D swapchain_choose_extent(
     return extent;
 }
 
+static void swapchain_clamp_extent(VkExtent2D *extent, VkExtent2D min, VkExtent2D max) {
+    extent->width  = extent->width < min.width ? min.width : extent->width;
+    extent->width  = extent->width > max.width ? max.width : extent->width;
+    extent->height = extent->height < min.height ? min.height : extent->height;
+    extent->height = extent->height > max.height ? max.height : extent->height;
+}
+
+// surface_maintenance1 reports some capabilities per present mode, returned through the chain.
+static bool swapchain_query_mode_capabilities(
+    VkPhysicalDevice vk_physical_device,
+    VkSurfaceKHR     vk_surface,
+    VkPresentModeKHR present_mode,
+    void            *capabilities_chain
+) {
+    VkSurfacePresentModeEXT surface_present_mode = {0};
+    surface_present_mode.sType                   = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_EXT;
+    surface_present_mode.presentMode             = present_mode;
+
+    VkPhysicalDeviceSurfaceInfo2KHR surface_info = {0};
+    surface_info.sType   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SURFACE_INFO_2_KHR;
+    surface_info.pNext   = &surface_present_mode;
+    surface_info.surface = vk_surface;
+
+    VkSurfaceCapabilities2KHR surface_capabilities = {0};
+    surface_capabilities.sType = VK_STRUCTURE_TYPE_SURFACE_CAPABILITIES_2_KHR;
+    surface_capabilities.pNext = capabilities_chain;
+
+    VkResult res;
+    res = vkGetPhysicalDeviceSurfaceCapabilities2KHR(
+        vk_physical_device, &surface_info, &surface_capabilities
+    );
+    if (res != VK_SUCCESS) {
+        log_error(
+            "(SWAPCHAIN) vkGetPhysicalDeviceSurfaceCapabilities2KHR failed (%s).", vk_res_str(res)
+        );
+        return false;
+    }
+
+    return true;
+}
+
+// Modes the swapchain can switch to per present without recreation. Always contains the chosen
+// mode first and only modes the surface supports.
+static uint32_t swapchain_query_compatible_modes(
+    VkPhysicalDevice           vk_physical_device,
+    VkSurfaceKHR               vk_surface,
+    const swapchain_support_t *swapchain_support,
+    VkPresentModeKHR           present_mode,
+    VkPresentModeKHR          *present_modes
+) {
+    VkPresentModeKHR compatible_modes[SWAPCHAIN_MAX_PRESENT_MODES];
+
+    VkSurfacePresentModeCompatibilityEXT compatibility = {0};
+    compatibility.sType            = VK_STRUCTURE_TYPE_SURFACE_PRESENT_MODE_COMPATIBILITY_EXT;
+    compatibility.presentModeCount = SWAPCHAIN_MAX_PRESENT_MODES;
+    compatibility.pPresentModes    = compatible_modes;
+
+    uint32_t count         = 0;
+    present_modes[count++] = present_mode;
+
+    if (!swapchain_query_mode_capabilities(
+            vk_physical_device, vk_surface, present_mode, &compatibility
+        )) {
+        return count;
+    }
+
+    for (uint32_t i = 0; i < compatibility.presentModeCount; ++i) {
+        if (compatible_modes[i] != present_mode
+            && swapchain_supports_present_mode(swapchain_support, compatible_modes[i])) {
+            present_modes[count++] = compatible_modes[i];
+        }
+    }
+
+    return count;
+}
+
+// Scaling must be supported by every mode the swapchain may present with, so the capabilities
+// are intersected. Returns false if no scaling is left.
+static bool swapchain_query_present_scaling(
+    VkPhysicalDevice                        vk_physical_device,
+    VkSurfaceKHR                            vk_surface,
+    const VkPresentModeKHR                 *present_modes,
+    uint32_t                                present_modes_count,
+    VkSurfacePresentScalingCapabilitiesEXT *scaling_capabilities
+) {
+    for (uint32_t i = 0; i < present_modes_count; ++i) {
+        VkSurfacePresentScalingCapabilitiesEXT mode_capabilities = {0};
+        mode_capabilities.sType = VK_STRUCTURE_TYPE_SURFACE_PRESENT_SCALING_CAPABILITIES_EXT;
+
+        if (!swapchain_query_mode_capabilities(
+                vk_physical_device, vk_surface, present_modes[i], &mode_capabilities
+            )) {
+            return false;
+        }
+
+        if (i == 0) {
+            *scaling_capabilities = mode_capabilities;
+            continue;
+        }
+
+        VkSurfacePresentScalingCapabilitiesEXT *caps = scaling_capabilities;
+
+        caps->supportedPresentScaling &= mode_capabilities.supportedPresentScaling;
+        caps->supportedPresentGravityX &= mode_capabilities.supportedPresentGravityX;
+        caps->supportedPresentGravityY &= mode_capabilities.supportedPresentGravityY;
+        swapchain_clamp_extent(
+            &caps->minScaledImageExtent,
+            mode_capabilities.minScaledImageExtent,
+            mode_capabilities.maxScaledImageExtent
+        );
+        swapchain_clamp_extent(
+            &caps->maxScaledImageExtent,
+            mode_capabilities.minScaledImageExtent,
+            mode_capabilities.maxScaledImageExtent
+        );
+    }
+
+    return present_modes_count > 0 && scaling_capabilities->supportedPresentScaling != 0;
+}
+
+// Aspect-preserving stretch keeps the image undistorted during a drag, plain stretch fills the
+// window, one-to-one at least avoids a recreate.
+static VkPresentScalingFlagsEXT
+swapchain_choose_present_scaling(const VkSurfacePresentScalingCapabilitiesEXT *capabilities) {
+    const VkPresentScalingFlagsEXT preferred[] = {
+        VK_PRESENT_SCALING_ASPECT_RATIO_STRETCH_BIT_EXT,
+        VK_PRESENT_SCALING_STRETCH_BIT_EXT,
+        VK_PRESENT_SCALING_ONE_TO_ONE_BIT_EXT,
+    };
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); ++i) {
+        if ((capabilities->supportedPresentScaling & preferred[i]) != 0) {
+            return preferred[i];
+        }
+    }
+
+    return 0;
+}
+
+static VkPresentGravityFlagsEXT
+swapchain_choose_present_gravity(VkPresentGravityFlagsEXT supported) {
+    if ((supported & VK_PRESENT_GRAVITY_CENTERED_BIT_EXT) != 0) {
+        return VK_PRESENT_GRAVITY_CENTERED_BIT_EXT;
+    }
+    if ((supported & VK_PRESENT_GRAVITY_MIN_BIT_EXT) != 0) {
+        return VK_PRESENT_GRAVITY_MIN_BIT_EXT;
+    }
+
+    return supported & VK_PRESENT_GRAVITY_MAX_BIT_EXT;
+}
+
 static bool swapchain_create_image_views(swapchain_t *swapchain, const device_t *device) {
     swapchain->vk_image_views
         = (VkImageView *)malloc(swapchain->vk_image_count * sizeof(*swapchain->vk_image_views));
@@ -246,15 +418,34 @@ static bool swapchain_create_core(
         return false;
     }
 
-    VkSurfaceFormatKHR format       = swapchain_choose_format(&swapchain_support);
-    VkPresentModeKHR   present_mode = swapchain_choose_present_mode(&swapchain_support);
+    VkSurfaceFormatKHR format
+        = swapchain_choose_format(&swapchain_support, swapchain->vk_format_requested);
+    VkPresentModeKHR   present_mode
+        = swapchain_choose_present_mode(&swapchain_support, swapchain->vk_present_mode);
     VkExtent2D         extent       = swapchain_choose_extent(&swapchain_support, window);
 
-    uint32_t image_count = swapchain_support.vk_surface_capabilities.minImageCount + 1;
-    if (swapchain_support.vk_surface_capabilities.maxImageCount > 0) {
-        if (image_count > swapchain_support.vk_surface_capabilities.maxImageCount) {
-            image_count = swapchain_support.vk_surface_capabilities.maxImageCount;
-        }
+    const uint32_t surface_min_images = swapchain_support.vk_surface_capabilities.minImageCount;
+    const uint32_t surface_max_images = swapchain_support.vk_surface_capabilities.maxImageCount;
+
+    uint32_t image_count = swapchain->image_count_requested;
+    if (image_count == 0) {
+        image_count = surface_min_images + 1;
+    }
+    if (image_count < surface_min_images) {
+        image_count = surface_min_images;
+    }
+    if (surface_max_images > 0 && image_count > surface_max_images) {
+        image_count = surface_max_images;
+    }
+    if (swapchain->image_count_requested != 0 && image_count != swapchain->image_count_requested) {
+        log_warn(
+            "(SWAPCHAIN) %u images requested, the surface allows %u..%u, using %u.",
+            swapchain->image_count_requested,
+            surface_min_images,
+            surface_max_images,
+            image_count
+        );
+        swapchain->image_count_requested = image_count;
     }
 
     VkSwapchainCreateInfoKHR swapchain_create_info = {0};
@@ -272,6 +463,57 @@ static bool swapchain_create_core(
     swapchain_create_info.clipped        = VK_TRUE;
     swapchain_create_info.oldSwapchain   = vk_old_swapchain;
 
+    VkPresentModeKHR present_modes[SWAPCHAIN_MAX_PRESENT_MODES];
+    uint32_t         present_modes_count = swapchain_query_compatible_modes(
+        device->vk_physical_device, vk_surface, &swapchain_support, present_mode, present_modes
+    );
+
+    VkSurfacePresentScalingCapabilitiesEXT scaling_capabilities = {0};
+
+    VkSwapchainPresentScalingCreateInfoEXT present_scaling_create_info = {0};
+    present_scaling_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_SCALING_CREATE_INFO_EXT;
+    if (swapchain->present_scaling_requested
+        && swapchain_query_present_scaling(
+            device->vk_physical_device,
+            vk_surface,
+            present_modes,
+            present_modes_count,
+            &scaling_capabilities
+        )) {
+        present_scaling_create_info.scalingBehavior
+            = swapchain_choose_present_scaling(&scaling_capabilities);
+        present_scaling_create_info.presentGravityX
+            = swapchain_choose_present_gravity(scaling_capabilities.supportedPresentGravityX);
+        present_scaling_create_info.presentGravityY
+            = swapchain_choose_present_gravity(scaling_capabilities.supportedPresentGravityY);
+        if (present_scaling_create_info.presentGravityX == 0
+            || present_scaling_create_info.presentGravityY == 0) {
+            present_scaling_create_info.presentGravityX = 0;
+            present_scaling_create_info.presentGravityY = 0;
+        }
+
+        swapchain_clamp_extent(
+            &swapchain_create_info.imageExtent,
+            scaling_capabilities.minScaledImageExtent,
+            scaling_capabilities.maxScaledImageExtent
+        );
+        extent                      = swapchain_create_info.imageExtent;
+        swapchain_create_info.pNext = &present_scaling_create_info;
+    } else if (swapchain->present_scaling_requested) {
+        log_warn("(SWAPCHAIN) present scaling unsupported, size changes recreate the swapchain.");
+        swapchain->present_scaling_requested = false;
+    }
+
+    // Lets the present mode change per present (swapchain_maintenance1).
+    VkSwapchainPresentModesCreateInfoEXT present_modes_create_info = {0};
+    present_modes_create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODES_CREATE_INFO_EXT;
+    present_modes_create_info.presentModeCount = present_modes_count;
+    present_modes_create_info.pPresentModes    = present_modes;
+    if (present_modes_count > 1) {
+        present_modes_create_info.pNext = swapchain_create_info.pNext;
+        swapchain_create_info.pNext     = &present_modes_create_info;
+    }
+
     uint32_t queue_family_indices[2]
         = {device->graphics_queue_familiy_index, device->present_queue_family_index};
     if (device->graphics_queue_familiy_index != device->present_queue_family_index) {
@@ -321,9 +563,19 @@ static bool swapchain_create_core(
         return false;
     }
 
-    swapchain->vk_image_count  = image_count;
-    swapchain->vk_image_format = format.format;
-    swapchain->extent          = extent;
+    swapchain->vk_image_count          = image_count;
+    swapchain->min_image_count         = swapchain_create_info.minImageCount;
+    swapchain->surface_min_image_count = surface_min_images;
+    swapchain->surface_max_image_count = surface_max_images;
+    swapchain->vk_image_format         = format.format;
+    swapchain->extent                  = extent;
+    swapchain->present_scaling         = present_scaling_create_info.scalingBehavior;
+    swapchain->vk_present_mode         = present_mode;
+
+    swapchain->vk_present_modes_count = present_modes_count;
+    memcpy(
+        swapchain->vk_present_modes, present_modes, present_modes_count * sizeof(present_modes[0])
+    );
 
     bool success = swapchain_create_image_views(swapchain, device);
     swapchain_support_destroy(&swapchain_support);
@@ -335,10 +587,17 @@ bool swapchain_create(
     swapchain_t             *swapchain,
     const device_t          *device,
     VkSurfaceKHR             vk_surface,
-    const platform_window_t *window
+    const platform_window_t *window,
+    VkPresentModeKHR         present_mode,
+    bool                     present_scaling,
+    uint32_t                 image_count
 ) {
     memset(swapchain, 0, sizeof(*swapchain));
 
+    swapchain->image_count_requested     = image_count;
+    swapchain->vk_present_mode           = present_mode;
+    swapchain->present_scaling_requested = present_scaling;
+
     if (!swapchain_create_core(swapchain, device, vk_surface, window, VK_NULL_HANDLE)) {
         swapchain_destroy(swapchain, device);
         return false;
@@ -347,11 +606,14 @@ bool swapchain_create(
     return true;
 }
 
+// Does not wait for the device. The old swapchain, its images and views are moved into the
+// retire entry, since frames still in flight may reference them.
 bool swapchain_recreate(
     swapchain_t             *swapchain,
     const device_t          *device,
     VkSurfaceKHR             vk_surface,
-    const platform_window_t *window
+    const platform_window_t *window,
+    retire_entry_t          *retired
 ) {
     uint32_t width  = 0;
     uint32_t height = 0;
@@ -362,42 +624,20 @@ bool swapchain_recreate(
         platform_window_framebuffer_size(window, &width, &height);
     }
 
-    VkResult res;
-    res = vkDeviceWaitIdle(device->vk_device);
-    if (res != VK_SUCCESS) {
-        log_error("(SWAPCHAIN) vkDeviceWaitIdle failed (%s).", vk_res_str(res));
-        swapchain_destroy(swapchain, device);
-        return false;
-    }
+    assert(retired->vk_swapchain == VK_NULL_HANDLE && retired->vk_image_views == NULL);
 
-    VkSwapchainKHR old_handle = swapchain->vk_swapchain;
-    VkImageView   *old_views  = swapchain->vk_image_views;
-    VkImage       *old_images = swapchain->vk_images;
-    uint32_t       old_count  = swapchain->vk_image_count;
+    retired->vk_swapchain         = swapchain->vk_swapchain;
+    retired->vk_images            = swapchain->vk_images;
+    retired->vk_image_views       = swapchain->vk_image_views;
+    retired->vk_image_views_count = swapchain->vk_image_count;
 
     swapchain->vk_swapchain   = VK_NULL_HANDLE;
     swapchain->vk_image_views = NULL;
     swapchain->vk_images      = NULL;
     swapchain->vk_image_count = 0;
+    swapchain->present_scaling = 0;
 
-    bool success = swapchain_create_core(swapchain, device, vk_surface, window, old_handle);
-
-    if (old_views != NULL) {
-        for (uint32_t i = 0; i < old_count; ++i) {
-            vkDestroyImageView(device->vk_device, old_views[i], NULL);
-        }
-        free(old_views);
-    }
-
-    if (old_images != NULL) {
-        free(old_images);
-    }
-
-    if (old_handle != VK_NULL_HANDLE) {
-        vkDestroySwapchainKHR(device->vk_device, old_handle, NULL);
-    }
-
-    return success;
+    return swapchain_create_core(swapchain, device, vk_surface, window, retired->vk_swapchain);
 }
 
 void swapchain_destroy(swapchain_t *swapchain, const device_t *device) {
@@ -422,3 +662,60 @@ void swapchain_destroy(swapchain_t *swapchain, const device_t *device) {
 
     memset(swapchain, 0, sizeof(*swapchain));
 }
+
+// Distinct formats the surface offers, in the order the surface reports them.
+uint32_t swapchain_surface_formats(
+    const device_t *device,
+    VkSurfaceKHR    vk_surface,
+    VkFormat       *vk_formats,
+    uint32_t        capacity
+) {
+    swapchain_support_t swapchain_support = {0};
+    if (!swapchain_support_create(device->vk_physical_device, vk_surface, &swapchain_support)) {
+        return 0;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < swapchain_support.vk_surface_formats_count && count < capacity; ++i) {
+        VkFormat format = swapchain_support.vk_surface_formats[i].format;
+
+        bool seen = false;
+        for (uint32_t j = 0; j < count; ++j) {
+            seen = seen || vk_formats[j] == format;
+        }
+        if (!seen) {
+            vk_formats[count++] = format;
+        }
+    }
+
+    swapchain_support_destroy(&swapchain_support);
+
+    return count;
+}
+
+// Takes effect with the next present. Only modes the swapchain was created with are accepted.
+bool swapchain_set_present_mode(swapchain_t *swapchain, VkPresentModeKHR present_mode) {
+    for (uint32_t i = 0; i < swapchain->vk_present_modes_count; ++i) {
+        if (swapchain->vk_present_modes[i] == present_mode) {
+            swapchain->vk_present_mode = present_mode;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *swapchain_present_mode_str(VkPresentModeKHR present_mode) {
+    switch (present_mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo-relaxed";
+    default:
+        return "unknown";
+    }
+}
@@ -7,85 +7,167 @@
 #include "util/log.h"
 #include "vk/debug.h"
 
-bool sync_create(sync_t *sync, const device_t *device, uint32_t frame_count) {
-    memset(sync, 0, sizeof(*sync));
+static bool sync_create_semaphores(
+    const device_t *device,
+    VkSemaphore    *vk_semaphores,
+    uint32_t        count,
+    const void     *next
+) {
+    VkSemaphoreCreateInfo semaphore_create_info = {0};
+    semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_create_info.pNext                 = next;
 
-    sync->frame_count = frame_count;
-    sync->vk_semaphore_image_available
-        = (VkSemaphore *)malloc(frame_count * sizeof(*sync->vk_semaphore_image_available));
-    if (sync->vk_semaphore_image_available == NULL) {
-        log_error("(SYNC) malloc failed.");
-        sync_destroy(sync, device);
-        return false;
-    }
-    sync->vk_semaphore_render_finished
-        = (VkSemaphore *)malloc(frame_count * sizeof(*sync->vk_semaphore_render_finished));
-    if (sync->vk_semaphore_render_finished == NULL) {
-        log_error("(SYNC) malloc failed.");
-        sync_destroy(sync, device);
-        return false;
-    }
-    sync->vk_fence_in_flight = (VkFence *)malloc(frame_count * sizeof(*sync->vk_fence_in_flight));
-    if (sync->vk_fence_in_flight == NULL) {
-        log_error("(SYNC) malloc failed.");
-        sync_destroy(sync, device);
-        return false;
-    }
-    sync->vk_fence_present_done
-        = (VkFence *)malloc(frame_count * sizeof(*sync->vk_fence_present_done));
-    if (sync->vk_fence_present_done == NULL) {
-        log_error("(SYNC) malloc failed.");
-        sync_destroy(sync, device);
-        return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        VkResult res;
+        res = vkCreateSemaphore(device->vk_device, &semaphore_create_info, NULL, &vk_semaphores[i]);
+        if (res != VK_SUCCESS) {
+            log_error("(SYNC) vkCreateSemaphore failed (%s).", vk_res_str(res));
+            vk_semaphores[i] = VK_NULL_HANDLE;
+            return false;
+        }
     }
 
-    VkSemaphoreCreateInfo semaphore_create_info = {0};
-    semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    return true;
+}
 
+static bool sync_create_fences(const device_t *device, VkFence *vk_fences, uint32_t count) {
     VkFenceCreateInfo fence_create_info = {0};
     fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fence_create_info.flags             = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (uint32_t i = 0; i < frame_count; ++i) {
+    for (uint32_t i = 0; i < count; ++i) {
         VkResult res;
-        res = vkCreateSemaphore(
-            device->vk_device, &semaphore_create_info, NULL, &sync->vk_semaphore_image_available[i]
-        );
+        res = vkCreateFence(device->vk_device, &fence_create_info, NULL, &vk_fences[i]);
         if (res != VK_SUCCESS) {
-            log_error("(SYNC) vkCreateSemaphore failed (%s).", vk_res_str(res));
-            sync->vk_semaphore_image_available = VK_NULL_HANDLE;
+            log_error("(SYNC) vkCreateFence failed (%s).", vk_res_str(res));
+            vk_fences[i] = VK_NULL_HANDLE;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void sync_destroy_semaphores(
+    const device_t *device,
+    VkSemaphore    *vk_semaphores,
+    uint32_t        count
+) {
+    if (vk_semaphores == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (vk_semaphores[i] != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device->vk_device, vk_semaphores[i], NULL);
+        }
+    }
+    free(vk_semaphores);
+}
+
+static void sync_destroy_fences(const device_t *device, VkFence *vk_fences, uint32_t count) {
+    if (vk_fences == NULL) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (vk_fences[i] != VK_NULL_HANDLE) {
+            vkDestroyFence(device->vk_device, vk_fences[i], NULL);
+        }
+    }
+    free(vk_fences);
+}
+
+bool sync_create(
+    sync_t         *sync,
+    const device_t *device,
+    sync_mode_t     mode,
+    uint32_t        frame_count,
+    uint32_t        image_count
+) {
+    memset(sync, 0, sizeof(*sync));
+
+    if (mode == SYNC_MODE_TIMELINE && !device->has_timeline_semaphore) {
+        log_warn("(SYNC) timeline semaphores not supported, falling back to fences.");
+        mode = SYNC_MODE_FENCE;
+    }
+
+    sync->mode        = mode;
+    sync->frame_count = frame_count;
+
+    // A frame's render finished semaphore is reused once its present fence has signaled.
+    // Without images nothing is presented.
+    const bool presents = image_count > 0;
+    if (presents) {
+        sync->render_finished_count = frame_count;
+
+        sync->vk_semaphore_image_available
+            = (VkSemaphore *)calloc(frame_count, sizeof(*sync->vk_semaphore_image_available));
+        if (sync->vk_semaphore_image_available == NULL) {
+            log_error("(SYNC) calloc failed.");
             sync_destroy(sync, device);
             return false;
         }
-        res = vkCreateSemaphore(
-            device->vk_device, &semaphore_create_info, NULL, &sync->vk_semaphore_render_finished[i]
+        sync->vk_semaphore_render_finished = (VkSemaphore *)calloc(
+            sync->render_finished_count, sizeof(*sync->vk_semaphore_render_finished)
         );
-        if (res != VK_SUCCESS) {
-            log_error("(SYNC) vkCreateSemaphore failed (%s).", vk_res_str(res));
-            sync->vk_semaphore_render_finished = VK_NULL_HANDLE;
+        if (sync->vk_semaphore_render_finished == NULL) {
+            log_error("(SYNC) calloc failed.");
             sync_destroy(sync, device);
             return false;
         }
-        res = vkCreateFence(
-            device->vk_device, &fence_create_info, NULL, &sync->vk_fence_in_flight[i]
-        );
-        if (res != VK_SUCCESS) {
-            log_error("(SYNC) vkCreateFence failed (%s).", vk_res_str(res));
-            sync->vk_fence_in_flight = VK_NULL_HANDLE;
+
+        if (!sync_create_semaphores(device, sync->vk_semaphore_image_available, frame_count, NULL)
+            || !sync_create_semaphores(
+                device, sync->vk_semaphore_render_finished, sync->render_finished_count, NULL
+            )) {
             sync_destroy(sync, device);
             return false;
         }
-        res = vkCreateFence(
-            device->vk_device, &fence_create_info, NULL, &sync->vk_fence_present_done[i]
-        );
-        if (res != VK_SUCCESS) {
-            log_error("(SYNC) vkCreateFence failed (%s).", vk_res_str(res));
-            sync->vk_fence_present_done = VK_NULL_HANDLE;
+    }
+
+    if (mode == SYNC_MODE_TIMELINE) {
+        VkSemaphoreTypeCreateInfo semaphore_type_create_info = {0};
+        semaphore_type_create_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        semaphore_type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        semaphore_type_create_info.initialValue  = 0;
+
+        if (!sync_create_semaphores(device, &sync->vk_timeline, 1, &semaphore_type_create_info)) {
+            sync_destroy(sync, device);
+            return false;
+        }
+    } else {
+        sync->vk_fence_in_flight
+            = (VkFence *)calloc(frame_count, sizeof(*sync->vk_fence_in_flight));
+        if (sync->vk_fence_in_flight == NULL) {
+            log_error("(SYNC) calloc failed.");
+            sync_destroy(sync, device);
+            return false;
+        }
+
+        if (!sync_create_fences(device, sync->vk_fence_in_flight, frame_count)) {
             sync_destroy(sync, device);
             return false;
         }
     }
 
+    if (!presents) {
+        return true;
+    }
+
+    sync->vk_fence_present_done
+        = (VkFence *)calloc(frame_count, sizeof(*sync->vk_fence_present_done));
+    if (sync->vk_fence_present_done == NULL) {
+        log_error("(SYNC) calloc failed.");
+        sync_destroy(sync, device);
+        return false;
+    }
+
+    if (!sync_create_fences(device, sync->vk_fence_present_done, frame_count)) {
+        sync_destroy(sync, device);
+        return false;
+    }
+
     return true;
 }
 
@@ -94,41 +176,175 @@ void sync_destroy(sync_t *sync, const device_t *device) {
         return;
     }
 
-    if (sync->vk_semaphore_image_available != NULL) {
-        for (uint32_t i = 0; i < sync->frame_count; ++i) {
-            if (sync->vk_semaphore_image_available[i] != VK_NULL_HANDLE) {
-                vkDestroySemaphore(device->vk_device, sync->vk_semaphore_image_available[i], NULL);
+    sync_destroy_semaphores(device, sync->vk_semaphore_image_available, sync->frame_count);
+    sync_destroy_semaphores(
+        device, sync->vk_semaphore_render_finished, sync->render_finished_count
+    );
+    sync_destroy_fences(device, sync->vk_fence_in_flight, sync->frame_count);
+    sync_destroy_fences(device, sync->vk_fence_present_done, sync->frame_count);
+
+    if (sync->vk_timeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device->vk_device, sync->vk_timeline, NULL);
+    }
+
+    memset(sync, 0, sizeof(*sync));
+}
+
+bool sync_wait_frame(sync_t *sync, const device_t *device, uint32_t frame_index) {
+    assert(frame_index < sync->frame_count);
+
+    ++sync->stats.frames;
+
+    VkResult res;
+    if (sync->mode == SYNC_MODE_TIMELINE) {
+        if (sync->timeline_value >= sync->frame_count) {
+            uint64_t wait_value = sync->timeline_value + 1 - sync->frame_count;
+
+            VkSemaphoreWaitInfo semaphore_wait_info = {0};
+            semaphore_wait_info.sType               = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            semaphore_wait_info.semaphoreCount      = 1;
+            semaphore_wait_info.pSemaphores         = &sync->vk_timeline;
+            semaphore_wait_info.pValues             = &wait_value;
+
+            ++sync->stats.host_waits;
+            res = vkWaitSemaphores(device->vk_device, &semaphore_wait_info, UINT64_MAX);
+            if (res != VK_SUCCESS) {
+                log_error("(SYNC) vkWaitSemaphores failed (%s).", vk_res_str(res));
+                return false;
             }
         }
-        free(sync->vk_semaphore_image_available);
+    } else {
+        ++sync->stats.host_waits;
+        res = vkWaitForFences(
+            device->vk_device, 1, &sync->vk_fence_in_flight[frame_index], VK_TRUE, UINT64_MAX
+        );
+        if (res != VK_SUCCESS) {
+            log_error("(SYNC) vkWaitForFences failed (%s).", vk_res_str(res));
+            return false;
+        }
     }
 
-    if (sync->vk_semaphore_render_finished != NULL) {
-        for (uint32_t i = 0; i < sync->frame_count; ++i) {
-            if (sync->vk_semaphore_render_finished[i] != VK_NULL_HANDLE) {
-                vkDestroySemaphore(device->vk_device, sync->vk_semaphore_render_finished[i], NULL);
-            }
+    if (sync->vk_fence_present_done == NULL) {
+        return true;
+    }
+
+    // The present of frame_count frames ago has almost always finished, so timeline mode
+    // checks the fence before blocking on it.
+    if (sync->mode == SYNC_MODE_TIMELINE) {
+        ++sync->stats.present_polls;
+        res = vkGetFenceStatus(device->vk_device, sync->vk_fence_present_done[frame_index]);
+        if (res == VK_SUCCESS) {
+            return true;
+        }
+        if (res != VK_NOT_READY) {
+            log_error("(SYNC) vkGetFenceStatus failed (%s).", vk_res_str(res));
+            return false;
         }
-        free(sync->vk_semaphore_render_finished);
     }
 
-    if (sync->vk_fence_in_flight != NULL) {
-        for (uint32_t i = 0; i < sync->frame_count; ++i) {
-            if (sync->vk_fence_in_flight[i] != VK_NULL_HANDLE) {
-                vkDestroyFence(device->vk_device, sync->vk_fence_in_flight[i], NULL);
-            }
+    ++sync->stats.present_waits;
+    res = vkWaitForFences(
+        device->vk_device, 1, &sync->vk_fence_present_done[frame_index], VK_TRUE, UINT64_MAX
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(SYNC) vkWaitForFences failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+bool sync_reset_frame(sync_t *sync, const device_t *device, uint32_t frame_index) {
+    assert(frame_index < sync->frame_count);
+
+    VkResult res;
+    if (sync->mode == SYNC_MODE_FENCE) {
+        ++sync->stats.host_resets;
+        res = vkResetFences(device->vk_device, 1, &sync->vk_fence_in_flight[frame_index]);
+        if (res != VK_SUCCESS) {
+            log_error("(SYNC) vkResetFences failed (%s).", vk_res_str(res));
+            return false;
         }
-        free(sync->vk_fence_in_flight);
     }
 
-    if (sync->vk_fence_present_done != NULL) {
-        for (uint32_t i = 0; i < sync->frame_count; ++i) {
-            if (sync->vk_fence_present_done[i] != VK_NULL_HANDLE) {
-                vkDestroyFence(device->vk_device, sync->vk_fence_present_done[i], NULL);
-            }
+    if (sync->vk_fence_present_done == NULL) {
+        return true;
+    }
+
+    ++sync->stats.present_resets;
+    res = vkResetFences(device->vk_device, 1, &sync->vk_fence_present_done[frame_index]);
+    if (res != VK_SUCCESS) {
+        log_error("(SYNC) vkResetFences failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+// Waits for every submitted frame, without draining the presentation engine or other queues.
+bool sync_wait_all(const sync_t *sync, const device_t *device) {
+    VkResult res;
+    if (sync->mode == SYNC_MODE_TIMELINE) {
+        VkSemaphoreWaitInfo semaphore_wait_info = {0};
+        semaphore_wait_info.sType               = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        semaphore_wait_info.semaphoreCount      = 1;
+        semaphore_wait_info.pSemaphores         = &sync->vk_timeline;
+        semaphore_wait_info.pValues             = &sync->timeline_value;
+
+        res = vkWaitSemaphores(device->vk_device, &semaphore_wait_info, UINT64_MAX);
+        if (res != VK_SUCCESS) {
+            log_error("(SYNC) vkWaitSemaphores failed (%s).", vk_res_str(res));
+            return false;
         }
-        free(sync->vk_fence_present_done);
+
+        return true;
     }
 
-    memset(sync, 0, sizeof(*sync));
+    res = vkWaitForFences(
+        device->vk_device, sync->frame_count, sync->vk_fence_in_flight, VK_TRUE, UINT64_MAX
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(SYNC) vkWaitForFences failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+void sync_log_stats(const sync_t *sync) {
+    if (sync->stats.frames == 0) {
+        return;
+    }
+
+    const double frames = (double)sync->stats.frames;
+
+    log_debug(
+        "(SYNC) %s mode: %.2f host waits + %.2f host resets per frame (%llu frames).",
+        sync_mode_str(sync->mode),
+        (double)sync->stats.host_waits / frames,
+        (double)sync->stats.host_resets / frames,
+        (unsigned long long)sync->stats.frames
+    );
+
+    if (sync->vk_fence_present_done == NULL) {
+        return;
+    }
+
+    log_debug(
+        "(SYNC) present fences: %.2f polls + %.2f waits + %.2f resets per frame.",
+        (double)sync->stats.present_polls / frames,
+        (double)sync->stats.present_waits / frames,
+        (double)sync->stats.present_resets / frames
+    );
+}
+
+const char *sync_mode_str(sync_mode_t mode) {
+    switch (mode) {
+    case SYNC_MODE_FENCE:
+        return "fence";
+    case SYNC_MODE_TIMELINE:
+        return "timeline";
+    default:
+        return "unknown";
+    }
 }
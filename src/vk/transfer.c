@@ -0,0 +1,517 @@
+#include "vk/transfer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static bool transfer_create_pool(const device_t *device, uint32_t family, VkCommandPool *vk_pool) {
+    VkCommandPoolCreateInfo command_pool_create_info = {0};
+    command_pool_create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    command_pool_create_info.flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    command_pool_create_info.queueFamilyIndex = family;
+
+    VkResult res;
+    res = vkCreateCommandPool(device->vk_device, &command_pool_create_info, NULL, vk_pool);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkCreateCommandPool failed (%s).", vk_res_str(res));
+        *vk_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+static bool transfer_begin_buffer(
+    const device_t  *device,
+    VkCommandPool    vk_pool,
+    VkCommandBuffer *command_buffer
+) {
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {0};
+    command_buffer_allocate_info.sType       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_allocate_info.commandPool = vk_pool;
+    command_buffer_allocate_info.level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_allocate_info.commandBufferCount = 1;
+
+    VkResult res;
+    res = vkAllocateCommandBuffers(
+        device->vk_device, &command_buffer_allocate_info, command_buffer
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkAllocateCommandBuffers failed (%s).", vk_res_str(res));
+        *command_buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {0};
+    command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    res = vkBeginCommandBuffer(*command_buffer, &command_buffer_begin_info);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkBeginCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+static void transfer_buffer_barrier(
+    VkCommandBuffer      command_buffer,
+    VkBuffer             vk_buffer,
+    uint32_t             src_family,
+    uint32_t             dst_family,
+    VkPipelineStageFlags src_stage,
+    VkAccessFlags        src_access,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+) {
+    VkBufferMemoryBarrier buffer_memory_barrier = {0};
+    buffer_memory_barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    buffer_memory_barrier.srcAccessMask         = src_access;
+    buffer_memory_barrier.dstAccessMask         = dst_access;
+    buffer_memory_barrier.srcQueueFamilyIndex   = src_family;
+    buffer_memory_barrier.dstQueueFamilyIndex   = dst_family;
+    buffer_memory_barrier.buffer                = vk_buffer;
+    buffer_memory_barrier.offset                = 0;
+    buffer_memory_barrier.size                  = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+        command_buffer, src_stage, dst_stage, 0, 0, NULL, 1, &buffer_memory_barrier, 0, NULL
+    );
+}
+
+static void transfer_job_destroy(transfer_t *transfer, transfer_job_t *job) {
+    const device_t *device = transfer->device;
+
+    if (job->vk_transfer_buffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(
+            device->vk_device, transfer->vk_transfer_pool, 1, &job->vk_transfer_buffer
+        );
+    }
+    if (job->vk_acquire_buffer != VK_NULL_HANDLE) {
+        vkFreeCommandBuffers(
+            device->vk_device, transfer->vk_graphics_pool, 1, &job->vk_acquire_buffer
+        );
+    }
+    if (job->vk_semaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device->vk_device, job->vk_semaphore, NULL);
+    }
+    if (job->vk_fence != VK_NULL_HANDLE) {
+        vkDestroyFence(device->vk_device, job->vk_fence, NULL);
+    }
+    if (job->staging_buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device->vk_device, job->staging_buffer, NULL);
+    }
+    memory_free(transfer->memory, &job->staging_allocation);
+
+    memset(job, 0, sizeof(*job));
+}
+
+static bool transfer_create_staging(
+    transfer_t     *transfer,
+    transfer_job_t *job,
+    const void     *data,
+    VkDeviceSize    size
+) {
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size               = size;
+    buffer_create_info.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_create_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult res;
+    res = vkCreateBuffer(
+        transfer->device->vk_device, &buffer_create_info, NULL, &job->staging_buffer
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkCreateBuffer failed (%s).", vk_res_str(res));
+        job->staging_buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!memory_alloc_buffer(
+            transfer->memory,
+            job->staging_buffer,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            0,
+            MEMORY_STRATEGY_LINEAR,
+            &job->staging_allocation
+        )) {
+        log_error("(TRANSFER) failed to allocate staging memory.");
+        return false;
+    }
+
+    memcpy(job->staging_allocation.mapped, data, size);
+
+    return true;
+}
+
+static bool transfer_create_sync(const device_t *device, transfer_job_t *job, bool semaphore) {
+    VkFenceCreateInfo fence_create_info = {0};
+    fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkResult res;
+    res = vkCreateFence(device->vk_device, &fence_create_info, NULL, &job->vk_fence);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkCreateFence failed (%s).", vk_res_str(res));
+        job->vk_fence = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!semaphore) {
+        return true;
+    }
+
+    VkSemaphoreCreateInfo semaphore_create_info = {0};
+    semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    res = vkCreateSemaphore(device->vk_device, &semaphore_create_info, NULL, &job->vk_semaphore);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkCreateSemaphore failed (%s).", vk_res_str(res));
+        job->vk_semaphore = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+// Copy and release on the transfer queue, then acquire on the graphics queue once the
+// semaphore signals. The acquire submission carries the fence, so it covers both. A concurrent
+// buffer changes no owner, the barriers then only order the copy before the reads.
+static bool transfer_submit_dedicated(
+    transfer_t          *transfer,
+    transfer_job_t      *job,
+    VkBuffer             dst_buffer,
+    VkBufferCopy         buffer_copy,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access,
+    bool                 concurrent
+) {
+    const device_t *device = transfer->device;
+
+    uint32_t src_family = device->transfer_queue_family_index;
+    uint32_t dst_family = device->graphics_queue_familiy_index;
+    if (concurrent) {
+        src_family = VK_QUEUE_FAMILY_IGNORED;
+        dst_family = VK_QUEUE_FAMILY_IGNORED;
+    }
+
+    if (!transfer_begin_buffer(device, transfer->vk_transfer_pool, &job->vk_transfer_buffer)) {
+        return false;
+    }
+    vkCmdCopyBuffer(job->vk_transfer_buffer, job->staging_buffer, dst_buffer, 1, &buffer_copy);
+    transfer_buffer_barrier(
+        job->vk_transfer_buffer,
+        dst_buffer,
+        src_family,
+        dst_family,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0
+    );
+
+    VkResult res;
+    res = vkEndCommandBuffer(job->vk_transfer_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkEndCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    if (!transfer_begin_buffer(device, transfer->vk_graphics_pool, &job->vk_acquire_buffer)) {
+        return false;
+    }
+    transfer_buffer_barrier(
+        job->vk_acquire_buffer,
+        dst_buffer,
+        src_family,
+        dst_family,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        0,
+        dst_stage,
+        dst_access
+    );
+
+    res = vkEndCommandBuffer(job->vk_acquire_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkEndCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    VkSubmitInfo transfer_submit_info         = {0};
+    transfer_submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transfer_submit_info.commandBufferCount   = 1;
+    transfer_submit_info.pCommandBuffers      = &job->vk_transfer_buffer;
+    transfer_submit_info.signalSemaphoreCount = 1;
+    transfer_submit_info.pSignalSemaphores    = &job->vk_semaphore;
+
+    res = vkQueueSubmit(device->transfer_queue, 1, &transfer_submit_info, VK_NULL_HANDLE);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkQueueSubmit failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    VkSubmitInfo acquire_submit_info       = {0};
+    acquire_submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquire_submit_info.waitSemaphoreCount = 1;
+    acquire_submit_info.pWaitSemaphores    = &job->vk_semaphore;
+    acquire_submit_info.pWaitDstStageMask  = &dst_stage;
+    acquire_submit_info.commandBufferCount = 1;
+    acquire_submit_info.pCommandBuffers    = &job->vk_acquire_buffer;
+
+    res = vkQueueSubmit(device->graphics_queue, 1, &acquire_submit_info, job->vk_fence);
+    if (res != VK_SUCCESS) {
+        // The semaphore is signalled but never waited on; idle before destroying it.
+        log_error("(TRANSFER) vkQueueSubmit failed (%s).", vk_res_str(res));
+        vkQueueWaitIdle(device->transfer_queue);
+        return false;
+    }
+
+    return true;
+}
+
+// Same family: one submission on the graphics queue, ordered before later ones by a barrier.
+static bool transfer_submit_shared(
+    transfer_t          *transfer,
+    transfer_job_t      *job,
+    VkBuffer             dst_buffer,
+    VkBufferCopy         buffer_copy,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+) {
+    const device_t *device = transfer->device;
+
+    if (!transfer_begin_buffer(device, transfer->vk_transfer_pool, &job->vk_transfer_buffer)) {
+        return false;
+    }
+    vkCmdCopyBuffer(job->vk_transfer_buffer, job->staging_buffer, dst_buffer, 1, &buffer_copy);
+    transfer_buffer_barrier(
+        job->vk_transfer_buffer,
+        dst_buffer,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        dst_stage,
+        dst_access
+    );
+
+    VkResult res;
+    res = vkEndCommandBuffer(job->vk_transfer_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkEndCommandBuffer failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    VkSubmitInfo submit_info       = {0};
+    submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers    = &job->vk_transfer_buffer;
+
+    res = vkQueueSubmit(device->graphics_queue, 1, &submit_info, job->vk_fence);
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkQueueSubmit failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return true;
+}
+
+bool transfer_create(transfer_t *transfer, const device_t *device, memory_t *memory) {
+    memset(transfer, 0, sizeof(*transfer));
+
+    transfer->device    = device;
+    transfer->memory    = memory;
+    transfer->dedicated
+        = device->transfer_queue_family_index != device->graphics_queue_familiy_index;
+
+    if (!transfer_create_pool(
+            device, device->transfer_queue_family_index, &transfer->vk_transfer_pool
+        )) {
+        transfer_destroy(transfer);
+        return false;
+    }
+
+    if (transfer->dedicated
+        && !transfer_create_pool(
+            device, device->graphics_queue_familiy_index, &transfer->vk_graphics_pool
+        )) {
+        transfer_destroy(transfer);
+        return false;
+    }
+
+    return true;
+}
+
+void transfer_destroy(transfer_t *transfer) {
+    if (transfer == NULL || transfer->device == NULL) {
+        return;
+    }
+
+    transfer_wait_all(transfer);
+    for (uint32_t i = 0; i < transfer->jobs_count; ++i) {
+        transfer_job_destroy(transfer, &transfer->jobs[i]);
+    }
+
+    if (transfer->vk_graphics_pool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(transfer->device->vk_device, transfer->vk_graphics_pool, NULL);
+    }
+    if (transfer->vk_transfer_pool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(transfer->device->vk_device, transfer->vk_transfer_pool, NULL);
+    }
+
+    memset(transfer, 0, sizeof(*transfer));
+}
+
+static bool transfer_upload(
+    transfer_t          *transfer,
+    VkBuffer             dst_buffer,
+    VkDeviceSize         dst_offset,
+    const void          *data,
+    VkDeviceSize         size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access,
+    bool                 concurrent
+) {
+    if (!transfer_collect(transfer)) {
+        return false;
+    }
+    if (transfer->jobs_count == TRANSFER_MAX_JOBS) {
+        VkResult res;
+        res = vkWaitForFences(
+            transfer->device->vk_device, 1, &transfer->jobs[0].vk_fence, VK_TRUE, UINT64_MAX
+        );
+        if (res != VK_SUCCESS) {
+            log_error("(TRANSFER) vkWaitForFences failed (%s).", vk_res_str(res));
+            return false;
+        }
+        if (!transfer_collect(transfer)) {
+            return false;
+        }
+    }
+
+    transfer_job_t *job = &transfer->jobs[transfer->jobs_count];
+    memset(job, 0, sizeof(*job));
+
+    VkBufferCopy buffer_copy = {0};
+    buffer_copy.srcOffset    = 0;
+    buffer_copy.dstOffset    = dst_offset;
+    buffer_copy.size         = size;
+
+    bool ok = transfer_create_staging(transfer, job, data, size)
+           && transfer_create_sync(transfer->device, job, transfer->dedicated);
+    if (ok && transfer->dedicated) {
+        ok = transfer_submit_dedicated(
+            transfer, job, dst_buffer, buffer_copy, dst_stage, dst_access, concurrent
+        );
+    } else if (ok) {
+        ok = transfer_submit_shared(transfer, job, dst_buffer, buffer_copy, dst_stage, dst_access);
+    }
+    if (!ok) {
+        transfer_job_destroy(transfer, job);
+        return false;
+    }
+
+    ++transfer->jobs_count;
+    ++transfer->uploads;
+    transfer->bytes += size;
+
+    return true;
+}
+
+// Not thread-safe: it submits to the graphics queue, so call it from the thread that draws.
+bool transfer_upload_buffer(
+    transfer_t          *transfer,
+    VkBuffer             dst_buffer,
+    VkDeviceSize         dst_offset,
+    const void          *data,
+    VkDeviceSize         size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+) {
+    return transfer_upload(
+        transfer, dst_buffer, dst_offset, data, size, dst_stage, dst_access, false
+    );
+}
+
+bool transfer_upload_concurrent_buffer(
+    transfer_t          *transfer,
+    VkBuffer             dst_buffer,
+    VkDeviceSize         dst_offset,
+    const void          *data,
+    VkDeviceSize         size,
+    VkPipelineStageFlags dst_stage,
+    VkAccessFlags        dst_access
+) {
+    return transfer_upload(
+        transfer, dst_buffer, dst_offset, data, size, dst_stage, dst_access, true
+    );
+}
+
+bool transfer_collect(transfer_t *transfer) {
+    uint32_t kept = 0;
+    bool     ok   = true;
+
+    for (uint32_t i = 0; i < transfer->jobs_count; ++i) {
+        transfer_job_t *job = &transfer->jobs[i];
+
+        VkResult res;
+        res = vkGetFenceStatus(transfer->device->vk_device, job->vk_fence);
+        if (res == VK_SUCCESS) {
+            transfer_job_destroy(transfer, job);
+            continue;
+        }
+        if (res != VK_NOT_READY) {
+            log_error("(TRANSFER) vkGetFenceStatus failed (%s).", vk_res_str(res));
+            ok = false;
+        }
+
+        // Oldest first, so a full queue waits on the upload most likely to be done.
+        if (kept != i) {
+            transfer->jobs[kept] = *job;
+            memset(job, 0, sizeof(*job));
+        }
+        ++kept;
+    }
+    transfer->jobs_count = kept;
+
+    return ok;
+}
+
+bool transfer_wait_all(transfer_t *transfer) {
+    if (transfer->jobs_count == 0) {
+        return true;
+    }
+
+    VkFence vk_fences[TRANSFER_MAX_JOBS];
+    for (uint32_t i = 0; i < transfer->jobs_count; ++i) {
+        vk_fences[i] = transfer->jobs[i].vk_fence;
+    }
+
+    VkResult res;
+    res = vkWaitForFences(
+        transfer->device->vk_device, transfer->jobs_count, vk_fences, VK_TRUE, UINT64_MAX
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(TRANSFER) vkWaitForFences failed (%s).", vk_res_str(res));
+        return false;
+    }
+
+    return transfer_collect(transfer);
+}
+
+void transfer_log_stats(const transfer_t *transfer) {
+    if (transfer->uploads == 0) {
+        return;
+    }
+
+    log_debug(
+        "(TRANSFER) %llu uploads, %.1f MiB on the %s queue.",
+        (unsigned long long)transfer->uploads,
+        (double)transfer->bytes / (1024.0 * 1024.0),
+        transfer->dedicated ? "dedicated transfer" : "graphics"
+    );
+}
@@ -0,0 +1,293 @@
+#include "vk/upload_ring.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/debug.h"
+
+static VkDeviceSize upload_ring_align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool upload_ring_create_descriptors(upload_ring_t *ring, const device_t *device) {
+    const VkShaderStageFlags stages = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutBinding set_layout_bindings[2];
+    set_layout_bindings[0]                 = (VkDescriptorSetLayoutBinding){0};
+    set_layout_bindings[0].binding         = 0;
+    set_layout_bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    set_layout_bindings[0].descriptorCount = 1;
+    set_layout_bindings[0].stageFlags      = stages;
+    set_layout_bindings[1]                 = (VkDescriptorSetLayoutBinding){0};
+    set_layout_bindings[1].binding         = 1;
+    set_layout_bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    set_layout_bindings[1].descriptorCount = 1;
+    set_layout_bindings[1].stageFlags      = stages;
+
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info = {0};
+    set_layout_create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_layout_create_info.bindingCount = 2;
+    set_layout_create_info.pBindings    = set_layout_bindings;
+
+    VkResult res;
+    res = vkCreateDescriptorSetLayout(
+        device->vk_device, &set_layout_create_info, NULL, &ring->vk_set_layout
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(UPLOAD RING) vkCreateDescriptorSetLayout failed (%s).", vk_res_str(res));
+        ring->vk_set_layout = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorPoolSize pool_sizes[2];
+    pool_sizes[0].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    pool_sizes[0].descriptorCount = 1;
+    pool_sizes[1].type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    pool_sizes[1].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {0};
+    descriptor_pool_create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_create_info.maxSets       = 1;
+    descriptor_pool_create_info.poolSizeCount = 2;
+    descriptor_pool_create_info.pPoolSizes    = pool_sizes;
+
+    res = vkCreateDescriptorPool(
+        device->vk_device, &descriptor_pool_create_info, NULL, &ring->vk_descriptor_pool
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(UPLOAD RING) vkCreateDescriptorPool failed (%s).", vk_res_str(res));
+        ring->vk_descriptor_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {0};
+    descriptor_set_allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptor_set_allocate_info.descriptorPool     = ring->vk_descriptor_pool;
+    descriptor_set_allocate_info.descriptorSetCount = 1;
+    descriptor_set_allocate_info.pSetLayouts        = &ring->vk_set_layout;
+
+    res = vkAllocateDescriptorSets(
+        device->vk_device, &descriptor_set_allocate_info, &ring->vk_descriptor_set
+    );
+    if (res != VK_SUCCESS) {
+        log_error("(UPLOAD RING) vkAllocateDescriptorSets failed (%s).", vk_res_str(res));
+        ring->vk_descriptor_set = VK_NULL_HANDLE;
+        return false;
+    }
+
+    // Written once; each bind selects the slice through its dynamic offset.
+    VkDescriptorBufferInfo descriptor_buffer_info = {0};
+    descriptor_buffer_info.buffer                 = ring->vk_buffer;
+    descriptor_buffer_info.offset                 = 0;
+    descriptor_buffer_info.range                  = ring->binding_range;
+
+    VkWriteDescriptorSet write_descriptor_sets[2];
+    for (uint32_t i = 0; i < 2; ++i) {
+        write_descriptor_sets[i]                 = (VkWriteDescriptorSet){0};
+        write_descriptor_sets[i].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_descriptor_sets[i].dstSet          = ring->vk_descriptor_set;
+        write_descriptor_sets[i].dstBinding      = i;
+        write_descriptor_sets[i].descriptorCount = 1;
+        write_descriptor_sets[i].descriptorType  = pool_sizes[i].type;
+        write_descriptor_sets[i].pBufferInfo     = &descriptor_buffer_info;
+    }
+
+    vkUpdateDescriptorSets(device->vk_device, 2, write_descriptor_sets, 0, NULL);
+
+    return true;
+}
+
+bool upload_ring_create(
+    upload_ring_t  *ring,
+    const device_t *device,
+    memory_t       *memory,
+    uint32_t        region_count,
+    VkDeviceSize    region_size,
+    VkDeviceSize    binding_range
+) {
+    assert(region_count > 0 && region_count <= UPLOAD_RING_MAX_REGIONS);
+
+    memset(ring, 0, sizeof(*ring));
+    ring->memory = memory;
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device->vk_physical_device, &device_properties);
+    const VkPhysicalDeviceLimits *limits = &device_properties.limits;
+
+    // All three are powers of two, so the largest is a multiple of the others.
+    ring->alignment = limits->minUniformBufferOffsetAlignment;
+    if (ring->alignment < limits->minStorageBufferOffsetAlignment) {
+        ring->alignment = limits->minStorageBufferOffsetAlignment;
+    }
+    if (ring->alignment < limits->nonCoherentAtomSize) {
+        ring->alignment = limits->nonCoherentAtomSize;
+    }
+    ring->non_coherent_atom_size = limits->nonCoherentAtomSize;
+
+    ring->binding_range = binding_range;
+    if (ring->binding_range > limits->maxUniformBufferRange) {
+        ring->binding_range = limits->maxUniformBufferRange;
+    }
+
+    ring->region_count = region_count;
+    ring->region_size  = upload_ring_align_up(region_size, ring->alignment);
+
+    // The binding range past the last region keeps every dynamic offset within the buffer.
+    const VkDeviceSize size = ring->region_size * region_count + ring->binding_range;
+    if (size > UINT32_MAX) {
+        log_error(
+            "(UPLOAD RING) %llu bytes exceed the dynamic offset range.", (unsigned long long)size
+        );
+        return false;
+    }
+
+    VkBufferCreateInfo buffer_create_info = {0};
+    buffer_create_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.size               = size;
+    buffer_create_info.usage
+        = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult res;
+    res = vkCreateBuffer(device->vk_device, &buffer_create_info, NULL, &ring->vk_buffer);
+    if (res != VK_SUCCESS) {
+        log_error("(UPLOAD RING) vkCreateBuffer failed (%s).", vk_res_str(res));
+        ring->vk_buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    // Device-local host-visible memory (resizable BAR, integrated GPUs) saves the GPU a read
+    // across the bus for every draw.
+    if (!memory_alloc_buffer(
+            memory,
+            ring->vk_buffer,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            MEMORY_STRATEGY_BUDDY,
+            &ring->allocation
+        )) {
+        log_error("(UPLOAD RING) failed to allocate memory.");
+        upload_ring_destroy(ring, device);
+        return false;
+    }
+    ring->coherent = memory_is_coherent(memory, &ring->allocation);
+
+    for (uint32_t i = 0; i < UPLOAD_RING_MAX_REGIONS; ++i) {
+        atomic_init(&ring->heads[i], 0);
+    }
+    atomic_init(&ring->overflows, 0);
+
+    if (!upload_ring_create_descriptors(ring, device)) {
+        upload_ring_destroy(ring, device);
+        return false;
+    }
+
+    log_debug(
+        "(UPLOAD RING) %u regions of %llu bytes, %s memory.",
+        ring->region_count,
+        (unsigned long long)ring->region_size,
+        ring->coherent ? "coherent" : "non-coherent"
+    );
+
+    return true;
+}
+
+void upload_ring_destroy(upload_ring_t *ring, const device_t *device) {
+    if (ring == NULL) {
+        return;
+    }
+
+    if (ring->vk_descriptor_pool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device->vk_device, ring->vk_descriptor_pool, NULL);
+    }
+    if (ring->vk_set_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device->vk_device, ring->vk_set_layout, NULL);
+    }
+    if (ring->vk_buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device->vk_device, ring->vk_buffer, NULL);
+    }
+    memory_free(ring->memory, &ring->allocation);
+
+    memset(ring, 0, sizeof(*ring));
+}
+
+void upload_ring_begin(upload_ring_t *ring, uint32_t region) {
+    assert(region < ring->region_count);
+
+    atomic_store_explicit(&ring->heads[region], 0, memory_order_relaxed);
+}
+
+bool upload_ring_alloc(
+    upload_ring_t  *ring,
+    uint32_t        region,
+    VkDeviceSize    size,
+    upload_slice_t *slice
+) {
+    assert(region < ring->region_count);
+    assert(size <= ring->binding_range);
+
+    const VkDeviceSize aligned = upload_ring_align_up(size, ring->alignment);
+    const VkDeviceSize offset
+        = atomic_fetch_add_explicit(&ring->heads[region], aligned, memory_order_relaxed);
+    if (offset + aligned > ring->region_size) {
+        atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+        return false;
+    }
+
+    const VkDeviceSize ring_offset = ring->region_size * region + offset;
+
+    slice->data   = (char *)ring->allocation.mapped + ring_offset;
+    slice->offset = (uint32_t)ring_offset;
+    slice->size   = size;
+
+    return true;
+}
+
+bool upload_ring_flush(upload_ring_t *ring, const device_t *device, uint32_t region) {
+    assert(region < ring->region_count);
+
+    VkDeviceSize used = atomic_load_explicit(&ring->heads[region], memory_order_relaxed);
+    if (used > ring->region_size) {
+        used = ring->region_size;
+    }
+    if (used > ring->peak_bytes) {
+        ring->peak_bytes = used;
+    }
+
+    if (used == 0 || ring->coherent) {
+        return true;
+    }
+
+    // Regions and the allocation offset are multiples of nonCoherentAtomSize.
+    VkMappedMemoryRange mapped_memory_range = {0};
+    mapped_memory_range.sType               = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    mapped_memory_range.memory              = ring->allocation.vk_memory;
+    mapped_memory_range.offset = ring->allocation.offset + ring->region_size * region;
+    mapped_memory_range.size   = upload_ring_align_up(used, ring->non_coherent_atom_size);
+
+    VkResult res;
+    res = vkFlushMappedMemoryRanges(device->vk_device, 1, &mapped_memory_range);
+    if (res != VK_SUCCESS) {
+        log_error("(UPLOAD RING) vkFlushMappedMemoryRanges failed (%s).", vk_res_str(res));
+        return false;
+    }
+    ++ring->flushes;
+
+    return true;
+}
+
+void upload_ring_log_stats(upload_ring_t *ring) {
+    if (ring->region_count == 0 || ring->peak_bytes == 0) {
+        return;
+    }
+
+    log_debug(
+        "(UPLOAD RING) peak %llu of %llu bytes per region, %llu flushes, %llu overflows.",
+        (unsigned long long)ring->peak_bytes,
+        (unsigned long long)ring->region_size,
+        (unsigned long long)ring->flushes,
+        (unsigned long long)atomic_load(&ring->overflows)
+    );
+}
@@ -0,0 +1,321 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "vk/device.h"
+#include "vk/instance.h"
+#include "vk/memory.h"
+
+// Small blocks keep the dedicated threshold and the buddy orders easy to reach.
+#define TEST_BLOCK_SIZE ((VkDeviceSize)1024 * 1024)
+
+#define TEST_CHECK(expr) test_check((expr), #expr, __FILE__, __LINE__)
+
+static uint32_t test_checks;
+static uint32_t test_failures;
+
+static bool test_check(bool ok, const char *expr, const char *file, int line) {
+    ++test_checks;
+    if (!ok) {
+        ++test_failures;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+// All requests go to memory type 0, so every test sees one block list per strategy.
+static memory_request_t test_request(
+    VkDeviceSize size, VkDeviceSize alignment, memory_strategy_t strategy, bool optimal_tiling
+) {
+    memory_request_t request = {0};
+
+    request.requirements.size           = size;
+    request.requirements.alignment      = alignment;
+    request.requirements.memoryTypeBits = 1U;
+    request.strategy                    = strategy;
+    request.optimal_tiling              = optimal_tiling;
+
+    return request;
+}
+
+static bool test_alloc(
+    memory_t           *memory,
+    VkDeviceSize        size,
+    VkDeviceSize        alignment,
+    memory_strategy_t   strategy,
+    bool                optimal_tiling,
+    memory_allocation_t *allocation
+) {
+    const memory_request_t request = test_request(size, alignment, strategy, optimal_tiling);
+    return memory_alloc(memory, &request, allocation);
+}
+
+// Two minimum-size allocations split one block down to order 0 and are buddies, freeing both
+// merges the block back into a single free range.
+static void test_buddy_split_merge(const device_t *device) {
+    memory_t memory;
+    if (!TEST_CHECK(memory_create(&memory, device, TEST_BLOCK_SIZE))) {
+        return;
+    }
+
+    const VkDeviceSize  min_size = memory.min_size;
+    memory_allocation_t a        = {0};
+    memory_allocation_t b        = {0};
+
+    if (TEST_CHECK(test_alloc(&memory, 1, 1, MEMORY_STRATEGY_BUDDY, false, &a))
+        && TEST_CHECK(test_alloc(&memory, 1, 1, MEMORY_STRATEGY_BUDDY, false, &b))) {
+        const memory_block_t *block = a.block;
+
+        TEST_CHECK(b.block == block);
+        TEST_CHECK(a.size == min_size && b.size == min_size);
+        TEST_CHECK(a.order == 0 && b.order == 0);
+        TEST_CHECK((a.offset ^ min_size) == b.offset);
+
+        // The split left one free range on every order between 1 and the top.
+        for (uint32_t order = 1; order < block->max_order; ++order) {
+            TEST_CHECK(block->free_lists[order].count == 1);
+        }
+        TEST_CHECK(block->free_lists[0].count == 0);
+        TEST_CHECK(block->free_lists[block->max_order].count == 0);
+
+        memory_free(&memory, &a);
+        TEST_CHECK(block->free_lists[0].count == 1);
+
+        memory_free(&memory, &b);
+        for (uint32_t order = 0; order < block->max_order; ++order) {
+            TEST_CHECK(block->free_lists[order].count == 0);
+        }
+        TEST_CHECK(block->free_lists[block->max_order].count == 1);
+        TEST_CHECK(block->free_lists[block->max_order].offsets[0] == 0);
+
+        memory_stats_t stats;
+        memory_get_stats(&memory, &stats);
+        TEST_CHECK(stats.block_count == 1);
+        TEST_CHECK(stats.allocation_count == 0);
+        TEST_CHECK(stats.used_bytes == 0);
+        TEST_CHECK(stats.fragmentation == 0.0F);
+    }
+
+    memory_destroy(&memory);
+}
+
+// A linear block bumps its top and starts over at 0 once everything in it was freed.
+static void test_linear_reset(const device_t *device) {
+    memory_t memory;
+    if (!TEST_CHECK(memory_create(&memory, device, TEST_BLOCK_SIZE))) {
+        return;
+    }
+
+    memory_allocation_t a = {0};
+    memory_allocation_t b = {0};
+    memory_allocation_t c = {0};
+
+    if (TEST_CHECK(test_alloc(&memory, 1000, 256, MEMORY_STRATEGY_LINEAR, false, &a))
+        && TEST_CHECK(test_alloc(&memory, 1000, 256, MEMORY_STRATEGY_LINEAR, false, &b))) {
+        TEST_CHECK(a.offset == 0);
+        TEST_CHECK(b.offset == 1024);
+        TEST_CHECK(b.block == a.block);
+
+        memory_free(&memory, &a);
+        TEST_CHECK(b.block->top == 2024);
+
+        const memory_block_t *block = b.block;
+        memory_free(&memory, &b);
+        TEST_CHECK(block->top == 0);
+
+        memory_stats_t before;
+        memory_get_stats(&memory, &before);
+
+        if (TEST_CHECK(test_alloc(&memory, 1000, 256, MEMORY_STRATEGY_LINEAR, false, &c))) {
+            memory_stats_t after;
+            memory_get_stats(&memory, &after);
+
+            TEST_CHECK(c.block == block);
+            TEST_CHECK(c.offset == 0);
+            TEST_CHECK(after.vk_allocations == before.vk_allocations);
+            memory_free(&memory, &c);
+        }
+    }
+
+    memory_destroy(&memory);
+}
+
+// A linear resource and an optimal-tiling image next to it never share a granularity page, in
+// either strategy.
+static void test_granularity(const device_t *device) {
+    memory_t memory;
+    if (!TEST_CHECK(memory_create(&memory, device, TEST_BLOCK_SIZE))) {
+        return;
+    }
+
+    const VkDeviceSize granularity = memory.buffer_image_granularity;
+    TEST_CHECK(memory.min_size % granularity == 0);
+
+    memory_allocation_t buffer = {0};
+    memory_allocation_t image  = {0};
+
+    if (TEST_CHECK(test_alloc(&memory, 100, 16, MEMORY_STRATEGY_LINEAR, false, &buffer))
+        && TEST_CHECK(test_alloc(&memory, 100, 16, MEMORY_STRATEGY_LINEAR, true, &image))) {
+        TEST_CHECK(image.offset % granularity == 0);
+        TEST_CHECK((buffer.offset + buffer.size - 1) / granularity < image.offset / granularity);
+
+        memory_free(&memory, &image);
+        memory_free(&memory, &buffer);
+    }
+
+    if (TEST_CHECK(test_alloc(&memory, 100, 16, MEMORY_STRATEGY_BUDDY, false, &buffer))
+        && TEST_CHECK(test_alloc(&memory, 100, 16, MEMORY_STRATEGY_BUDDY, true, &image))) {
+        TEST_CHECK(buffer.offset % granularity == 0 && image.offset % granularity == 0);
+        TEST_CHECK((buffer.offset + buffer.size - 1) / granularity != image.offset / granularity);
+
+        memory_free(&memory, &image);
+        memory_free(&memory, &buffer);
+    }
+
+    memory_destroy(&memory);
+}
+
+// Half a block still fits a block, anything larger gets its own VkDeviceMemory that is released
+// again on free.
+static void test_dedicated_threshold(const device_t *device) {
+    memory_t memory;
+    if (!TEST_CHECK(memory_create(&memory, device, TEST_BLOCK_SIZE))) {
+        return;
+    }
+
+    memory_allocation_t probe = {0};
+    memory_allocation_t half  = {0};
+    memory_allocation_t large = {0};
+
+    // The block size may be capped by the heap, so take it from a block that exists.
+    if (!TEST_CHECK(test_alloc(&memory, 1, 1, MEMORY_STRATEGY_BUDDY, false, &probe))) {
+        memory_destroy(&memory);
+        return;
+    }
+    const VkDeviceSize block_size = probe.block->size;
+    memory_free(&memory, &probe);
+
+    if (TEST_CHECK(test_alloc(&memory, block_size / 2, 1, MEMORY_STRATEGY_BUDDY, false, &half))) {
+        TEST_CHECK(!half.block->dedicated);
+        TEST_CHECK(half.block->size == block_size);
+        memory_free(&memory, &half);
+    }
+
+    const VkDeviceSize size = block_size / 2 + 1;
+    if (TEST_CHECK(test_alloc(&memory, size, 1, MEMORY_STRATEGY_BUDDY, false, &large))) {
+        TEST_CHECK(large.block->dedicated);
+        TEST_CHECK(large.offset == 0);
+        TEST_CHECK(large.size == size);
+
+        memory_stats_t stats;
+        memory_get_stats(&memory, &stats);
+        TEST_CHECK(stats.dedicated_count == 1);
+        TEST_CHECK(stats.block_count == 2);
+
+        memory_free(&memory, &large);
+        memory_get_stats(&memory, &stats);
+        TEST_CHECK(stats.dedicated_count == 0);
+        TEST_CHECK(stats.block_count == 1);
+    }
+
+    memory_destroy(&memory);
+}
+
+// Used bytes count the rounded buddy sizes, and two free order-0 holes that are not buddies
+// show up as fragmentation.
+static void test_stats(const device_t *device) {
+    memory_t memory;
+    if (!TEST_CHECK(memory_create(&memory, device, TEST_BLOCK_SIZE))) {
+        return;
+    }
+
+    const VkDeviceSize  min_size = memory.min_size;
+    memory_allocation_t allocations[4];
+    memset(allocations, 0, sizeof(allocations));
+
+    bool ok = true;
+    for (uint32_t i = 0; i < 4 && ok; ++i) {
+        ok = TEST_CHECK(test_alloc(&memory, 1, 1, MEMORY_STRATEGY_BUDDY, false, &allocations[i]));
+    }
+
+    if (ok) {
+        const VkDeviceSize block_size = allocations[0].block->size;
+
+        memory_stats_t stats;
+        memory_get_stats(&memory, &stats);
+        TEST_CHECK(stats.block_count == 1);
+        TEST_CHECK(stats.allocation_count == 4);
+        TEST_CHECK(stats.reserved_bytes == block_size);
+        TEST_CHECK(stats.used_bytes == 4 * min_size);
+        TEST_CHECK(stats.allocations == 4);
+        TEST_CHECK(stats.frees == 0);
+
+        // Free space is still one range per order, which the largest one does not cover.
+        const float split = 1.0F - (float)(block_size / 2) / (float)(block_size - 4 * min_size);
+        TEST_CHECK(fabsf(stats.fragmentation - split) < 1e-6F);
+
+        // Offsets min_size and 2 * min_size are not buddies, so both stay order-0 holes.
+        uint32_t inner[2] = {0};
+        uint32_t outer[2] = {0};
+        uint32_t inner_count = 0;
+        uint32_t outer_count = 0;
+        for (uint32_t i = 0; i < 4; ++i) {
+            const VkDeviceSize slot = allocations[i].offset / min_size;
+            if (slot == 1 || slot == 2) {
+                inner[inner_count++] = i;
+            } else {
+                outer[outer_count++] = i;
+            }
+        }
+        TEST_CHECK(inner_count == 2 && outer_count == 2);
+
+        memory_free(&memory, &allocations[inner[0]]);
+        memory_free(&memory, &allocations[inner[1]]);
+
+        memory_get_stats(&memory, &stats);
+        TEST_CHECK(stats.allocation_count == 2);
+        TEST_CHECK(stats.used_bytes == 2 * min_size);
+        TEST_CHECK(stats.frees == 2);
+
+        const float holes = 1.0F - (float)(block_size / 2) / (float)(block_size - 2 * min_size);
+        TEST_CHECK(fabsf(stats.fragmentation - holes) < 1e-6F);
+        TEST_CHECK(stats.fragmentation > split);
+
+        memory_free(&memory, &allocations[outer[0]]);
+        memory_free(&memory, &allocations[outer[1]]);
+
+        memory_get_stats(&memory, &stats);
+        TEST_CHECK(stats.used_bytes == 0);
+        TEST_CHECK(stats.fragmentation == 0.0F);
+    }
+
+    memory_destroy(&memory);
+}
+
+int main(void) {
+    instance_t instance = {0};
+    device_t   device   = {0};
+
+    if (!instance_create(&instance, true)) {
+        log_error("(TEST) Failed to create vulkan instance.");
+        return 1;
+    }
+    if (!device_create(&device, instance.vk_instance, VK_NULL_HANDLE)) {
+        log_error("(TEST) Failed to create device.");
+        instance_destroy(&instance);
+        return 1;
+    }
+
+    test_buddy_split_merge(&device);
+    test_linear_reset(&device);
+    test_granularity(&device);
+    test_dedicated_threshold(&device);
+    test_stats(&device);
+
+    device_destroy(&device);
+    instance_destroy(&instance);
+
+    printf("memory_test: %u checks, %u failed\n", test_checks, test_failures);
+    return test_failures == 0 ? 0 : 1;
+}